@@ -1,4 +1,8 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "include/atmosphere.glsl"
 
 layout(set = 0, binding = 0) uniform VP {
     mat4 vp;
@@ -13,8 +17,6 @@ layout(set = 0, binding = 1) uniform ATMOSPHERE {
 	float offsetFactor;
 	float densityFalloff;
 	float scatteringStrength;
-	int numInScatteringPoints;
-	int numOpticalDepthPoints;
 } atmos;
 
 layout(set = 0, binding = 2) uniform LIGHT {
@@ -24,98 +26,72 @@ layout(set = 0, binding = 2) uniform LIGHT {
 	float diffuseStrength;
 } light;
 
-layout(set = 1, binding = 0) uniform sampler2D scene;
-layout(set = 1, binding = 1) uniform sampler2D normSampler; // TODO: don't need this
+// Bindless indices of the lookup tables baked by the SkyRenderer
+layout(set = 0, binding = 3) uniform SKY_LUTS {
+	uint opticalDepth;
+	uint skyView;
+	uint lowResSky;
+	uint lowResScale; // 1 when the sky is drawn at full resolution
+	uint skyCube;
+	uint model; // 0 reads the tables above, 1 works the sky out per pixel without them
+} skyLUTs;
+
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+// The same table, for the slots holding cubemaps
+layout(set = 1, binding = 0) uniform samplerCube cubeTextures[];
 
 layout(location = 0) in vec2 inUV;
 layout(location = 0) out vec4 outColor;
 
-const float maxFloat = 3.402823466e+38;
-
-vec2 raySphere(vec3 origin, vec3 dir, vec3 center, float radius) {
-	vec3 offset = origin - center;
-
-	float a = dot(dir, dir);
-	float b = 2.0f * dot(dir, offset);
-	float c = dot(offset, offset) - radius * radius;
-	float d = b * b - 4 * a * c; // Discriminant from quadratic formula
-
-		// Number of intersections: 0 when d < 0; 1 when d = 0; 2 when d > 0
-		if (d > 0) {
-			float s = sqrt(d);
-			float dstToSphereNear = max(0, (-b - s) / (2.0 * a));
-			float dstToSphereFar = (-b + s) / (2.0 * a);
-
-			// Ignore intersections that occur behind the ray
-			if (dstToSphereFar >= 0) {
-				return vec2(dstToSphereNear, dstToSphereFar - dstToSphereNear);
-			}
-		}
-
-		// Ray did not intersect sphere
-		return vec2(maxFloat, 0);
-}
-
-float densityAtPoint(vec3 samplePoint) {
-	float heightAboveSuface = length(samplePoint - atmos.center) - (atmos.radius * atmos.offsetFactor);
-	float heightNormalized = heightAboveSuface / (atmos.radius * (1 - atmos.offsetFactor));
-	float localDensity = exp(-heightNormalized * atmos.densityFalloff) * (1 - heightNormalized);
-	return localDensity;
+// The sky cubemap is baked from the sky-view LUT, and only again when the sky changes
+vec3 skyColor(vec3 dir) {
+	return texture(cubeTextures[skyLUTs.skyCube], dir).rgb;
 }
 
-float opticalDepth(vec3 origin, vec3 dir, float len) {
-	vec3 densitySamplePoint = origin; 
-	float stepSize = len / (atmos.numOpticalDepthPoints - 1); 
-	float opticalDepth = 0.0f;
-
-	for (int i = 0; i < atmos.numOpticalDepthPoints; i++) {
-		float localDensity = densityAtPoint(densitySamplePoint);
-		opticalDepth += localDensity * stepSize; 
-		densitySamplePoint += dir * stepSize;
+// Bilinear upsample of the low resolution sky, skipping texels which cover no sky. Those hold no
+// color, and would darken the sky around the edges of geometry and the ground
+vec3 upsampleSky(vec3 dir) {
+	ivec2 maxTexel = textureSize(textures[skyLUTs.lowResSky], 0) - 1;
+	vec2 coord = gl_FragCoord.xy / float(skyLUTs.lowResScale) - 0.5f;
+	ivec2 base = ivec2(floor(coord));
+	vec2 f = fract(coord);
+
+	vec3 color = vec3(0.0f);
+	float totalWeight = 0.0f;
+	for (int i = 0; i < 4; i++) {
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		vec4 texel = texelFetch(textures[skyLUTs.lowResSky], clamp(base + offset, ivec2(0), maxTexel),
+		                        0);
+		vec2 bilinear = mix(1.0f - f, f, vec2(offset));
+		float weight = bilinear.x * bilinear.y * texel.a;
+		color += texel.rgb * weight;
+		totalWeight += weight;
 	}
 
-	return opticalDepth;
-}
-
-vec3 calculateLight(vec3 eyePos, vec3 dir, float atmosLen) {
-	vec3 inScatterPoint = eyePos; 
-	float stepSize = atmosLen / (atmos.numInScatteringPoints - 1.0f); 
-	vec3 inScatteredLight = vec3(0.0f);
-	
-	for (int i = 0; i < atmos.numInScatteringPoints; i++) {
-		vec3 dirToSun = normalize(light.pos - inScatterPoint);
-		float sunRayLen = raySphere(inScatterPoint, dirToSun, atmos.center, atmos.radius).y;
-		float sunRayOpticalDepth = opticalDepth(inScatterPoint, dirToSun, sunRayLen); // Rayleigh in scattering 
-		float viewRayOpticalDepth = opticalDepth(inScatterPoint, -dir, stepSize * i); // Rayleigh out scattering
-		vec3 transmittance = exp(-(sunRayOpticalDepth + viewRayOpticalDepth) * atmos.defractionCoef);
-		float localDensity = densityAtPoint(inScatterPoint);
-
-		inScatteredLight += localDensity * transmittance * atmos.defractionCoef * stepSize; 
-		inScatterPoint += dir * stepSize;
+	// Sky seen through a gap smaller than a texel
+	if (totalWeight <= 0.0f) {
+		return skyColor(dir);
 	}
-
-	return inScatteredLight;
+	return color / totalWeight;
 }
 
 void main() {
 	vec4 clipPos = vec4(inUV * 2.0 - 1.0, 1.0, 1.0);
 	vec4 viewPos = inverse(camVP.vp) * clipPos;
-	vec3 pos = vec3(0.0f, 0.0f, 0.0f);
 	vec3 dir = (viewPos / viewPos.w).xyz; // HACK: assuming camera is at origin
 	dir = normalize(dir);
 
-	float planetRadius = atmos.radius * atmos.offsetFactor - 0.1f;
-
-	vec2 planetDist = raySphere(pos, dir, atmos.center, planetRadius);
-	vec2 atmosDist = raySphere(pos, dir, atmos.center, atmos.radius);
-	float distInAtmos = min(atmosDist.y, planetDist.x - atmosDist.x);
-
-	if (atmosDist.y < planetDist.x) {
-		float intensity = distInAtmos; // / (2.0f * atmos.radius);
-		intensity = planetDist.x - atmosDist.x;
-		vec3 light = calculateLight(vec3(pos), dir, distInAtmos);
-
-		outColor = vec4(light, 1.0f);
+	if (seesSky(dir, atmos.center, atmos.radius, atmos.offsetFactor)) {
+		if (skyLUTs.model == 1) {
+			outColor = vec4(analyticSky(dir, light.pos, atmos.center, atmos.radius,
+			                            atmos.offsetFactor, atmos.densityFalloff,
+			                            atmos.defractionCoef),
+			                1.0f);
+		} else if (skyLUTs.lowResScale > 1) {
+			outColor = vec4(upsampleSky(dir), 1.0f);
+		} else {
+			outColor = vec4(skyColor(dir), 1.0f);
+		}
 	} else {
 		outColor = vec4(0.80f, 0.43f, 0.18f, 1.0f);
 	}
@@ -1,8 +1,19 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout(push_constant) uniform TRS {
+struct ObjectData {
     mat4 trs;
-} trs;
+    mat4 normalMatrix;
+    vec4 bounds;
+    uint albedoIdx;
+    uint normalIdx;
+    uint indexCount;
+    uint batch;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer Objects {
+    ObjectData objects[];
+};
 
 layout(set = 0, binding = 0) uniform VP {
     mat4 vp;
@@ -12,6 +23,8 @@ layout(set = 0, binding = 1) uniform CloudSettings {
 	float noiseFreq;
 	float baseIntensity; 
 	float opacity;
+	uint noiseVolume;
+	float noisePeriod;
 } cloud;
 
 layout(location = 0) in vec3 inPosition;
@@ -22,42 +35,45 @@ layout(location = 3) in vec2 inTexCoord;
 layout(location = 0) out vec3 fragPos;
 layout(location = 1) out vec3 cloudPos;
 layout(location = 2) out vec3 cloudScale;
+layout(location = 3) flat out vec3 noiseOffset;
 
-// Generic noise from https://gist.github.com/patriciogonzalezvivo/670c22f3966e662d2f83 
-float mod289(float x){return x - floor(x * (1.0 / 289.0)) * 289.0;}
-vec4 mod289(vec4 x){return x - floor(x * (1.0 / 289.0)) * 289.0;}
-vec4 perm(vec4 x){return mod289(((x * 34.0) + 1.0) * x);}
-
-float noise(vec3 p) {
-    vec3 a = floor(p);
-    vec3 d = p - a;
-    d = d * d * (3.0 - 2.0 * d);
-
-    vec4 b = a.xxyy + vec4(0.0, 1.0, 0.0, 1.0);
-    vec4 k1 = perm(b.xyxy);
-    vec4 k2 = perm(k1.xyxy + b.zzww);
-
-    vec4 c = k2 + a.zzzz;
-    vec4 k3 = perm(c);
-    vec4 k4 = perm(c + 1.0);
+// The bindless texture table, for the slots holding volumes
+layout(set = 1, binding = 0) uniform sampler3D volumeTextures[];
 
-    vec4 o1 = fract(k3 * (1.0 / 41.0));
-    vec4 o2 = fract(k4 * (1.0 / 41.0));
-
-    vec4 o3 = o2 * d.z + o1 * (1.0 - d.z);
-    vec2 o4 = o3.yw * d.x + o3.xz * (1.0 - d.x);
+// Tiling value noise baked by NoiseVolume, in [0, 1]
+float valueNoise(vec3 p) {
+	return textureLod(volumeTextures[cloud.noiseVolume], p / cloud.noisePeriod, 0.0).g;
+}
 
-    return o4.y * d.y + o4.x * (1.0 - d.y);
+// Hashes 3 integers to 3 well mixed integers (PCG)
+uvec3 pcg3d(uvec3 v) {
+	v = v * 1664525u + 1013904223u;
+	v.x += v.y * v.z;
+	v.y += v.z * v.x;
+	v.z += v.x * v.y;
+	v ^= v >> 16u;
+	v.x += v.y * v.z;
+	v.y += v.z * v.x;
+	v.z += v.x * v.y;
+	return v;
 }
 
 void main() {
-	fragPos = vec3(trs.trs * vec4(inPosition, 1.0));
+	// Clouds are drawn instanced, each instance has its own slot
+	ObjectData obj = objects[gl_InstanceIndex];
+
+	// Each cloud shifts its noise lookups by up to a whole period, picked from its position, so
+	// clouds a multiple of the period apart don't share a pattern
+	cloudPos = vec3(obj.trs[3]);
+	noiseOffset = vec3(pcg3d(floatBitsToUint(cloudPos)) & 0xffffu) / 65535.0 * cloud.noisePeriod;
+
+	fragPos = vec3(obj.trs * vec4(inPosition, 1.0));
 	gl_Position = camVP.vp * vec4(fragPos, 1.0);
-	gl_Position = gl_Position + 30 * noise(fragPos / cloud.noiseFreq); // random cloud geometry
+	// random cloud geometry
+	gl_Position = gl_Position + 30 * valueNoise(fragPos / cloud.noiseFreq + noiseOffset);
 
-	cloudPos = vec3(trs.trs[3]);
 	cloudScale = vec3(0);
-	cloudScale.x = sign(trs.trs[0][0]) * length(vec3(trs.trs[0]));
-	cloudScale.y = sign(trs.trs[1][1]) * length(vec3(trs.trs[1]));
-	cloudScale.z = sign(trs.trs[2][2]) * length(vec3(trs.trs[2]));
+	cloudScale.x = sign(obj.trs[0][0]) * length(vec3(obj.trs[0]));
+	cloudScale.y = sign(obj.trs[1][1]) * length(vec3(obj.trs[1]));
+	cloudScale.z = sign(obj.trs[2][2]) * length(vec3(obj.trs[2]));
 }
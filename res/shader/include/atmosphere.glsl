@@ -0,0 +1,132 @@
+// Shared by the atmosphere pass and the lookup tables baked for it
+
+const float maxFloat = 3.402823466e+38;
+const float PI = 3.14159265359;
+
+vec2 raySphere(vec3 origin, vec3 dir, vec3 center, float radius) {
+	vec3 offset = origin - center;
+
+	float a = dot(dir, dir);
+	float b = 2.0f * dot(dir, offset);
+	float c = dot(offset, offset) - radius * radius;
+	float d = b * b - 4 * a * c; // Discriminant from quadratic formula
+
+		// Number of intersections: 0 when d < 0; 1 when d = 0; 2 when d > 0
+		if (d > 0) {
+			float s = sqrt(d);
+			float dstToSphereNear = max(0, (-b - s) / (2.0 * a));
+			float dstToSphereFar = (-b + s) / (2.0 * a);
+
+			// Ignore intersections that occur behind the ray
+			if (dstToSphereFar >= 0) {
+				return vec2(dstToSphereNear, dstToSphereFar - dstToSphereNear);
+			}
+		}
+
+		// Ray did not intersect sphere
+		return vec2(maxFloat, 0);
+}
+
+// Height is 0 at the planet's surface and 1 at the edge of the atmosphere
+float densityAtHeight(float heightNormalized, float densityFalloff) {
+	return exp(-heightNormalized * densityFalloff) * (1 - heightNormalized);
+}
+
+// The optical depth LUT is indexed by the cosine of a ray's angle to the zenith (x) and the
+// normalized height of its origin (y). Texel centers span both ranges exactly, so filtering never
+// wraps around an edge.
+vec2 opticalDepthUV(float heightNormalized, float cosZenith, vec2 size) {
+	vec2 uv = clamp(vec2(cosZenith * 0.5 + 0.5, heightNormalized), 0.0, 1.0);
+	return (uv * (size - 1.0) + 0.5) / size;
+}
+
+// Optical depth from a point to the edge of the atmosphere, read from the LUT instead of marched
+float lookupOpticalDepth(sampler2D lut, vec3 origin, vec3 dir, vec3 center, float radius,
+                         float offsetFactor) {
+	vec3 up = origin - center;
+	float dist = length(up);
+	float height = (dist - radius * offsetFactor) / (radius * (1 - offsetFactor));
+	return texture(lut, opticalDepthUV(height, dot(up / dist, dir), vec2(textureSize(lut, 0)))).r;
+}
+
+// The sky-view LUT is indexed by azimuth relative to the sun (x, with the sun in the middle) and
+// elevation (y). Elevation is mapped non-linearly, so the horizon, where the sky changes fastest,
+// gets the most texels. Both assume the eye is at the origin, with the planet straight below.
+vec2 skyViewUV(vec3 dir, vec3 sunDir, vec2 size) {
+	float azimuth = atan(dir.z, dir.x) - atan(sunDir.z, sunDir.x);
+	float elevation = asin(clamp(dir.y, -1.0, 1.0));
+
+	// Azimuth wraps around, which the sampler does by itself. Elevation must not
+	float u = fract(azimuth / (2.0 * PI) + 0.5);
+	float v = 0.5 + 0.5 * sign(elevation) * sqrt(abs(elevation) / (0.5 * PI));
+	return vec2(u, clamp(v, 0.5 / size.y, 1.0 - 0.5 / size.y));
+}
+
+vec3 skyViewDir(vec2 uv, vec3 sunDir) {
+	float azimuth = (uv.x - 0.5) * 2.0 * PI + atan(sunDir.z, sunDir.x);
+	float l = uv.y * 2.0 - 1.0;
+	float elevation = sign(l) * l * l * 0.5 * PI;
+	return vec3(cos(elevation) * cos(azimuth), sin(elevation), cos(elevation) * sin(azimuth));
+}
+
+// Whether a ray from the eye (at the origin) sees sky rather than the planet's surface
+bool seesSky(vec3 dir, vec3 center, float radius, float offsetFactor) {
+	float planetRadius = radius * offsetFactor - 0.1f;
+	vec2 planetDist = raySphere(vec3(0.0f), dir, center, planetRadius);
+	vec2 atmosDist = raySphere(vec3(0.0f), dir, center, radius);
+	return atmosDist.y < planetDist.x;
+}
+
+// Chapman function: optical depth along a ray through an exponential atmosphere, relative to that
+// of a ray straight up from the same point. x is the distance from the planet's center in scale
+// heights. Schuler's approximation, so it costs no more than a couple of square roots
+float chapman(float x, float cosZenith) {
+	float c = sqrt(0.5 * PI * x);
+	if (cosZenith >= 0.0) {
+		return c / ((c - 1.0) * cosZenith + 1.0);
+	}
+
+	// Below the horizon, the ray passes a lowest point where air is denser. Its depth is that of
+	// both ways horizontally from there, less that of the part of the ray behind the origin
+	float x0 = x * sqrt(max(0.0, 1.0 - cosZenith * cosZenith));
+	float c0 = sqrt(0.5 * PI * x0);
+	return 2.0 * c0 * exp(min(x - x0, 80.0)) - c / (1.0 - (c - 1.0) * cosZenith);
+}
+
+// Optical depth from a point to the edge of the atmosphere in closed form, in the same units as
+// lookupOpticalDepth. Density is treated as purely exponential, and the edge of the atmosphere is
+// ignored. densityAtHeight also tapers off to 0 at the edge, so the scale height is picked for the
+// depth straight up from the ground to match it exactly, rather than for the falloff alone
+float chapmanOpticalDepth(vec3 origin, vec3 dir, vec3 center, float radius, float offsetFactor,
+                          float densityFalloff) {
+	// Below this the exact depth loses too much precision, and it is nearly linear anyway
+	float falloff = max(densityFalloff, 0.1);
+	float scaleHeight =
+		radius * (1 - offsetFactor) * (falloff - 1.0 + exp(-falloff)) / (falloff * falloff);
+	vec3 up = origin - center;
+	float dist = length(up);
+	float height = dist - radius * offsetFactor;
+	return scaleHeight * exp(-height / scaleHeight) *
+	       chapman(dist / scaleHeight, dot(up / dist, dir));
+}
+
+// Light scattered towards the eye (at the origin) along dir, with no marching. Light from the sun
+// is taken to reach every point of the ray through as much air as it does at one point, the
+// middle of the column of air the ray sees. Then the in-scattering integral the sky-view LUT
+// marches, of density * coef * exp(-coef * depth from the eye), is 1 - exp(-coef * view depth)
+vec3 analyticSky(vec3 dir, vec3 sunPos, vec3 center, float radius, float offsetFactor,
+                 float densityFalloff, vec3 defractionCoef) {
+	vec3 eyePos = vec3(0.0f);
+	float viewDepth =
+		chapmanOpticalDepth(eyePos, dir, center, radius, offsetFactor, densityFalloff);
+	float atmosLen = raySphere(eyePos, dir, center, radius).y;
+
+	// The eye is on the ground, where density is 1, so the depth is also the length of an
+	// equivalent column of air at the eye's density
+	vec3 scatterPoint = eyePos + dir * min(0.5 * viewDepth, 0.5 * atmosLen);
+	vec3 dirToSun = normalize(sunPos - scatterPoint);
+	float sunDepth =
+		chapmanOpticalDepth(scatterPoint, dirToSun, center, radius, offsetFactor, densityFalloff);
+
+	return exp(-sunDepth * defractionCoef) * (1.0 - exp(-viewDepth * defractionCoef));
+}
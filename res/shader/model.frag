@@ -1,4 +1,19 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+struct ObjectData {
+    mat4 trs;
+    mat4 normalMatrix;
+    vec4 bounds;
+    uint albedoIdx;
+    uint normalIdx;
+    uint indexCount;
+    uint batch;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer Objects {
+    ObjectData objects[];
+};
 
 layout(set = 0, binding = 1) uniform LIGHT {
 	vec3 pos; 
@@ -7,23 +22,29 @@ layout(set = 0, binding = 1) uniform LIGHT {
 	float diffuseStrength;
 } light;
 
-layout(set = 1, binding = 0) uniform sampler2D texSampler;
-layout(set = 1, binding = 1) uniform sampler2D normSampler;
+layout(set = 1, binding = 0) uniform sampler2D textures[];
 
 layout(location = 0) in vec3 fragPos;
 layout(location = 1) in vec3 fragNormal;
 layout(location = 2) in vec3 fragColor;
 layout(location = 3) in vec2 fragTexCoord;
+layout(location = 4) flat in uint objectIdx;
 
 layout(location = 0) out vec4 outColor;
 
+const uint INVALID_TEXTURE_INDEX = 0xFFFFFFFFu;
+
 void main() {
+	ObjectData obj = objects[objectIdx];
+
 	// Lambertian lighting
-	vec3 norm = normalize(texture(normSampler, fragTexCoord).rgb);
+	vec3 norm = obj.normalIdx == INVALID_TEXTURE_INDEX
+		? normalize(fragNormal)
+		: normalize(texture(textures[nonuniformEXT(obj.normalIdx)], fragTexCoord).rgb);
     vec3 lightDir = normalize(light.pos - fragPos); 
     float diffuse = max(dot(norm, lightDir), 0.0) * light.diffuseStrength;
     vec3 lighting = (light.ambientStrength + diffuse) * light.color;
 
 	// combine lighting w/ texture albedo
-	outColor = vec4(lighting * texture(texSampler, fragTexCoord).rgb, 1.0f);
+	outColor = vec4(lighting * texture(textures[nonuniformEXT(obj.albedoIdx)], fragTexCoord).rgb, 1.0f);
 }
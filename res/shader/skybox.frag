@@ -1,14 +1,29 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout(set = 1, binding = 0) uniform sampler2D texSampler;
-layout(set = 1, binding = 1) uniform sampler2D normSampler; // TODO: don't need this
+struct ObjectData {
+    mat4 trs;
+    mat4 normalMatrix;
+    vec4 bounds;
+    uint albedoIdx;
+    uint normalIdx;
+    uint indexCount;
+    uint batch;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+layout(set = 1, binding = 0) uniform sampler2D textures[];
 
 layout(location = 0) in vec3 fragPos;
 layout(location = 1) in vec3 fragColor;
 layout(location = 2) in vec2 fragTexCoord;
+layout(location = 3) flat in uint objectIdx;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-	outColor = texture(texSampler, fragTexCoord);
+	outColor = texture(textures[nonuniformEXT(objects[objectIdx].albedoIdx)], fragTexCoord);
 }
@@ -1,8 +1,18 @@
 #version 450
 
-layout(push_constant) uniform TRS {
+struct ObjectData {
     mat4 trs;
-} trs;
+    mat4 normalMatrix;
+    vec4 bounds;
+    uint albedoIdx;
+    uint normalIdx;
+    uint indexCount;
+    uint batch;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer Objects {
+    ObjectData objects[];
+};
 
 layout(set = 0, binding = 0) uniform VP {
     mat4 vp;
@@ -16,9 +26,13 @@ layout(location = 3) in vec2 inTexCoord;
 layout(location = 0) out vec3 fragPos;
 layout(location = 1) out vec3 fragColor;
 layout(location = 2) out vec2 fragTexCoord;
+layout(location = 3) flat out uint objectIdx;
 
 void main() {
-	fragPos = vec3(trs.trs * vec4(inPosition, 1.0));
+	ObjectData obj = objects[gl_InstanceIndex];
+	objectIdx = gl_InstanceIndex;
+
+	fragPos = vec3(obj.trs * vec4(inPosition, 1.0));
     fragColor = inColor;
     fragTexCoord = inTexCoord;
 
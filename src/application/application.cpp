@@ -1,5 +1,8 @@
 #include "application.hpp"
 
+#include <random>
+#include <vector>
+
 #include <GLFW/glfw3.h>
 #include <glm/ext/scalar_constants.hpp>
 #include <glm/fwd.hpp>
@@ -9,6 +12,9 @@
 
 #include "imgui.h"
 
+#include "application/input.hpp"
+#include "application/quality_sweep.hpp"
+#include "renderer/bvh.hpp"
 #include "renderer/renderer.hpp"
 #include "renderer/shader.hpp"
 #include "renderer/shader_lib.hpp"
@@ -19,10 +25,48 @@
 
 Application* Application::s_instance = nullptr;
 
-Application::Application()
-	: m_window(CreateRef<GLFWWindow>("Vulkan")), m_instance(CreateRef<VulkanInstance>(m_window)),
+/**
+ * @brief Gets the atmosphere the scene starts with, before deriveSky
+ */
+static Atmosphere defaultAtmosphere() {
+	Atmosphere atmos;
+	atmos.wavelengths = {700.0f, 530.0f, 440.0f};
+	atmos.time = 0;
+	atmos.radius = 500.0f;
+	atmos.offsetFactor = 0.997f;
+	atmos.densityFalloff = 4.0;
+	atmos.scatteringStrength = 2.0f;
+	return atmos;
+}
+
+static LightSource defaultLight() {
+	LightSource light;
+	light.color = glm::vec3(0.988f, 0.415f, 0.227f);
+	light.ambientStrength = 0.1f;
+	light.diffuseStrength = 25.0f;
+	return light;
+}
+
+/**
+ * @brief Works out the parts of the atmosphere which follow from its settings, and puts the sun
+ * where the time of day has it
+ *
+ * @param sunTarget Point the sun circles over
+ */
+static void deriveSky(Atmosphere& atmos, LightSource& light, const glm::vec3& sunTarget) {
+	atmos.defractionCoef =
+		atmos.scatteringStrength * glm::pow(400.0f / atmos.wavelengths, {4.0f, 4.0f, 4.0f});
+	atmos.center = -glm::vec3(0.0f, atmos.radius, 0.0f) * atmos.offsetFactor;
+	float theta = atmos.time * glm::pi<float>() / 2.0f;
+	light.pos = 1000.0f * glm::vec3(0.0f, glm::cos(theta), -glm::sin(theta)) + sunTarget;
+}
+
+Application::Application(bool headless)
+	: m_window(CreateRef<GLFWWindow>("Vulkan", 800, 600, !headless)),
+	  m_instance(CreateRef<VulkanInstance>(m_window)),
 	  m_device(CreateRef<VulkanDevice>(m_instance)),
 	  m_renderer(CreateRef<VulkanRenderer>(m_instance, m_device, m_window)),
+	  m_cloudNoise(CreateRef<NoiseVolume>(m_device)),
 	  m_camera(CreateRef<Camera>(glm::radians(45.0f), m_renderer->getAspectRatio(), glm::vec3(),
                                  1.0f, 10000.0f)),
 	  m_camController(CreateRef<CameraController>(m_camera)) {
@@ -33,42 +77,99 @@ Application::Application()
 	s_instance = this;
 }
 
-void Application::run() {
-	Model mountain(m_device, "res/model/mountain.obj",
-	               TextureLibrary::get()->getTexture(m_device, "res/texture/mountain.png"),
-	               ShaderLibrary::get()->getShader(m_device, "model"));
-	mountain.getTransform().setTranslation({-300.0f, 10.0f, 250.0f});
-
-	Model cloud(m_device, "res/model/cloud.obj",
-	            TextureLibrary::get()->getTexture(m_device, "res/texture/default.png"),
-	            ShaderLibrary::get()->getShader(m_device, "cloud"));
-	cloud.getTransform().setTranslation(glm::vec3(-400.0f, 110.0f, 500.0f));
-	cloud.getTransform().setScale(glm::vec3(100.0f, 50.0f, 150.0f));
-	Model cloud2(m_device, "res/model/cloud.obj",
-	             TextureLibrary::get()->getTexture(m_device, "res/texture/default.png"),
-	             ShaderLibrary::get()->getShader(m_device, "cloud"));
-	cloud2.getTransform().setTranslation(glm::vec3(-300.0f, 150.0f, 250.0f));
-	cloud2.getTransform().setScale(glm::vec3(100.0f, 50.0f, 150.0f));
+Scene Application::createScene() {
+	Scene scene;
+	scene.mountain = CreateScopedRef<Model>(
+		m_device, "res/model/mountain.obj",
+		TextureLibrary::get()->getTexture(m_device, "res/texture/mountain.png"),
+		ShaderLibrary::get()->getShader(m_device, "model"),
+		TextureLibrary::get()->getTexture(m_device, "res/model/mountain.norm"));
+	scene.mountain->getTransform().setTranslation({-300.0f, 10.0f, 250.0f});
 
-	Atmosphere atmos;
-	atmos.wavelengths = {700.0f, 530.0f, 440.0f};
-	atmos.time = 0;
-	atmos.radius = 500.0f;
-	atmos.offsetFactor = 0.997f;
-	atmos.densityFalloff = 4.0;
-	atmos.scatteringStrength = 2.0f;
-	atmos.numInScatteringPoints = 10;
-	atmos.numOpticalDepthPoints = 10;
+	scene.cloud = CreateScopedRef<Model>(
+		m_device, "res/model/cloud.obj",
+		TextureLibrary::get()->getTexture(m_device, "res/texture/default.png"),
+		ShaderLibrary::get()->getShader(m_device, "cloud"));
+	scene.cloud->setRenderState(RenderState::transparent());
+	scene.clouds.resize(2);
+	scene.clouds[0].setTranslation(glm::vec3(-400.0f, 110.0f, 500.0f));
+	scene.clouds[0].setScale(glm::vec3(100.0f, 50.0f, 150.0f));
+	scene.clouds[1].setTranslation(glm::vec3(-300.0f, 150.0f, 250.0f));
+	scene.clouds[1].setScale(glm::vec3(100.0f, 50.0f, 150.0f));
 
-	CloudSettings cloudSettings;
-
-	LightSource light;
-	light.color = glm::vec3(0.988f, 0.415f, 0.227f);
-	light.ambientStrength = 0.1f;
-	light.diffuseStrength = 25.0f;
+	scene.atmos = defaultAtmosphere();
+	scene.light = defaultLight();
+	deriveSky(scene.atmos, scene.light, scene.mountain->getTransform().getTranslation());
+	scene.cloudSettings.noiseVolume = m_cloudNoise->getIndex();
+	scene.cloudSettings.noisePeriod = m_cloudNoise->getPeriod();
 
 	m_camera->lookAt({-300.0f, 65.0f, 250.0f});
 
+	scene.camVPUniform = m_renderer->getUniform<glm::mat4>("camVP");
+	scene.cloudSettingsUniform = m_renderer->getUniform<CloudSettings>("cloudSettings");
+	return scene;
+}
+
+void Application::updateSceneUniforms(const Scene& scene, const glm::mat4& camVP) {
+	m_renderer->updateUniform(scene.camVPUniform, camVP);
+	m_renderer->updateAtmosphere(scene.atmos);
+	m_renderer->updateLight(scene.light);
+	m_renderer->updateUniform(scene.cloudSettingsUniform, scene.cloudSettings);
+}
+
+void Application::run() {
+	Scene scene = createScene();
+	Model& mountain = *scene.mountain;
+	Model& cloud = *scene.cloud;
+	std::vector<Transform>& clouds = scene.clouds;
+	Atmosphere& atmos = scene.atmos;
+	LightSource& light = scene.light;
+	CloudSettings& cloudSettings = scene.cloudSettings;
+	int numClouds = clouds.size();
+	std::mt19937 cloudRng(0); // fixed seed, so the same count always gives the same sky
+
+	// Clouds are indexed by world bounds, so only those in view are submitted, and the one under
+	// the mouse can be picked
+	BVH cloudIndex;
+	std::vector<uint32_t> cloudHandles;
+	auto cloudBounds = [&](Transform& transform) {
+		return cloud.getLocalAABB().transformed(transform.getTRS());
+	};
+	for (uint32_t i = 0; i < clouds.size(); i++) {
+		cloudHandles.push_back(cloudIndex.insert(cloudBounds(clouds[i]), i));
+	}
+	cloudIndex.rebuild();
+	std::vector<uint32_t> visibleCloudIdx;
+	std::vector<Transform> visibleClouds;
+	int pickedCloud = -1;
+
+	// Sample counts of the sky's lookup tables. Both are baked far below screen resolution, so
+	// they can afford many more samples than marching every pixel could
+	int numInScatteringPoints = 16;
+	int numOpticalDepthPoints = 32;
+	m_renderer->setInScatteringSamples(numInScatteringPoints);
+	m_renderer->setOpticalDepthSamples(numOpticalDepthPoints);
+	// The sky is smooth, so it is drawn at half resolution and upsampled around geometry
+	const char* skyScaleNames[] = {"Full", "1/2", "1/4"};
+	int skyScaleIdx = 1;
+	m_renderer->setSkyScale(1u << skyScaleIdx);
+	// While the sun moves slowly, the sky is marched a quarter at a time
+	bool temporalSky = true;
+	m_renderer->setTemporalSky(temporalSky);
+	bool spreadSkyCubemap = false;
+	// Indexed by SkyModel. The analytic sky skips the lookup tables for a rougher, cheaper sky
+	const char* skyModelNames[] = {"Integrated", "Analytic"};
+	int skyModelIdx = SKY_MODEL_INTEGRATED;
+	// Machines differ too much for one set of sky settings, so by default they are picked to fit
+	// a GPU time budget. The settings above apply when this is turned off
+	bool governSkyQuality = true;
+	float skyBudget = 1.5f;
+	m_renderer->setSkyBudget(skyBudget);
+	m_renderer->setSkyQualityGovernor(governSkyQuality);
+	governSkyQuality = m_renderer->isSkyQualityGoverned();
+
+	bool gpuCulling = true;
+
 	while (!m_window->shouldClose()) {
 		double newTime = glfwGetTime();
 		double dt = (newTime - m_time) / 0.0166666;
@@ -78,11 +179,33 @@ void Application::run() {
 
 		m_renderer->beginScene();
 
-		// Draw models
+		// Draw models. These are queued, then sorted to minimize state changes
+		glm::mat4 camVP = m_camera->getVP();
+		m_renderer->setView(m_camera->getTransform().getTranslation(), camVP);
 		m_renderer->draw(mountain);
 		// m_renderer->draw(skybox);
-		m_renderer->draw(cloud);
-		m_renderer->draw(cloud2);
+
+		cloudIndex.update();
+		visibleCloudIdx.clear();
+		cloudIndex.queryFrustum(Frustum::fromViewProj(camVP), visibleCloudIdx);
+		visibleClouds.clear();
+		for (uint32_t idx : visibleCloudIdx) {
+			visibleClouds.push_back(clouds[idx]);
+		}
+		if (!visibleClouds.empty()) {
+			m_renderer->drawInstanced(cloud, visibleClouds);
+		}
+
+		// Pick the cloud under the mouse on right click
+		if (Input::isMouseButtonPressed(GLFW_MOUSE_BUTTON_2)) {
+			VkExtent2D screenSize = m_window->getFramebufferSize();
+			glm::vec3 origin = m_camera->getTransform().getTranslation();
+			glm::vec3 dir = glm::normalize(
+				m_camera->getMousePos(Input::getMousePos(), {screenSize.width, screenSize.height}) -
+				origin);
+			std::optional<RayHit> hit = cloudIndex.raycast(origin, dir);
+			pickedCloud = hit.has_value() ? static_cast<int>(hit->userData) : -1;
+		}
 
 		m_renderer->endModelRendering();
 		m_renderer->beginUIRendering();
@@ -91,6 +214,43 @@ void Application::run() {
 		ImGui::ShowDemoWindow();
 		ImGui::Begin("Demo");
 
+		ImGui::SeparatorText("Render Stats: ");
+		const CommandStats& stats = m_renderer->getStats();
+		ImGui::Text("Draws: %u", stats.draws);
+		ImGui::Text("Dispatches: %u", stats.dispatches);
+		ImGui::Text("Pipeline binds: %u", stats.pipelineBinds);
+		ImGui::Text("Descriptor set binds: %u", stats.descriptorSetBinds);
+		ImGui::Text("Vertex / index binds: %u / %u", stats.vertexBufferBinds,
+		            stats.indexBufferBinds);
+		ImGui::Text("Dynamic state: %u", stats.dynamicStates);
+		ImGui::Text("Skipped calls: %u", stats.skipped);
+		ImGui::Text("Secondary command buffers: %u", stats.secondaryBuffers);
+		ImGui::Text("Static pass recordings: %u", m_renderer->getStaticRecordCount());
+		ImGui::Text("Sky LUT bakes: %u", m_renderer->getSkyBakeCount());
+		for (const auto& [scope, ms] : m_renderer->getGpuTimings()) {
+			ImGui::Text("%s: %.3f ms (GPU)", scope.c_str(), ms);
+		}
+		SkyModelDelta skyDelta = m_renderer->getSkyModelDelta();
+		if (skyDelta.measured) {
+			ImGui::Text("Analytic sky delta: %.4f RMSE (%.1f%%)%s", skyDelta.rmse,
+			            100.0f * skyDelta.relativeError, skyDelta.current ? "" : " (stale)");
+		} else {
+			ImGui::Text("Analytic sky delta: not measured yet");
+		}
+		ImGui::Text("Clouds in view: %zu / %u%s", visibleClouds.size(), cloudIndex.size(),
+		            cloudIndex.isRebuilding() ? " (rebuilding index)" : "");
+		ImGui::Text("Picked cloud: %d", pickedCloud);
+		const CullStats& cullStats = m_renderer->getCullStats();
+		if (cullStats.onGpu) {
+			ImGui::Text("Objects: %u (culled on GPU)", cullStats.visible);
+		} else {
+			ImGui::Text("Objects visible / culled: %u / %u (" SUNSET_SIMD_NAME ")",
+			            cullStats.visible, cullStats.culled);
+		}
+		if (m_renderer->supportsGpuCulling() && ImGui::Checkbox("GPU culling", &gpuCulling)) {
+			m_renderer->setGpuCulling(gpuCulling);
+		}
+
 		ImGui::SeparatorText("Atmosphere Settings: ");
 		ImGui::PushID("Atmosphere");
 		ImGui::DragFloat3("Wavelenths", glm::value_ptr(atmos.wavelengths), 1.0f, 100, 1000);
@@ -99,15 +259,48 @@ void Application::run() {
 		ImGui::DragFloat("Offset", &atmos.offsetFactor, 0.001f, 0.95f, 1.0f);
 		ImGui::DragFloat("Density Falloff", &atmos.densityFalloff, 0.1f, 0.0f, 10.0f);
 		ImGui::DragFloat("Scattering Strength", &atmos.scatteringStrength, 0.1f, 0.0f, 10.0f);
-		ImGui::DragInt("In Scatter Points", &atmos.numInScatteringPoints, 1.0f, 5, 20);
-		ImGui::DragInt("Depth Points", &atmos.numOpticalDepthPoints, 1.0f, 5, 20);
+		if (ImGui::Combo("Sky Model", &skyModelIdx, skyModelNames, IM_ARRAYSIZE(skyModelNames))) {
+			m_renderer->setSkyModel(static_cast<SkyModel>(skyModelIdx));
+		}
+		if (ImGui::Checkbox("Govern Sky Quality", &governSkyQuality)) {
+			m_renderer->setSkyQualityGovernor(governSkyQuality);
+			governSkyQuality = m_renderer->isSkyQualityGoverned();
+			if (!governSkyQuality) {
+				// Back to the settings picked by hand
+				m_renderer->setInScatteringSamples(numInScatteringPoints);
+				m_renderer->setOpticalDepthSamples(numOpticalDepthPoints);
+				m_renderer->setSkyScale(1u << skyScaleIdx);
+				m_renderer->setSkyViewDivisor(1);
+			}
+		}
+		if (governSkyQuality) {
+			const QualityGovernor& governor = m_renderer->getSkyQualityGovernor();
+			if (ImGui::DragFloat("Sky GPU Budget (ms)", &skyBudget, 0.05f, 0.1f, 10.0f)) {
+				m_renderer->setSkyBudget(skyBudget);
+			}
+			ImGui::Text("Sky quality: %s (%.3f ms)", governor.getLevel().name,
+			            governor.getSmoothedTime());
+		}
+		ImGui::BeginDisabled(governSkyQuality);
+		if (ImGui::DragInt("In Scatter Points", &numInScatteringPoints, 1.0f, 5, 64)) {
+			m_renderer->setInScatteringSamples(numInScatteringPoints);
+		}
+		if (ImGui::DragInt("Depth Points", &numOpticalDepthPoints, 1.0f, 5, 256)) {
+			m_renderer->setOpticalDepthSamples(numOpticalDepthPoints);
+		}
+		if (ImGui::Combo("Sky Resolution", &skyScaleIdx, skyScaleNames,
+		                 IM_ARRAYSIZE(skyScaleNames))) {
+			m_renderer->setSkyScale(1u << skyScaleIdx);
+		}
+		ImGui::EndDisabled();
+		if (ImGui::Checkbox("Temporal Sky Updates", &temporalSky)) {
+			m_renderer->setTemporalSky(temporalSky);
+		}
+		if (ImGui::Checkbox("Spread Sky Cubemap Bake", &spreadSkyCubemap)) {
+			m_renderer->setSpreadSkyCubemap(spreadSkyCubemap);
+		}
 		ImGui::PopID();
-		atmos.defractionCoef =
-			atmos.scatteringStrength * glm::pow(400.0f / atmos.wavelengths, {4.0f, 4.0f, 4.0f});
-		atmos.center = -glm::vec3(0.0f, atmos.radius, 0.0f) * atmos.offsetFactor;
-		float theta = atmos.time * glm::pi<float>() / 2.0f;
-		light.pos = 1000.0f * glm::vec3(0.0f, glm::cos(theta), -glm::sin(theta)) +
-		            mountain.getTransform().getTranslation();
+		deriveSky(atmos, light, mountain.getTransform().getTranslation());
 
 		ImGui::SeparatorText("Light Settings: ");
 		ImGui::PushID("Light");
@@ -132,6 +325,24 @@ void Application::run() {
 		ImGui::DragFloat("Noise Frequency", &cloudSettings.noiseFreq, 0.1f, 1.0f, 50.0f);
 		ImGui::DragFloat("Base intensity", &cloudSettings.baseIntensity, 0.01f, 0.0f, 1.0f);
 		ImGui::DragFloat("Opacity", &cloudSettings.opacity, 0.01f, 0.0f, 1.0f);
+		if (ImGui::DragInt("Count", &numClouds, 1.0f, 2, 1000)) {
+			// Scatter any extra clouds over the sky around the mountain
+			std::uniform_real_distribution<float> x(-1500.0f, 900.0f), y(100.0f, 250.0f),
+				z(-1000.0f, 1500.0f), size(0.5f, 1.5f);
+			while (clouds.size() < static_cast<size_t>(numClouds)) {
+				Transform& transform = clouds.emplace_back();
+				transform.setTranslation({x(cloudRng), y(cloudRng), z(cloudRng)});
+				transform.setScale(size(cloudRng) * glm::vec3(100.0f, 50.0f, 150.0f));
+				uint32_t idx = clouds.size() - 1;
+				cloudHandles.push_back(cloudIndex.insert(cloudBounds(transform), idx));
+			}
+			while (clouds.size() > static_cast<size_t>(numClouds)) {
+				cloudIndex.remove(cloudHandles.back());
+				cloudHandles.pop_back();
+				clouds.pop_back();
+			}
+			pickedCloud = -1;
+		}
 		ImGui::PopID();
 
 		ImGui::End();
@@ -140,16 +351,43 @@ void Application::run() {
 
 		// update uniforms
 		m_camController->OnUpdate(dt);
-		glm::mat4 camVP = m_camera->getVP();
-		m_renderer->updateUniform("camVP", &camVP);
-		m_renderer->updateUniform("atmos", &atmos);
-		m_renderer->updateUniform("light", &light); // do this in loop b/c >1 framebuffers
-		m_renderer->updateUniform("cloudSettings", &cloudSettings);
+		updateSceneUniforms(scene, m_camera->getVP()); // do this in loop b/c >1 framebuffers
 	}
 
 	m_device->flush();
 }
 
+void Application::runSweep(const std::string& csvPath) {
+	if (!m_device->supportsTimestamps()) {
+		LOG_WARN("GPU timestamps are unsupported, every sweep point will cost 0 ms");
+	}
+
+	// The scene run() starts with, seen from a fixed camera
+	Scene scene = createScene();
+	glm::mat4 camVP = m_camera->getVP();
+
+	SweepSky sky = {scene.atmos, scene.light, camVP};
+	QualitySweep sweep(m_renderer, sky, [&](float noiseFreq, bool drawModels) {
+		m_window->pollEvents();
+		m_renderer->beginScene();
+		m_renderer->setView(m_camera->getTransform().getTranslation(), camVP);
+		if (drawModels) {
+			m_renderer->draw(*scene.mountain);
+			m_renderer->drawInstanced(*scene.cloud, scene.clouds);
+		}
+		m_renderer->endModelRendering();
+		// Nothing is drawn, but ImGui still expects a frame
+		m_renderer->beginUIRendering();
+		m_renderer->endScene();
+
+		scene.cloudSettings.noiseFreq = noiseFreq;
+		updateSceneUniforms(scene, camVP);
+	});
+	QualitySweep::writeCSV(sweep.run(), csvPath);
+
+	m_device->flush();
+}
+
 void Application::shutdown() {
 	TextureLibrary::get()->cleanup();
 	ShaderLibrary::get()->cleanup();
@@ -4,6 +4,8 @@
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/gtx/string_cast.hpp>
 #include <glm/gtx/hash.hpp>
+#include <string>
+#include <vector>
 
 #include "application/camera_controller.hpp"
 #include "bootstrap/device.hpp"
@@ -11,6 +13,7 @@
 #include "bootstrap/window.hpp"
 #include "renderer/renderer.hpp"
 #include "renderer/camera.hpp"
+#include "renderer/noise_volume.hpp"
 
 struct Vertex {
 	glm::vec3 pos;
@@ -33,18 +36,54 @@ namespace std {
 	};
 } // namespace std
 
+/**
+ * @struct Scene
+ * @brief What run() and runSweep() both start out drawing, and the uniforms it is drawn with
+ */
+struct Scene {
+	ScopedRef<Model> mountain;
+	/* Every cloud shares one mesh, and is drawn in a single instanced draw */
+	ScopedRef<Model> cloud;
+	std::vector<Transform> clouds;
+
+	Atmosphere atmos;
+	LightSource light;
+	CloudSettings cloudSettings;
+
+	UniformHandle<glm::mat4> camVPUniform;
+	UniformHandle<CloudSettings> cloudSettingsUniform;
+};
+
 class Application {
 
   public:
 	inline static Application& get() { return *s_instance; }
-	Application();
+	/**
+	 * @param headless Whether to hide the window, i.e. to sweep settings with nobody watching
+	 */
+	Application(bool headless = false);
 	~Application() = default;
 
   public:
 	void run();
+	/**
+	 * @brief Renders a fixed view at a grid of sky and cloud settings instead of running
+	 * interactively, and writes what each cost and how it looked to a CSV, see QualitySweep
+	 */
+	void runSweep(const std::string& csvPath);
 	void shutdown();
 	inline const Ref<GLFWWindow> getWindow() const { return m_window; }
 
+  private:
+	/**
+	 * @brief Loads the scene's models, sets up its sky and clouds, and points the camera at it
+	 */
+	Scene createScene();
+	/**
+	 * @brief Writes the scene's camera, sky, light and cloud settings to the next frame's uniforms
+	 */
+	void updateSceneUniforms(const Scene& scene, const glm::mat4& camVP);
+
   private:
 	static Application* s_instance;
 
@@ -52,6 +91,8 @@ class Application {
 	Ref<VulkanInstance> m_instance;
 	Ref<VulkanDevice> m_device;
 	Ref<VulkanRenderer> m_renderer;
+	/* Noise clouds are shaded and displaced with, baked once at start up */
+	Ref<NoiseVolume> m_cloudNoise;
 	Ref<Camera> m_camera;
 	Ref<CameraController> m_camController;
 
@@ -0,0 +1,232 @@
+#include "quality_sweep.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+
+#include "util/constants.hpp"
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+
+// Values swept of each setting. Every combination is rendered
+static const std::vector<uint32_t> IN_SCATTERING_POINTS = {8, 16, 32};
+static const std::vector<uint32_t> OPTICAL_DEPTH_POINTS = {8, 32, 128};
+static const std::vector<float> NOISE_FREQUENCIES = {5.0f, 10.0f, 20.0f};
+static const std::vector<uint32_t> SKY_SCALES = {1, 2, 4};
+// Sample counts of the reference, well past where more samples stop changing the image
+static const uint32_t REFERENCE_IN_SCATTERING_POINTS = 256;
+static const uint32_t REFERENCE_OPTICAL_DEPTH_POINTS = 256;
+// Sample counts of the sky integrated on the CPU. It marches differently to the GPU, so its
+// counts are kept well past any the GPU renders with
+static const ReferenceSkySettings CPU_REFERENCE_SETTINGS = {256, 256};
+// Frames rendered after a change before anything is measured. Covers the frames in flight, and
+// the low resolution sky being created again when its scale changes
+static const uint32_t WARM_UP_FRAMES = 2 * MAX_FRAMES_IN_FLIGHT + 4;
+// Frames timed of each kind. Timestamps of single frames are noisy
+static const uint32_t TIMED_FRAMES = 16;
+// GPU profiler scope of the geometry pass, see VulkanRenderer::endModelRendering
+static const char* const GEOMETRY_SCOPE = "Geometry pass";
+
+QualitySweep::QualitySweep(Ref<VulkanRenderer> renderer, const SweepSky& sky,
+                           const std::function<void(float noiseFreq, bool drawModels)>& renderFrame)
+	: m_renderer(renderer), m_sky(sky), m_renderFrame(renderFrame) {}
+
+std::vector<SweepPoint> QualitySweep::getGrid() {
+	std::vector<SweepPoint> grid;
+	for (float noiseFreq : NOISE_FREQUENCIES) {
+		for (uint32_t skyScale : SKY_SCALES) {
+			for (uint32_t inScattering : IN_SCATTERING_POINTS) {
+				for (uint32_t opticalDepth : OPTICAL_DEPTH_POINTS) {
+					grid.push_back({inScattering, opticalDepth, noiseFreq, skyScale});
+				}
+			}
+		}
+	}
+	return grid;
+}
+
+std::vector<SweepResult> QualitySweep::run() {
+	PROFILE_FUNC();
+	m_renderer->setSkyQualityGovernor(false);
+	m_renderer->setSkyModel(SKY_MODEL_INTEGRATED);
+	m_renderer->setTemporalSky(false);
+	m_renderer->setSpreadSkyCubemap(false);
+	m_renderer->setSkyViewDivisor(1);
+
+	std::vector<SweepPoint> grid = getGrid();
+	std::vector<SweepResult> results;
+	for (uint32_t i = 0; i < grid.size(); i++) {
+		results.push_back(measure(grid[i]));
+		const SweepResult& result = results.back();
+		LOG_INFO("Sweep {0}/{1}: {2} in-scatter, {3} optical depth, noise {4}, 1/{5} sky: "
+		         "{6:.3f} ms, {7:.2f} dB PSNR, {8:.4f} SSIM, sky {9:.2f} dB PSNR",
+		         i + 1, grid.size(), result.point.inScatteringPoints,
+		         result.point.opticalDepthPoints, result.point.noiseFreq, result.point.skyScale,
+		         result.getCost(), result.psnr, result.ssim, result.skyPsnr);
+	}
+
+	markParetoFrontier(results);
+	return results;
+}
+
+void QualitySweep::apply(const SweepPoint& point) {
+	m_renderer->setInScatteringSamples(point.inScatteringPoints);
+	m_renderer->setOpticalDepthSamples(point.opticalDepthPoints);
+	m_renderer->setSkyScale(point.skyScale);
+}
+
+void QualitySweep::warmUp(float noiseFreq) {
+	for (uint32_t i = 0; i < WARM_UP_FRAMES; i++) {
+		m_renderFrame(noiseFreq, true);
+	}
+}
+
+RgbaImage QualitySweep::capture(float noiseFreq, bool drawModels) {
+	m_renderer->requestCapture();
+	m_renderFrame(noiseFreq, drawModels);
+	RgbaImage image = m_renderer->getCapture();
+	if (image.empty()) {
+		throw std::runtime_error("failed to capture sweep frame!");
+	}
+	return image;
+}
+
+const RgbaImage& QualitySweep::getReference(float noiseFreq) {
+	auto reference = m_references.find(noiseFreq);
+	if (reference != m_references.end()) {
+		return reference->second;
+	}
+
+	PROFILE_FUNC();
+	LOG_INFO("Rendering sweep reference for noise frequency {0}", noiseFreq);
+	apply({REFERENCE_IN_SCATTERING_POINTS, REFERENCE_OPTICAL_DEPTH_POINTS, noiseFreq, 1});
+	warmUp(noiseFreq);
+	const RgbaImage& frame = m_references[noiseFreq] = capture(noiseFreq);
+	if (m_skyReference.empty()) {
+		float skyPsnr = image::psnr(capture(noiseFreq, false), getSkyReference(frame));
+		LOG_INFO("Sky of the reference is {0:.2f} dB PSNR from the CPU integral", skyPsnr);
+	}
+	return frame;
+}
+
+const RgbaImage& QualitySweep::getSkyReference(const RgbaImage& frame) {
+	if (!m_skyReference.empty()) {
+		return m_skyReference;
+	}
+
+	PROFILE_FUNC();
+	auto start = std::chrono::steady_clock::now();
+	AtmosphereIntegrator integrator;
+	std::vector<glm::vec4> sky = integrator.renderSky(m_sky.atmosphere, m_sky.light,
+	                                                  m_sky.viewProj, frame.size,
+	                                                  CPU_REFERENCE_SETTINGS);
+	m_skyReference = image::quantize(sky, frame.size, frame.srgb);
+
+	float seconds =
+		std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+	LOG_INFO("Integrated {0}x{1} reference sky on the CPU in {2:.1f} s", frame.size.x,
+	         frame.size.y, seconds);
+	return m_skyReference;
+}
+
+SweepResult QualitySweep::measure(const SweepPoint& point) {
+	PROFILE_FUNC();
+	SweepResult result;
+	result.point = point;
+	const RgbaImage& reference = getReference(point.noiseFreq);
+
+	apply(point);
+	warmUp(point.noiseFreq);
+
+	// Timings are read back MAX_FRAMES_IN_FLIGHT frames after they are rendered, so the first
+	// frames of each run report the frames before it
+	auto timeFrames = [&](bool bake, float& skyTime) {
+		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT + TIMED_FRAMES; i++) {
+			if (bake) {
+				m_renderer->invalidateSky();
+			}
+			m_renderFrame(point.noiseFreq, true);
+			if (i < MAX_FRAMES_IN_FLIGHT) {
+				continue;
+			}
+
+			skyTime += m_renderer->getSkyGpuTime() / TIMED_FRAMES;
+			auto geometry = m_renderer->getGpuTimings().find(GEOMETRY_SCOPE);
+			if (geometry != m_renderer->getGpuTimings().end()) {
+				result.geometryTime += geometry->second / (2 * TIMED_FRAMES);
+			}
+		}
+	};
+	timeFrames(true, result.bakeSkyTime);
+	timeFrames(false, result.steadySkyTime);
+
+	RgbaImage frame = capture(point.noiseFreq);
+	result.psnr = image::psnr(frame, reference);
+	result.ssim = image::ssim(frame, reference);
+	result.skyPsnr = image::psnr(capture(point.noiseFreq, false), getSkyReference(frame));
+	return result;
+}
+
+void QualitySweep::markParetoFrontier(std::vector<SweepResult>& results) {
+	for (SweepResult& result : results) {
+		result.pareto = std::none_of(results.begin(), results.end(), [&](const SweepResult& other) {
+			bool noWorse = other.getCost() <= result.getCost() && other.psnr >= result.psnr &&
+			               other.ssim >= result.ssim;
+			bool better = other.getCost() < result.getCost() || other.psnr > result.psnr ||
+			              other.ssim > result.ssim;
+			return noWorse && better;
+		});
+	}
+}
+
+/**
+ * @brief Writes the header and one row per result
+ */
+static void writeRows(const std::vector<const SweepResult*>& results, const std::string& path) {
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open sweep CSV " + path + "!");
+	}
+
+	file << "in_scattering_points,optical_depth_points,noise_freq,sky_scale,bake_sky_ms,"
+	        "steady_sky_ms,geometry_ms,cost_ms,psnr_db,ssim,sky_psnr_db,pareto\n";
+	for (const SweepResult* result : results) {
+		file << result->point.inScatteringPoints << ',' << result->point.opticalDepthPoints << ','
+		     << result->point.noiseFreq << ',' << result->point.skyScale << ','
+		     << result->bakeSkyTime << ',' << result->steadySkyTime << ','
+		     << result->geometryTime << ',' << result->getCost() << ',' << result->psnr << ','
+		     << result->ssim << ',' << result->skyPsnr << ',' << (result->pareto ? 1 : 0) << '\n';
+	}
+}
+
+void QualitySweep::writeCSV(const std::vector<SweepResult>& results, const std::string& path) {
+	std::vector<const SweepResult*> all, frontier;
+	for (const SweepResult& result : results) {
+		all.push_back(&result);
+		if (result.pareto) {
+			frontier.push_back(&result);
+		}
+	}
+	std::sort(frontier.begin(), frontier.end(), [](const SweepResult* a, const SweepResult* b) {
+		return a->getCost() < b->getCost();
+	});
+
+	size_t extension = path.find_last_of('.');
+	if (extension == std::string::npos || extension < path.find_last_of("/\\") + 1) {
+		extension = path.size();
+	}
+	std::string frontierPath = path.substr(0, extension) + "_pareto" + path.substr(extension);
+
+	writeRows(all, path);
+	writeRows(frontier, frontierPath);
+	LOG_INFO("Wrote {0} sweep results to {1}, and the {2} on the Pareto frontier to {3}",
+	         all.size(), path, frontier.size(), frontierPath);
+	for (const SweepResult* result : frontier) {
+		LOG_INFO("  {0:.3f} ms: {1} in-scatter, {2} optical depth, noise {3}, 1/{4} sky "
+		         "({5:.2f} dB, {6:.4f} SSIM)",
+		         result->getCost(), result->point.inScatteringPoints,
+		         result->point.opticalDepthPoints, result->point.noiseFreq,
+		         result->point.skyScale, result->psnr, result->ssim);
+	}
+}
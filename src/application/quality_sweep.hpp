@@ -0,0 +1,131 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "renderer/atmosphere_integrator.hpp"
+#include "renderer/renderer.hpp"
+#include "util/image_compare.hpp"
+#include "util/memory.hpp"
+
+/* One combination of the settings swept */
+struct SweepPoint {
+	/* Samples marched for each texel of the sky-view LUT */
+	uint32_t inScatteringPoints;
+	/* Samples integrated for each texel of the optical depth LUT */
+	uint32_t opticalDepthPoints;
+	/* CloudSettings::noiseFreq */
+	float noiseFreq;
+	/* Screen pixels along each side of a texel of the sky */
+	uint32_t skyScale;
+};
+
+/* The sky of the swept view, as the CPU reference integrates it, see AtmosphereIntegrator */
+struct SweepSky {
+	Atmosphere atmosphere;
+	LightSource light;
+	/* The camera, which the atmosphere pass assumes is at the origin */
+	glm::mat4 viewProj;
+};
+
+/* What one point of the sweep cost on the GPU, and how close it came to the reference */
+struct SweepResult {
+	SweepPoint point;
+	/* Mean GPU time of the sky in frames baking every table, and in frames baking none, in
+	 * milliseconds */
+	float bakeSkyTime = 0.0f;
+	float steadySkyTime = 0.0f;
+	/* Mean GPU time of the geometry pass, which draws the clouds, in milliseconds */
+	float geometryTime = 0.0f;
+	/* Against the reference rendered at the same noise frequency, see image::psnr and
+	 * image::ssim */
+	float psnr = 0.0f;
+	float ssim = 0.0f;
+	/* Of a frame with no models drawn, against the sky integrated on the CPU, in decibels */
+	float skyPsnr = 0.0f;
+	/* Whether no other point is at least as cheap and as close to the reference, and better in
+	 * one of them */
+	bool pareto = false;
+
+	/**
+	 * @brief Gets the GPU time of a frame in which the sky changes, the cost the frontier is
+	 * taken over
+	 */
+	inline float getCost() const { return bakeSkyTime + geometryTime; }
+};
+
+/**
+ * @class QualitySweep
+ * @brief Renders a fixed view at every point of a grid of sky and cloud settings, to find which
+ * settings buy the most quality for their GPU time
+ *
+ * Each point is timed with the GPU profiler, both in frames where every sky table is baked and in
+ * frames where none are, and its final image is compared to a reference rendered with far more
+ * samples than any point, at full resolution. Clouds change with the noise frequency rather than
+ * converging, so there is one reference for each frequency.
+ *
+ * The sky alone is also rendered at each point, with no models in front of it, and compared to
+ * the sky integrated on the CPU by an AtmosphereIntegrator. That reference shares none of the
+ * GPU's tables, so it also shows how far the high sample reference itself is from converging.
+ *
+ * The governor, temporal updates and spread cubemap bakes are turned off, so every frame renders
+ * exactly the settings under test. Needs GPU timestamps, and swapchain images which can be copied
+ * out of.
+ */
+class QualitySweep {
+  public:
+	/**
+	 * @param sky What the scene's sky is integrated from on the CPU
+	 * @param renderFrame Renders and submits one frame of the scene, with clouds at the given
+	 * noise frequency, or only the sky if drawModels is false. Uniforms written after a frame
+	 * apply to the ones after it
+	 */
+	QualitySweep(Ref<VulkanRenderer> renderer, const SweepSky& sky,
+	             const std::function<void(float noiseFreq, bool drawModels)>& renderFrame);
+
+	QualitySweep(const QualitySweep&) = delete;
+
+	/**
+	 * @brief Renders every point of the grid, and marks those on the Pareto frontier
+	 */
+	std::vector<SweepResult> run();
+	/**
+	 * @brief Writes one row per result to path, and the Pareto frontier alone, cheapest first, to
+	 * the same path with "_pareto" before the extension
+	 */
+	static void writeCSV(const std::vector<SweepResult>& results, const std::string& path);
+	/**
+	 * @brief Gets every point swept, in the order they are rendered
+	 */
+	static std::vector<SweepPoint> getGrid();
+
+  private:
+	void apply(const SweepPoint& point);
+	/**
+	 * @brief Renders frames until settings applied before them have reached every frame in flight
+	 */
+	void warmUp(float noiseFreq);
+	/**
+	 * @brief Renders the settings currently applied, and reads back the final frame
+	 */
+	RgbaImage capture(float noiseFreq, bool drawModels = true);
+	const RgbaImage& getReference(float noiseFreq);
+	/**
+	 * @brief Integrates the sky on the CPU at the size and encoding of the given frame, the first
+	 * time it is called
+	 */
+	const RgbaImage& getSkyReference(const RgbaImage& frame);
+	SweepResult measure(const SweepPoint& point);
+	static void markParetoFrontier(std::vector<SweepResult>& results);
+
+  private:
+	Ref<VulkanRenderer> m_renderer;
+	SweepSky m_sky;
+	std::function<void(float, bool)> m_renderFrame;
+	/* Rendered the first time each noise frequency is swept */
+	std::map<float, RgbaImage> m_references;
+	/* Integrated the first time any reference is rendered. The sky doesn't depend on the clouds */
+	RgbaImage m_skyReference;
+};
@@ -0,0 +1,270 @@
+#include "command_encoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+CommandEncoder::CommandEncoder(Ref<VulkanDevice> device) : m_device(device) {}
+
+void CommandEncoder::begin(VkCommandBuffer commandBuffer) {
+	m_commandBuffer = commandBuffer;
+	m_stats = {};
+	invalidate();
+}
+
+void CommandEncoder::invalidate() {
+	m_bindPoints = {};
+	m_vertexBindings = {};
+	m_indexBinding = {};
+	m_pushConstants.layout = VK_NULL_HANDLE;
+	m_dynamicState = {};
+}
+
+void CommandEncoder::beginRenderPass(const VkRenderPassBeginInfo& beginInfo,
+                                     VkSubpassContents contents) {
+	vkCmdBeginRenderPass(m_commandBuffer, &beginInfo, contents);
+}
+
+void CommandEncoder::endRenderPass() { vkCmdEndRenderPass(m_commandBuffer); }
+
+void CommandEncoder::executeCommands(uint32_t count, const VkCommandBuffer* commandBuffers) {
+	vkCmdExecuteCommands(m_commandBuffer, count, commandBuffers);
+	m_stats.secondaryBuffers += count;
+	invalidate();
+}
+
+void CommandEncoder::bindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline) {
+	BindPointState& state = getBindPointState(bindPoint);
+	if (state.pipeline == pipeline) {
+		m_stats.skipped++;
+		return;
+	}
+
+	vkCmdBindPipeline(m_commandBuffer, bindPoint, pipeline);
+	state.pipeline = pipeline;
+	m_stats.pipelineBinds++;
+}
+
+void CommandEncoder::bindDescriptorSets(VkPipelineBindPoint bindPoint, VkPipelineLayout layout,
+                                        uint32_t firstSet, uint32_t setCount,
+                                        const VkDescriptorSet* sets) {
+	if (firstSet + setCount > MAX_DESCRIPTOR_SETS) {
+		throw std::runtime_error("failed to bind descriptor sets, too many sets!");
+	}
+
+	BindPointState& state = getBindPointState(bindPoint);
+	if (state.layout != layout) {
+		// Whether the sets bound with the old layout are still usable depends on how compatible
+		// the layouts are. Assume they are not
+		state.sets = {};
+		state.layout = layout;
+	}
+
+	// Only rebind the range of sets that changed
+	uint32_t first = setCount, last = 0;
+	for (uint32_t i = 0; i < setCount; i++) {
+		if (state.sets[firstSet + i] != sets[i]) {
+			first = std::min(first, i);
+			last = i;
+		}
+	}
+	if (first == setCount) {
+		m_stats.skipped++;
+		return;
+	}
+
+	vkCmdBindDescriptorSets(m_commandBuffer, bindPoint, layout, firstSet + first, last - first + 1,
+	                        sets + first, 0, nullptr);
+	for (uint32_t i = first; i <= last; i++) {
+		state.sets[firstSet + i] = sets[i];
+	}
+	m_stats.descriptorSetBinds++;
+}
+
+void CommandEncoder::bindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset) {
+	if (binding >= MAX_VERTEX_BINDINGS) {
+		throw std::runtime_error("failed to bind vertex buffer, binding out of range!");
+	}
+
+	VertexBinding& bound = m_vertexBindings[binding];
+	if (bound.buffer == buffer && bound.offset == offset) {
+		m_stats.skipped++;
+		return;
+	}
+
+	vkCmdBindVertexBuffers(m_commandBuffer, binding, 1, &buffer, &offset);
+	bound = {buffer, offset};
+	m_stats.vertexBufferBinds++;
+}
+
+void CommandEncoder::bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType) {
+	if (m_indexBinding.buffer == buffer && m_indexBinding.offset == offset &&
+	    m_indexBinding.indexType == indexType) {
+		m_stats.skipped++;
+		return;
+	}
+
+	vkCmdBindIndexBuffer(m_commandBuffer, buffer, offset, indexType);
+	m_indexBinding = {buffer, offset, indexType};
+	m_stats.indexBufferBinds++;
+}
+
+void CommandEncoder::pushConstants(VkPipelineLayout layout, VkShaderStageFlags stages,
+                                   uint32_t offset, uint32_t size, const void* data) {
+	if (size > MAX_PUSH_CONSTANT_SIZE) {
+		throw std::runtime_error("failed to push constants, block is too large!");
+	}
+
+	PushConstantState& state = m_pushConstants;
+	if (state.layout == layout && state.stages == stages && state.offset == offset &&
+	    state.size == size && memcmp(state.data.data(), data, size) == 0) {
+		m_stats.skipped++;
+		return;
+	}
+
+	vkCmdPushConstants(m_commandBuffer, layout, stages, offset, size, data);
+	state.layout = layout;
+	state.stages = stages;
+	state.offset = offset;
+	state.size = size;
+	memcpy(state.data.data(), data, size);
+	m_stats.pushConstants++;
+}
+
+void CommandEncoder::setCullMode(VkCullModeFlags cullMode) {
+	if (updateDynamicState(m_dynamicState.cullMode, cullMode)) {
+		m_device->getDynamicStateCommands().setCullMode(m_commandBuffer, cullMode);
+	}
+}
+
+void CommandEncoder::setFrontFace(VkFrontFace frontFace) {
+	if (updateDynamicState(m_dynamicState.frontFace, frontFace)) {
+		m_device->getDynamicStateCommands().setFrontFace(m_commandBuffer, frontFace);
+	}
+}
+
+void CommandEncoder::setDepthTestEnable(bool enable) {
+	if (updateDynamicState(m_dynamicState.depthTest, enable)) {
+		m_device->getDynamicStateCommands().setDepthTestEnable(m_commandBuffer, enable);
+	}
+}
+
+void CommandEncoder::setDepthWriteEnable(bool enable) {
+	if (updateDynamicState(m_dynamicState.depthWrite, enable)) {
+		m_device->getDynamicStateCommands().setDepthWriteEnable(m_commandBuffer, enable);
+	}
+}
+
+void CommandEncoder::setDepthCompareOp(VkCompareOp compareOp) {
+	if (updateDynamicState(m_dynamicState.depthCompare, compareOp)) {
+		m_device->getDynamicStateCommands().setDepthCompareOp(m_commandBuffer, compareOp);
+	}
+}
+
+void CommandEncoder::setColorBlendEnable(bool enable) {
+	const DynamicStateCommands& cmd = m_device->getDynamicStateCommands();
+	if (cmd.setColorBlendEnable && updateDynamicState(m_dynamicState.blend, enable)) {
+		VkBool32 blend = enable;
+		cmd.setColorBlendEnable(m_commandBuffer, 0, 1, &blend);
+	}
+}
+
+void CommandEncoder::draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex,
+                          uint32_t firstInstance) {
+	vkCmdDraw(m_commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+	m_stats.draws++;
+}
+
+void CommandEncoder::drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex,
+                                 int32_t vertexOffset, uint32_t firstInstance) {
+	vkCmdDrawIndexed(m_commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset,
+	                 firstInstance);
+	m_stats.draws++;
+}
+
+void CommandEncoder::drawIndexedIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount,
+                                         uint32_t stride) {
+	vkCmdDrawIndexedIndirect(m_commandBuffer, buffer, offset, drawCount, stride);
+	m_stats.draws++;
+}
+
+void CommandEncoder::drawIndexedIndirectCount(VkBuffer buffer, VkDeviceSize offset,
+                                              VkBuffer countBuffer, VkDeviceSize countOffset,
+                                              uint32_t maxDrawCount, uint32_t stride) {
+	m_device->getDrawIndexedIndirectCount()(m_commandBuffer, buffer, offset, countBuffer,
+	                                        countOffset, maxDrawCount, stride);
+	m_stats.draws++;
+}
+
+void CommandEncoder::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
+	vkCmdDispatch(m_commandBuffer, groupCountX, groupCountY, groupCountZ);
+	m_stats.dispatches++;
+}
+
+void CommandEncoder::fillBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+                                uint32_t data) {
+	vkCmdFillBuffer(m_commandBuffer, buffer, offset, size, data);
+}
+
+void CommandEncoder::copyImageToBuffer(VkImage image, VkImageLayout layout, VkExtent2D extent,
+                                       VkBuffer buffer) {
+	VkBufferImageCopy region {};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0; // tightly packed
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = {0, 0, 0};
+	region.imageExtent = {extent.width, extent.height, 1};
+	vkCmdCopyImageToBuffer(m_commandBuffer, image, layout, buffer, 1, &region);
+}
+
+void CommandEncoder::memoryBarrier(VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                                   VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+	VkMemoryBarrier barrier {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	vkCmdPipelineBarrier(m_commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0,
+	                     nullptr);
+}
+
+void CommandEncoder::imageBarrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                                  VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                                  VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+	VkImageMemoryBarrier barrier {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	vkCmdPipelineBarrier(m_commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1,
+	                     &barrier);
+}
+
+void CommandEncoder::resetQueryPool(VkQueryPool pool, uint32_t firstQuery, uint32_t queryCount) {
+	vkCmdResetQueryPool(m_commandBuffer, pool, firstQuery, queryCount);
+}
+
+void CommandEncoder::writeTimestamp(VkPipelineStageFlagBits stage, VkQueryPool pool,
+                                    uint32_t query) {
+	vkCmdWriteTimestamp(m_commandBuffer, stage, pool, query);
+}
+
+CommandEncoder::BindPointState& CommandEncoder::getBindPointState(VkPipelineBindPoint bindPoint) {
+	if (bindPoint >= BIND_POINT_COUNT) {
+		throw std::runtime_error("failed to bind, unsupported pipeline bind point!");
+	}
+
+	return m_bindPoints[bindPoint];
+}
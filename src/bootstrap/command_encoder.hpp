@@ -0,0 +1,210 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vulkan/vulkan_core.h>
+
+#include "device.hpp"
+#include "util/memory.hpp"
+
+/* Numbers of commands recorded by a CommandEncoder since it began its command buffer */
+struct CommandStats {
+	uint32_t draws = 0;
+	uint32_t dispatches = 0;
+	uint32_t pipelineBinds = 0;
+	uint32_t descriptorSetBinds = 0;
+	uint32_t vertexBufferBinds = 0;
+	uint32_t indexBufferBinds = 0;
+	uint32_t dynamicStates = 0;
+	uint32_t pushConstants = 0;
+	/* Calls which would not have changed anything, and so were never recorded */
+	uint32_t skipped = 0;
+	/* Secondary command buffers executed */
+	uint32_t secondaryBuffers = 0;
+
+	/* Adds in the counts of another encoder, i.e. one recording a secondary buffer */
+	CommandStats& operator+=(const CommandStats& other) {
+		draws += other.draws;
+		dispatches += other.dispatches;
+		pipelineBinds += other.pipelineBinds;
+		descriptorSetBinds += other.descriptorSetBinds;
+		vertexBufferBinds += other.vertexBufferBinds;
+		indexBufferBinds += other.indexBufferBinds;
+		dynamicStates += other.dynamicStates;
+		pushConstants += other.pushConstants;
+		skipped += other.skipped;
+		secondaryBuffers += other.secondaryBuffers;
+		return *this;
+	}
+};
+
+/**
+ * @class CommandEncoder
+ * @brief Records into a command buffer, remembering the state already bound so calls which would
+ * change nothing can be skipped
+ *
+ * Callers can bind everything a draw needs before every draw, and only the actual state changes
+ * end up in the command buffer. Anything recorded into the command buffer without going through
+ * the encoder (i.e. ImGui) leaves the cache stale, so call invalidate() afterwards.
+ */
+class CommandEncoder {
+  public:
+	CommandEncoder(Ref<VulkanDevice> device);
+	~CommandEncoder() = default;
+
+	CommandEncoder(const CommandEncoder&) = delete;
+
+	/**
+	 * @brief Starts encoding into the given command buffer, which must already be recording
+	 *
+	 * Nothing is bound in a new command buffer, so this clears the cache and the stats.
+	 */
+	void begin(VkCommandBuffer commandBuffer);
+	/**
+	 * @brief Forgets all cached state, so the next call of each kind is recorded
+	 */
+	void invalidate();
+
+	inline VkCommandBuffer getCommandBuffer() const { return m_commandBuffer; }
+	inline const CommandStats& getStats() const { return m_stats; }
+
+  public:
+	void beginRenderPass(const VkRenderPassBeginInfo& beginInfo, VkSubpassContents contents);
+	void endRenderPass();
+	/**
+	 * @brief Executes secondary command buffers. They leave the bound state undefined, so the
+	 * cache is cleared afterwards
+	 */
+	void executeCommands(uint32_t count, const VkCommandBuffer* commandBuffers);
+
+	void bindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline);
+	/**
+	 * @brief Binds descriptor sets, recording only the range of sets which actually changed
+	 *
+	 * Sets bound with a different pipeline layout are not assumed to still be valid.
+	 */
+	void bindDescriptorSets(VkPipelineBindPoint bindPoint, VkPipelineLayout layout,
+	                        uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* sets);
+	void bindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset);
+	void bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+	void pushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset,
+	                   uint32_t size, const void* data);
+
+	void setCullMode(VkCullModeFlags cullMode);
+	void setFrontFace(VkFrontFace frontFace);
+	void setDepthTestEnable(bool enable);
+	void setDepthWriteEnable(bool enable);
+	void setDepthCompareOp(VkCompareOp compareOp);
+	/**
+	 * @brief Sets blending for the first color attachment. Ignored if the device can't set it
+	 * dynamically
+	 */
+	void setColorBlendEnable(bool enable);
+
+	void draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex,
+	          uint32_t firstInstance);
+	void drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex,
+	                 int32_t vertexOffset, uint32_t firstInstance);
+	void drawIndexedIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount,
+	                         uint32_t stride);
+	/**
+	 * @brief Draws up to maxDrawCount commands, the actual number being read from countBuffer.
+	 * Requires VulkanDevice::getDrawIndexedIndirectCount
+	 */
+	void drawIndexedIndirectCount(VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer,
+	                              VkDeviceSize countOffset, uint32_t maxDrawCount, uint32_t stride);
+	void dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
+
+	void fillBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t data);
+	/**
+	 * @brief Copies the first mip of a color image, tightly packed, to the start of a buffer
+	 */
+	void copyImageToBuffer(VkImage image, VkImageLayout layout, VkExtent2D extent,
+	                       VkBuffer buffer);
+	/**
+	 * @brief Makes writes in srcStage with srcAccess visible to dstStage with dstAccess
+	 */
+	void memoryBarrier(VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+	                   VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+	/**
+	 * @brief Like memoryBarrier, but also moves every mip and layer of a color image from
+	 * oldLayout to newLayout
+	 */
+	void imageBarrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+	                  VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+	                  VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+	void resetQueryPool(VkQueryPool pool, uint32_t firstQuery, uint32_t queryCount);
+	void writeTimestamp(VkPipelineStageFlagBits stage, VkQueryPool pool, uint32_t query);
+
+  private:
+	/* Graphics and compute each have their own bound pipeline and descriptor sets */
+	static const uint32_t BIND_POINT_COUNT = 2;
+	static const uint32_t MAX_DESCRIPTOR_SETS = 4;
+	static const uint32_t MAX_VERTEX_BINDINGS = 4;
+	/* Minimum maxPushConstantsSize guaranteed by the spec */
+	static const uint32_t MAX_PUSH_CONSTANT_SIZE = 128;
+
+	struct BindPointState {
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		std::array<VkDescriptorSet, MAX_DESCRIPTOR_SETS> sets {};
+	};
+
+	struct VertexBinding {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+	};
+
+	struct IndexBinding {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+	};
+
+	struct PushConstantState {
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		VkShaderStageFlags stages = 0;
+		uint32_t offset = 0;
+		uint32_t size = 0;
+		std::array<uint8_t, MAX_PUSH_CONSTANT_SIZE> data;
+	};
+
+	struct DynamicState {
+		std::optional<VkCullModeFlags> cullMode;
+		std::optional<VkFrontFace> frontFace;
+		std::optional<bool> depthTest;
+		std::optional<bool> depthWrite;
+		std::optional<VkCompareOp> depthCompare;
+		std::optional<bool> blend;
+	};
+
+	BindPointState& getBindPointState(VkPipelineBindPoint bindPoint);
+	/**
+	 * @brief Caches a new dynamic state value
+	 *
+	 * @return Whether the value changed, and so the command needs to be recorded
+	 */
+	template <typename T> inline bool updateDynamicState(std::optional<T>& cached, T value) {
+		if (cached.has_value() && cached.value() == value) {
+			m_stats.skipped++;
+			return false;
+		}
+
+		cached = value;
+		m_stats.dynamicStates++;
+		return true;
+	}
+
+  private:
+	Ref<VulkanDevice> m_device;
+	VkCommandBuffer m_commandBuffer = VK_NULL_HANDLE;
+	CommandStats m_stats;
+
+	std::array<BindPointState, BIND_POINT_COUNT> m_bindPoints;
+	std::array<VertexBinding, MAX_VERTEX_BINDINGS> m_vertexBindings;
+	IndexBinding m_indexBinding;
+	PushConstantState m_pushConstants;
+	DynamicState m_dynamicState;
+};
@@ -0,0 +1,77 @@
+#include "compute_pipeline.hpp"
+
+#include <stdexcept>
+#include <vulkan/vulkan_core.h>
+
+#include "renderer/shader.hpp"
+#include "util/log.hpp"
+
+ComputePipeline::ComputePipeline(Ref<VulkanDevice> device, const std::string& shaderName,
+                                 const std::vector<VkDescriptorSetLayout>& setLayouts,
+                                 uint32_t pushConstantSize)
+	: m_device(device) {
+	// Create pipeline layout
+	VkPushConstantRange pushConstantRange {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = pushConstantSize;
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+	pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+	pipelineLayoutInfo.pushConstantRangeCount = pushConstantSize > 0 ? 1 : 0;
+	pipelineLayoutInfo.pPushConstantRanges = pushConstantSize > 0 ? &pushConstantRange : nullptr;
+
+	if (vkCreatePipelineLayout(m_device->getLogicalDevice(), &pipelineLayoutInfo, nullptr,
+	                           &m_pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create compute pipeline layout!");
+	}
+
+	// Load shader. The module is only needed until the pipeline is created
+	std::vector<char> code = Shader::readFile("res/shaderc/" + shaderName + ".comp.spv");
+
+	VkShaderModuleCreateInfo moduleInfo {};
+	moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	moduleInfo.codeSize = code.size();
+	moduleInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+	VkShaderModule shaderModule;
+	if (vkCreateShaderModule(m_device->getLogicalDevice(), &moduleInfo, nullptr, &shaderModule) !=
+	    VK_SUCCESS) {
+		throw std::runtime_error("failed to create shader module!");
+	}
+
+	// Create pipeline
+	VkComputePipelineCreateInfo pipelineInfo {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = m_pipelineLayout;
+
+	VkResult result = vkCreateComputePipelines(m_device->getLogicalDevice(), VK_NULL_HANDLE, 1,
+	                                           &pipelineInfo, nullptr, &m_pipeline);
+	vkDestroyShaderModule(m_device->getLogicalDevice(), shaderModule, nullptr);
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("failed to create compute pipeline!");
+	}
+
+	LOG_TRACE("Created compute pipeline {0}", shaderName);
+}
+
+ComputePipeline::~ComputePipeline() {
+	vkDestroyPipeline(m_device->getLogicalDevice(), m_pipeline, nullptr);
+	vkDestroyPipelineLayout(m_device->getLogicalDevice(), m_pipelineLayout, nullptr);
+}
+
+void ComputePipeline::bind(CommandEncoder& encoder) {
+	encoder.bindPipeline(VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+}
+
+void ComputePipeline::bindDescriptorSets(CommandEncoder& encoder, uint32_t setCount,
+                                         const VkDescriptorSet* sets) {
+	encoder.bindDescriptorSets(VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, setCount,
+	                           sets);
+}
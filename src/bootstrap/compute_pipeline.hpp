@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "command_encoder.hpp"
+#include "device.hpp"
+#include "util/gpu_layout.hpp"
+#include "util/memory.hpp"
+
+/**
+ * @class ComputePipeline
+ * @brief A compute shader, along with the layout of the resources it uses
+ *
+ * Unlike graphics pipelines, compute pipelines have no vertex input or render state to vary, so
+ * each is created directly from a shader in res/shaderc/<name>.comp.spv.
+ */
+class ComputePipeline {
+  public:
+	/**
+	 * @param shaderName Name of the compute shader, without extension
+	 * @param setLayouts Layouts of the descriptor sets the shader reads, in set order
+	 * @param pushConstantSize Size of the shader's push constant block, or 0 if it has none
+	 */
+	ComputePipeline(Ref<VulkanDevice> device, const std::string& shaderName,
+	                const std::vector<VkDescriptorSetLayout>& setLayouts,
+	                uint32_t pushConstantSize = 0);
+	~ComputePipeline();
+
+	ComputePipeline(const ComputePipeline&) = delete;
+
+	void bind(CommandEncoder& encoder);
+	void bindDescriptorSets(CommandEncoder& encoder, uint32_t setCount,
+	                        const VkDescriptorSet* sets);
+	/**
+	 * @brief Records a push constant update, seen by following dispatches with this pipeline
+	 */
+	template <typename T> inline void pushConstant(CommandEncoder& encoder, const T& data) {
+		static_assert(GpuLayout<T>::value, "push constant type has no checked GPU layout");
+		encoder.pushConstants(m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(T), &data);
+	}
+
+	inline VkPipelineLayout getLayout() const { return m_pipelineLayout; }
+
+  private:
+	Ref<VulkanDevice> m_device;
+
+	VkPipelineLayout m_pipelineLayout;
+	VkPipeline m_pipeline;
+};
@@ -0,0 +1,145 @@
+#include "descriptor_allocator.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vulkan/vulkan_core.h>
+
+#include "util/log.hpp"
+
+// Number of sets the first pool of each list can hold. Each new pool doubles this, up to the max
+static const uint32_t INITIAL_POOL_SETS = 16;
+static const uint32_t MAX_POOL_SETS = 1024;
+
+// Average number of each descriptor type used by a single set of each class. Pools are sized by
+// multiplying these ratios by the number of sets the pool can hold
+static const std::array<std::vector<VkDescriptorPoolSize>, DESCRIPTOR_CLASS_COUNT> s_poolRatios = {{
+	// DESCRIPTOR_CLASS_UNIFORM
+	{{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4}},
+	// DESCRIPTOR_CLASS_GENERAL
+	{{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2},
+	 {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4},
+	 {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4},
+	 {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2}},
+}};
+
+DescriptorAllocator::DescriptorAllocator(VkDevice device) : m_device(device) {
+	for (auto& list : m_persistentPools) {
+		list.nextPoolSize = INITIAL_POOL_SETS;
+	}
+}
+
+DescriptorAllocator::~DescriptorAllocator() {
+	// Destroying a pool implicitly frees every set allocated from it
+	for (const auto& list : m_persistentPools) {
+		for (VkDescriptorPool pool : list.pools) {
+			vkDestroyDescriptorPool(m_device, pool, nullptr);
+		}
+	}
+	for (VkDescriptorPool pool : m_dedicatedPools) {
+		vkDestroyDescriptorPool(m_device, pool, nullptr);
+	}
+}
+
+DescriptorAllocation DescriptorAllocator::allocate(VkDescriptorSetLayout layout,
+                                                   DescriptorClass descriptorClass) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	PoolList& list = m_persistentPools[descriptorClass];
+
+	DescriptorAllocation allocation {};
+	allocation.descriptorClass = descriptorClass;
+	allocation.set = allocateFrom(list, layout, descriptorClass,
+	                              VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT);
+	allocation.pool = list.pools[list.active];
+	return allocation;
+}
+
+void DescriptorAllocator::free(const DescriptorAllocation& allocation) {
+	if (allocation.set == VK_NULL_HANDLE) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	vkFreeDescriptorSets(m_device, allocation.pool, 1, &allocation.set);
+
+	// The freed pool has space again, so start searching from it next time
+	PoolList& list = m_persistentPools[allocation.descriptorClass];
+	auto it = std::find(list.pools.begin(), list.pools.end(), allocation.pool);
+	list.active = std::min(list.active, static_cast<uint32_t>(it - list.pools.begin()));
+}
+
+VkDescriptorPool
+DescriptorAllocator::createDedicatedPool(const std::vector<VkDescriptorPoolSize>& poolSizes,
+                                         uint32_t maxSets, VkDescriptorPoolCreateFlags flags) {
+	VkDescriptorPoolCreateInfo poolInfo {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = flags;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = maxSets;
+
+	VkDescriptorPool pool;
+	if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor pool!");
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_dedicatedPools.push_back(pool);
+	return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::createPool(DescriptorClass descriptorClass, uint32_t maxSets,
+                                                 VkDescriptorPoolCreateFlags flags) {
+	std::vector<VkDescriptorPoolSize> poolSizes = s_poolRatios[descriptorClass];
+	for (auto& poolSize : poolSizes) {
+		poolSize.descriptorCount *= maxSets;
+	}
+
+	VkDescriptorPoolCreateInfo poolInfo {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = flags;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = maxSets;
+
+	VkDescriptorPool pool;
+	if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor pool!");
+	}
+
+	return pool;
+}
+
+VkDescriptorSet DescriptorAllocator::allocateFrom(PoolList& list, VkDescriptorSetLayout layout,
+                                                  DescriptorClass descriptorClass,
+                                                  VkDescriptorPoolCreateFlags flags) {
+	VkDescriptorSetAllocateInfo allocInfo {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+
+	VkDescriptorSet set;
+
+	// Try every pool which might still have space, then grow the list
+	for (; list.active < list.pools.size(); list.active++) {
+		allocInfo.descriptorPool = list.pools[list.active];
+		VkResult result = vkAllocateDescriptorSets(m_device, &allocInfo, &set);
+
+		if (result == VK_SUCCESS) {
+			return set;
+		} else if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+			throw std::runtime_error("failed to allocate descriptor set!");
+		}
+	}
+
+	LOG_TRACE("Growing descriptor pool list for class {0} to {1} pools", descriptorClass,
+	          list.pools.size() + 1);
+	list.pools.push_back(createPool(descriptorClass, list.nextPoolSize, flags));
+	list.nextPoolSize = std::min(list.nextPoolSize * 2, MAX_POOL_SETS);
+
+	allocInfo.descriptorPool = list.pools[list.active];
+	if (vkAllocateDescriptorSets(m_device, &allocInfo, &set) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate descriptor set!");
+	}
+
+	return set;
+}
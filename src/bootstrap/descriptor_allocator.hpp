@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "util/constants.hpp"
+
+/* Broad categories of descriptor set layouts. Each class gets its own list of pools, with pool
+ * sizes tuned to the descriptors that class of layout actually uses. */
+enum DescriptorClass {
+	DESCRIPTOR_CLASS_UNIFORM = 0, // only uniform buffers (per-pipeline uniform sets)
+	DESCRIPTOR_CLASS_GENERAL,     // mix of buffers, storage buffers, and images (compute, passes)
+	DESCRIPTOR_CLASS_COUNT
+};
+
+/* A descriptor set together with the pool it came from, needed to free it again */
+struct DescriptorAllocation {
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	DescriptorClass descriptorClass = DESCRIPTOR_CLASS_UNIFORM;
+};
+
+/**
+ * @class DescriptorAllocator
+ * @brief Central source of descriptor sets, owned by the VulkanDevice
+ *
+ * Keeps a growable list of pools for each descriptor class. When a pool runs out, a new one twice
+ * as large is added rather than failing. Sets stay valid until they are freed, and the pools
+ * are never reset.
+ */
+class DescriptorAllocator {
+  public:
+	DescriptorAllocator(VkDevice device);
+	~DescriptorAllocator();
+
+	DescriptorAllocator(const DescriptorAllocator&) = delete;
+
+	/**
+	 * @brief Allocates a long-lived descriptor set, which stays valid until it is freed
+	 *
+	 * @param layout The layout of the set to allocate
+	 * @param descriptorClass The class of pool to allocate from
+	 */
+	DescriptorAllocation allocate(VkDescriptorSetLayout layout, DescriptorClass descriptorClass);
+	void free(const DescriptorAllocation& allocation);
+
+	/**
+	 * @brief Creates a fixed size pool for an external consumer (e.g. ImGui) which manages its own
+	 * allocations. The pool is destroyed with the allocator.
+	 */
+	VkDescriptorPool createDedicatedPool(const std::vector<VkDescriptorPoolSize>& poolSizes,
+	                                     uint32_t maxSets, VkDescriptorPoolCreateFlags flags = 0);
+
+  private:
+	struct PoolList {
+		std::vector<VkDescriptorPool> pools;
+		/* Index of the first pool that may still have space */
+		uint32_t active = 0;
+		/* Max sets of the next pool to be created */
+		uint32_t nextPoolSize;
+	};
+
+	VkDescriptorPool createPool(DescriptorClass descriptorClass, uint32_t maxSets,
+	                            VkDescriptorPoolCreateFlags flags);
+	VkDescriptorSet allocateFrom(PoolList& list, VkDescriptorSetLayout layout,
+	                             DescriptorClass descriptorClass,
+	                             VkDescriptorPoolCreateFlags flags);
+
+  private:
+	VkDevice m_device;
+
+	std::array<PoolList, DESCRIPTOR_CLASS_COUNT> m_persistentPools;
+	std::vector<VkDescriptorPool> m_dedicatedPools;
+
+	/* Pipelines may be built off the main thread */
+	std::mutex m_mutex;
+};
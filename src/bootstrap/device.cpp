@@ -12,11 +12,15 @@
 VulkanDevice::VulkanDevice(const Ref<VulkanInstance> instance) {
 	pickPhysicalDevice(instance);
 	createLogicalDevice();
+	loadDynamicStateCommands();
 	createCommandPool();
 	createCommandBuffers();
+
+	m_descriptorAllocator = CreateScopedRef<DescriptorAllocator>(m_logicalDevice);
 }
 
 VulkanDevice::~VulkanDevice() {
+	m_descriptorAllocator.reset();
 	vkDestroyCommandPool(m_logicalDevice, m_commandPool, nullptr);
 	vkDestroyDevice(m_logicalDevice, nullptr);
 }
@@ -134,6 +138,12 @@ void VulkanDevice::createImage(uint32_t width, uint32_t height, VkFormat format,
 	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+	createImage(imageInfo, properties, image, imageMemory);
+}
+
+void VulkanDevice::createImage(const VkImageCreateInfo& imageInfo,
+                               VkMemoryPropertyFlags properties, VkImage& image,
+                               VkDeviceMemory& imageMemory) {
 	if (vkCreateImage(m_logicalDevice, &imageInfo, nullptr, &image) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create image!");
 	}
@@ -154,11 +164,12 @@ void VulkanDevice::createImage(uint32_t width, uint32_t height, VkFormat format,
 }
 
 VkImageView VulkanDevice::createImageView(VkImage image, VkFormat format,
-                                          VkImageAspectFlags aspectFlags) {
+                                          VkImageAspectFlags aspectFlags,
+                                          VkImageViewType viewType, uint32_t layerCount) {
 	VkImageViewCreateInfo viewInfo {};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	viewInfo.image = image;
-	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.viewType = viewType;
 	viewInfo.format = format;
 
 	// We want to use RGBA components, in that order
@@ -172,7 +183,7 @@ VkImageView VulkanDevice::createImageView(VkImage image, VkFormat format,
 	viewInfo.subresourceRange.baseMipLevel = 0;
 	viewInfo.subresourceRange.levelCount = 1;
 	viewInfo.subresourceRange.baseArrayLayer = 0;
-	viewInfo.subresourceRange.layerCount = 1; // this is for stereographic stuff
+	viewInfo.subresourceRange.layerCount = layerCount; // i.e. the faces of a cube
 
 	VkImageView imageView;
 	if (vkCreateImageView(m_logicalDevice, &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
@@ -237,12 +248,37 @@ void VulkanDevice::pickPhysicalDevice(const Ref<VulkanInstance> instance) {
 	}
 
 	vkGetPhysicalDeviceProperties(m_physicalDevice, &m_deviceProps);
+
+	m_descriptorIndexingProps = {};
+	m_descriptorIndexingProps.sType =
+		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+	VkPhysicalDeviceProperties2 props2 {};
+	props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	props2.pNext = &m_descriptorIndexingProps;
+	vkGetPhysicalDeviceProperties2(m_physicalDevice, &props2);
+
+	m_graphicsPipelineLibrary = checkGraphicsPipelineLibrarySupport(m_physicalDevice);
+	m_coreDynamicState = m_deviceProps.apiVersion >= VK_API_VERSION_1_3;
+	m_dynamicBlendEnable = checkDynamicBlendEnableSupport(m_physicalDevice);
+
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
+	m_multiDrawIndirect =
+		supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance;
+	m_drawIndirectCount =
+		checkExtensionSupport(m_physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
 	LOG_INFO("Selected Physical Device: {0}", m_deviceProps.deviceName);
 	LOG_INFO("\tUsing Vulkan API: {0}.{1}.{2}.{3}", VK_VERSION_MINOR(m_deviceProps.apiVersion),
 	         VK_VERSION_MINOR(m_deviceProps.apiVersion),
 	         VK_API_VERSION_VARIANT(m_deviceProps.apiVersion),
 	         VK_VERSION_PATCH(m_deviceProps.apiVersion));
 	LOG_INFO("\tUsing Driver Version: {0}", m_deviceProps.driverVersion);
+	LOG_INFO("\tGraphics pipeline library: {0}",
+	         m_graphicsPipelineLibrary ? "supported" : "unsupported");
+	LOG_INFO("\tDynamic blend enable: {0}", m_dynamicBlendEnable ? "supported" : "unsupported");
+	LOG_INFO("\tMulti draw indirect: {0}", m_multiDrawIndirect ? "supported" : "unsupported");
+	LOG_INFO("\tDraw indirect count: {0}", m_drawIndirectCount ? "supported" : "unsupported");
 }
 
 void VulkanDevice::createLogicalDevice() {
@@ -261,18 +297,77 @@ void VulkanDevice::createLogicalDevice() {
 		queueCreateInfo.pQueuePriorities = &queuePriority;
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
+	// Bindless textures: one global, partially bound array of samplers that can be indexed with
+	// non-uniform values and written to while in use
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures {};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+	indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+	indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+
+	// Optional and version dependent features are chained in front of the required ones
+	std::vector<const char*> extensions = deviceExtensions;
+	void* featureChain = &indexingFeatures;
+
+	// Optionally, build pipelines from separately compiled and cached parts
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures {};
+	pipelineLibraryFeatures.sType =
+		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+	pipelineLibraryFeatures.graphicsPipelineLibrary = VK_TRUE;
+	if (m_graphicsPipelineLibrary) {
+		extensions.insert(extensions.end(), pipelineLibraryExtensions.begin(),
+		                  pipelineLibraryExtensions.end());
+		pipelineLibraryFeatures.pNext = featureChain;
+		featureChain = &pipelineLibraryFeatures;
+	}
+
+	// Cull mode, front face and depth state are set per draw. Core since 1.3
+	VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures {};
+	dynamicStateFeatures.sType =
+		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+	dynamicStateFeatures.extendedDynamicState = VK_TRUE;
+	if (!m_coreDynamicState) {
+		extensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+		dynamicStateFeatures.pNext = featureChain;
+		featureChain = &dynamicStateFeatures;
+	}
+
+	// Optionally, blending is also turned on and off per draw
+	VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamicState3Features {};
+	dynamicState3Features.sType =
+		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+	dynamicState3Features.extendedDynamicState3ColorBlendEnable = VK_TRUE;
+	if (m_dynamicBlendEnable) {
+		extensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+		dynamicState3Features.pNext = featureChain;
+		featureChain = &dynamicState3Features;
+	}
+
+	// Optionally, the number of indirect draws is read from a buffer written by culling
+	if (m_drawIndirectCount) {
+		extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	}
+
 	// Create logical device
-	VkPhysicalDeviceFeatures deviceFeatures {};
-	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	VkPhysicalDeviceFeatures2 deviceFeatures {};
+	deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	deviceFeatures.pNext = featureChain;
+	deviceFeatures.features.samplerAnisotropy = VK_TRUE;
+	// Optionally, draw objects culled on the GPU
+	deviceFeatures.features.multiDrawIndirect = m_multiDrawIndirect;
+	deviceFeatures.features.drawIndirectFirstInstance = m_multiDrawIndirect;
 
 	VkDeviceCreateInfo deviceCreateInfo {};
 	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	deviceCreateInfo.pNext = &deviceFeatures; // features are passed through pNext instead
 	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
 	deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
-	deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
+	deviceCreateInfo.pEnabledFeatures = nullptr;
 
-	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	deviceCreateInfo.ppEnabledExtensionNames = extensions.data();
 
 	if (enableValidationLayers) {
 		deviceCreateInfo.enabledLayerCount = requiredValidationLayersSize;
@@ -295,6 +390,38 @@ void VulkanDevice::createLogicalDevice() {
 	                 &m_presentQueue);
 }
 
+void VulkanDevice::loadDynamicStateCommands() {
+	// Core and extension commands are interchangeable, they just have different names
+	std::string suffix = m_coreDynamicState ? "" : "EXT";
+	auto load = [&](const std::string& name) {
+		PFN_vkVoidFunction command =
+			vkGetDeviceProcAddr(m_logicalDevice, (name + suffix).c_str());
+		if (!command) {
+			throw std::runtime_error("failed to load " + name + suffix + "!");
+		}
+		return command;
+	};
+
+	m_dynamicStateCommands.setCullMode = (PFN_vkCmdSetCullMode) load("vkCmdSetCullMode");
+	m_dynamicStateCommands.setFrontFace = (PFN_vkCmdSetFrontFace) load("vkCmdSetFrontFace");
+	m_dynamicStateCommands.setDepthTestEnable =
+		(PFN_vkCmdSetDepthTestEnable) load("vkCmdSetDepthTestEnable");
+	m_dynamicStateCommands.setDepthWriteEnable =
+		(PFN_vkCmdSetDepthWriteEnable) load("vkCmdSetDepthWriteEnable");
+	m_dynamicStateCommands.setDepthCompareOp =
+		(PFN_vkCmdSetDepthCompareOp) load("vkCmdSetDepthCompareOp");
+
+	if (m_dynamicBlendEnable) {
+		m_dynamicStateCommands.setColorBlendEnable = (PFN_vkCmdSetColorBlendEnableEXT)
+			vkGetDeviceProcAddr(m_logicalDevice, "vkCmdSetColorBlendEnableEXT");
+	}
+
+	if (m_drawIndirectCount) {
+		m_drawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCount) vkGetDeviceProcAddr(
+			m_logicalDevice, "vkCmdDrawIndexedIndirectCountKHR");
+	}
+}
+
 void VulkanDevice::createCommandPool() {
 	VkCommandPoolCreateInfo poolInfo {};
 	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -404,7 +531,8 @@ bool VulkanDevice::isDeviceSuitable(const VkPhysicalDevice device, const VkSurfa
 	vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
 	return indices.isComplete() && extensionsSupported && swapChainAdequate &&
-	       supportedFeatures.samplerAnisotropy;
+	       supportedFeatures.samplerAnisotropy && checkDescriptorIndexingSupport(device) &&
+	       checkExtendedDynamicStateSupport(device);
 }
 
 bool VulkanDevice::checkDeviceExtensionSupport(const VkPhysicalDevice device) {
@@ -423,3 +551,105 @@ bool VulkanDevice::checkDeviceExtensionSupport(const VkPhysicalDevice device) {
 
 	return requiredExtensions.empty();
 }
+
+bool VulkanDevice::checkDescriptorIndexingSupport(const VkPhysicalDevice device) {
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures {};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2 features {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &indexingFeatures;
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	return indexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+	       indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+	       indexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+	       indexingFeatures.descriptorBindingPartiallyBound &&
+	       indexingFeatures.runtimeDescriptorArray;
+}
+
+bool VulkanDevice::checkGraphicsPipelineLibrarySupport(const VkPhysicalDevice device) {
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+	                                     availableExtensions.data());
+
+	std::set<std::string> requiredExtensions(pipelineLibraryExtensions.begin(),
+	                                         pipelineLibraryExtensions.end());
+	for (const auto& extension : availableExtensions) {
+		requiredExtensions.erase(extension.extensionName);
+	}
+	if (!requiredExtensions.empty()) {
+		return false;
+	}
+
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures {};
+	pipelineLibraryFeatures.sType =
+		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2 features {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &pipelineLibraryFeatures;
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	return pipelineLibraryFeatures.graphicsPipelineLibrary;
+}
+
+bool VulkanDevice::checkExtendedDynamicStateSupport(const VkPhysicalDevice device) {
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(device, &props);
+	if (props.apiVersion >= VK_API_VERSION_1_3) {
+		return true; // core, and required to be supported
+	}
+
+	if (!checkExtensionSupport(device, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)) {
+		return false;
+	}
+
+	VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures {};
+	dynamicStateFeatures.sType =
+		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2 features {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &dynamicStateFeatures;
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	return dynamicStateFeatures.extendedDynamicState;
+}
+
+bool VulkanDevice::checkDynamicBlendEnableSupport(const VkPhysicalDevice device) {
+	if (!checkExtensionSupport(device, VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME)) {
+		return false;
+	}
+
+	VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamicState3Features {};
+	dynamicState3Features.sType =
+		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2 features {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &dynamicState3Features;
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	return dynamicState3Features.extendedDynamicState3ColorBlendEnable;
+}
+
+bool VulkanDevice::checkExtensionSupport(const VkPhysicalDevice device, const char* extension) {
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+	                                     availableExtensions.data());
+
+	for (const auto& available : availableExtensions) {
+		if (std::string(available.extensionName) == extension) {
+			return true;
+		}
+	}
+
+	return false;
+}
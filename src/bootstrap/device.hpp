@@ -1,6 +1,8 @@
 #pragma once
 
 #include "instance.hpp"
+#include "descriptor_allocator.hpp"
+#include "util/memory.hpp"
 #include <optional>
 #include <vector>
 #include <vulkan/vulkan_core.h>
@@ -18,6 +20,18 @@ struct QueueFamilyIndices {
 	bool isComplete() { return graphicsFamily.has_value() && presentFamily.has_value(); }
 };
 
+/* Commands to set fixed function state per draw. Loaded from core Vulkan 1.3 if available, or
+ * from VK_EXT_extended_dynamic_state otherwise */
+struct DynamicStateCommands {
+	PFN_vkCmdSetCullMode setCullMode;
+	PFN_vkCmdSetFrontFace setFrontFace;
+	PFN_vkCmdSetDepthTestEnable setDepthTestEnable;
+	PFN_vkCmdSetDepthWriteEnable setDepthWriteEnable;
+	PFN_vkCmdSetDepthCompareOp setDepthCompareOp;
+	/* From VK_EXT_extended_dynamic_state3. Null if unsupported */
+	PFN_vkCmdSetColorBlendEnableEXT setColorBlendEnable;
+};
+
 struct SwapChainSupportDetails {
 	VkSurfaceCapabilitiesKHR capabilities;
 	std::vector<VkSurfaceFormatKHR> formats;
@@ -99,7 +113,19 @@ class VulkanDevice {
 	void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
 	                 VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image,
 	                 VkDeviceMemory& imageMemory);
-	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+	/**
+	 * @brief Creates an image object on the GPU from a full description, i.e. for images with
+	 * several layers
+	 */
+	void createImage(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties,
+	                 VkImage& image, VkDeviceMemory& imageMemory);
+	/**
+	 * @param viewType How shaders see the image, i.e. as a cube or an array of layers
+	 * @param layerCount The number of layers the view covers, starting from the first
+	 */
+	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags,
+	                            VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D,
+	                            uint32_t layerCount = 1);
 
 	/**
 	 * @brief Wait until all pending commands on this device have been executed
@@ -119,7 +145,59 @@ class VulkanDevice {
 	inline const VkDevice getLogicalDevice() const { return m_logicalDevice; }
 	inline const VkQueue getGraphicsQueue() const { return m_graphicsQueue; }
 	inline const VkQueue getPresentQueue() const { return m_presentQueue; }
+	/**
+	 * @brief Gets the allocator all descriptor sets on this device should come from
+	 */
+	inline DescriptorAllocator& getDescriptorAllocator() { return *m_descriptorAllocator; }
 	inline const float getMaxAnistropy() const { return m_deviceProps.limits.maxSamplerAnisotropy; }
+	inline uint32_t getMinUniformBufferOffsetAlignment() const {
+		return m_deviceProps.limits.minUniformBufferOffsetAlignment;
+	}
+	/**
+	 * @brief Whether timestamps can be written on the graphics queue, to time work on the GPU
+	 */
+	inline bool supportsTimestamps() const {
+		return m_deviceProps.limits.timestampComputeAndGraphics;
+	}
+	/**
+	 * @brief Gets the number of nanoseconds each timestamp tick takes
+	 */
+	inline float getTimestampPeriod() const { return m_deviceProps.limits.timestampPeriod; }
+	/**
+	 * @brief Gets the maximum number of textures that can be made available to shaders through a
+	 * single update-after-bind descriptor binding
+	 */
+	inline uint32_t getMaxBindlessTextures() const {
+		return m_descriptorIndexingProps.maxDescriptorSetUpdateAfterBindSampledImages;
+	}
+	/**
+	 * @brief Whether pipelines can be built from separately compiled parts and linked together
+	 * (VK_EXT_graphics_pipeline_library). This is optional, pipelines are built whole otherwise.
+	 */
+	inline bool supportsGraphicsPipelineLibrary() const { return m_graphicsPipelineLibrary; }
+	inline const DynamicStateCommands& getDynamicStateCommands() const {
+		return m_dynamicStateCommands;
+	}
+	/**
+	 * @brief Whether blending can be turned on and off per draw. If not, pipelines always blend.
+	 */
+	inline bool supportsDynamicBlendEnable() const {
+		return m_dynamicStateCommands.setColorBlendEnable != nullptr;
+	}
+	/**
+	 * @brief Whether many indirect draws can be issued at once, each with its own first instance.
+	 * Needed to draw objects culled on the GPU.
+	 */
+	inline bool supportsMultiDrawIndirect() const { return m_multiDrawIndirect; }
+	/**
+	 * @brief Gets vkCmdDrawIndexedIndirectCount (VK_KHR_draw_indirect_count), which reads the
+	 * number of draws from a buffer
+	 *
+	 * @return The command, or nullptr if unsupported
+	 */
+	inline PFN_vkCmdDrawIndexedIndirectCount getDrawIndexedIndirectCount() const {
+		return m_drawIndexedIndirectCount;
+	}
 
   private:
 	void pickPhysicalDevice(const Ref<VulkanInstance> instance);
@@ -132,6 +210,7 @@ class VulkanDevice {
 	 */
 	void createLogicalDevice();
 
+	void loadDynamicStateCommands();
 	void createCommandPool();
 	void createCommandBuffers();
 
@@ -139,6 +218,11 @@ class VulkanDevice {
 	SwapChainSupportDetails querySwapChainSupport(const VkPhysicalDevice device,
 	                                              const VkSurfaceKHR surface) const;
 	bool checkDeviceExtensionSupport(const VkPhysicalDevice device);
+	bool checkDescriptorIndexingSupport(const VkPhysicalDevice device);
+	bool checkGraphicsPipelineLibrarySupport(const VkPhysicalDevice device);
+	bool checkExtendedDynamicStateSupport(const VkPhysicalDevice device);
+	bool checkDynamicBlendEnableSupport(const VkPhysicalDevice device);
+	bool checkExtensionSupport(const VkPhysicalDevice device, const char* extension);
 	bool isDeviceSuitable(const VkPhysicalDevice device, const VkSurfaceKHR surface);
 
   private:
@@ -146,7 +230,16 @@ class VulkanDevice {
 	VkDevice m_logicalDevice;
 
 	VkPhysicalDeviceProperties m_deviceProps;
+	VkPhysicalDeviceDescriptorIndexingPropertiesEXT m_descriptorIndexingProps;
 	QueueFamilyIndices m_queueFamilyIndices;
+	bool m_graphicsPipelineLibrary = false;
+	/* Extended dynamic state is part of core Vulkan 1.3, otherwise we need the extension */
+	bool m_coreDynamicState = false;
+	bool m_dynamicBlendEnable = false;
+	DynamicStateCommands m_dynamicStateCommands {};
+	bool m_multiDrawIndirect = false;
+	bool m_drawIndirectCount = false;
+	PFN_vkCmdDrawIndexedIndirectCount m_drawIndexedIndirectCount = nullptr;
 
 	VkQueue m_graphicsQueue; // implicitly destroyed with logicalDevice
 	VkQueue m_presentQueue;
@@ -154,5 +247,12 @@ class VulkanDevice {
 	VkCommandPool m_commandPool;
 	std::vector<VkCommandBuffer> m_commandBuffers; // automatically freed with m_commandPool
 
-	const std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+	/* Must be destroyed before m_logicalDevice */
+	ScopedRef<DescriptorAllocator> m_descriptorAllocator;
+
+	const std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+	                                                   VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME};
+	/* Enabled only when supported. Graphics pipeline library depends on pipeline library */
+	const std::vector<const char*> pipelineLibraryExtensions = {
+		VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME};
 };
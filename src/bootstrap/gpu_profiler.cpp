@@ -0,0 +1,94 @@
+#include "gpu_profiler.hpp"
+
+#include <array>
+#include <stdexcept>
+
+#include "util/log.hpp"
+
+GpuProfiler::GpuProfiler(Ref<VulkanDevice> device)
+	: m_device(device), m_enabled(device->supportsTimestamps()) {
+	m_queryPools.fill(VK_NULL_HANDLE);
+	if (!m_enabled) {
+		LOG_WARN("Timestamps are unsupported, GPU timings will not be available");
+		return;
+	}
+
+	VkQueryPoolCreateInfo poolInfo {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	poolInfo.queryCount = 2 * MAX_SCOPES;
+
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		if (vkCreateQueryPool(m_device->getLogicalDevice(), &poolInfo, nullptr,
+		                      &m_queryPools[i]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create timestamp query pool!");
+		}
+	}
+}
+
+GpuProfiler::~GpuProfiler() {
+	for (VkQueryPool pool : m_queryPools) {
+		if (pool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(m_device->getLogicalDevice(), pool, nullptr);
+		}
+	}
+}
+
+void GpuProfiler::beginFrame(CommandEncoder& encoder, uint32_t currentFrame) {
+	if (!m_enabled) {
+		return;
+	}
+
+	std::vector<Scope>& scopes = m_scopes[currentFrame];
+	if (!scopes.empty()) {
+		// The frame's fence has signalled, so every query it wrote is available
+		std::array<uint64_t, 2 * MAX_SCOPES> ticks;
+		uint32_t queryCount = 2 * static_cast<uint32_t>(scopes.size());
+		VkResult result = vkGetQueryPoolResults(
+			m_device->getLogicalDevice(), m_queryPools[currentFrame], 0, queryCount,
+			queryCount * sizeof(uint64_t), ticks.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+		if (result == VK_SUCCESS) {
+			float msPerTick = m_device->getTimestampPeriod() / 1e6f;
+			m_groupTimings.clear();
+			for (uint32_t i = 0; i < scopes.size(); i++) {
+				float ms = (ticks[2 * i + 1] - ticks[2 * i]) * msPerTick;
+				m_timings[scopes[i].name] = ms;
+				if (!scopes[i].group.empty()) {
+					m_groupTimings[scopes[i].group] += ms;
+				}
+			}
+		}
+		scopes.clear();
+	}
+
+	encoder.resetQueryPool(m_queryPools[currentFrame], 0, 2 * MAX_SCOPES);
+}
+
+uint32_t GpuProfiler::beginScope(CommandEncoder& encoder, const std::string& name,
+                                 uint32_t currentFrame, const std::string& group) {
+	std::vector<Scope>& scopes = m_scopes[currentFrame];
+	if (!m_enabled || scopes.size() >= MAX_SCOPES) {
+		return NO_SCOPE;
+	}
+
+	uint32_t scope = static_cast<uint32_t>(scopes.size());
+	scopes.push_back({name, group});
+	encoder.writeTimestamp(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPools[currentFrame],
+	                       2 * scope);
+	return scope;
+}
+
+void GpuProfiler::endScope(CommandEncoder& encoder, uint32_t scope, uint32_t currentFrame) {
+	if (scope == NO_SCOPE) {
+		return;
+	}
+
+	encoder.writeTimestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPools[currentFrame],
+	                       2 * scope + 1);
+}
+
+float GpuProfiler::getGroupTime(const std::string& group) const {
+	auto groupTime = m_groupTimings.find(group);
+	return groupTime != m_groupTimings.end() ? groupTime->second : 0.0f;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "command_encoder.hpp"
+#include "device.hpp"
+#include "util/constants.hpp"
+#include "util/memory.hpp"
+
+/**
+ * @class GpuProfiler
+ * @brief Times named scopes of the commands recorded each frame, as they run on the GPU
+ *
+ * Each frame in flight writes timestamps into a query pool of its own. They are read back the
+ * next time that frame begins, once its fence has signalled, so reading never waits on the GPU.
+ * Timings therefore lag a couple of frames behind. Does nothing if the device can't write
+ * timestamps.
+ */
+class GpuProfiler {
+  public:
+	GpuProfiler(Ref<VulkanDevice> device);
+	~GpuProfiler();
+
+	GpuProfiler(const GpuProfiler&) = delete;
+
+	/**
+	 * @brief Reads back the timings of the last time this frame was in flight, and records a reset
+	 * of its queries. Must be recorded before any scope of the frame, outside of a render pass
+	 */
+	void beginFrame(CommandEncoder& encoder, uint32_t currentFrame);
+	/**
+	 * @brief Records the start of a scope. Scopes may nest, but must not span frames
+	 *
+	 * @param group Scopes of the same group are summed each frame, see getGroupTime. Scopes of a
+	 * group must not nest, or they would be counted twice
+	 * @return The scope, to pass to endScope
+	 */
+	uint32_t beginScope(CommandEncoder& encoder, const std::string& name, uint32_t currentFrame,
+	                    const std::string& group = "");
+	void endScope(CommandEncoder& encoder, uint32_t scope, uint32_t currentFrame);
+
+	/**
+	 * @brief Gets the last measured duration of every scope ever timed, in milliseconds
+	 */
+	inline const std::map<std::string, float>& getTimings() const { return m_timings; }
+	/**
+	 * @brief Gets the total duration of the scopes of a group in the last frame read back, in
+	 * milliseconds. 0 if the frame had none
+	 */
+	float getGroupTime(const std::string& group) const;
+
+  private:
+	/* Most scopes timed in one frame. Each takes two queries */
+	static const uint32_t MAX_SCOPES = 32;
+	static const uint32_t NO_SCOPE = UINT32_MAX;
+
+	Ref<VulkanDevice> m_device;
+	bool m_enabled;
+
+	Frames<VkQueryPool> m_queryPools;
+	struct Scope {
+		std::string name;
+		std::string group;
+	};
+
+	/* Scopes recorded in each frame. Scope i has queries 2i and 2i + 1 */
+	Frames<std::vector<Scope>> m_scopes;
+	std::map<std::string, float> m_timings;
+	/* Total of each group in the last frame read back */
+	std::map<std::string, float> m_groupTimings;
+};
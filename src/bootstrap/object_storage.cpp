@@ -0,0 +1,91 @@
+#include "object_storage.hpp"
+
+#include <stdexcept>
+#include <vulkan/vulkan_core.h>
+
+ObjectStorage::ObjectStorage(Ref<VulkanDevice> device)
+	: m_device(device), m_capacity(MAX_OBJECTS_PER_FRAME) {
+	VkDeviceSize size = sizeof(ObjectData) * m_capacity;
+
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		m_device->createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+		                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		                       m_buffers[i], m_buffersMemory[i]);
+
+		void* mapped;
+		vkMapMemory(m_device->getLogicalDevice(), m_buffersMemory[i], 0, size, 0, &mapped);
+		m_buffersMapped[i] = static_cast<ObjectData*>(mapped);
+	}
+
+	createDescriptorSetLayout();
+	createDescriptorSets();
+}
+
+ObjectStorage::~ObjectStorage() {
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		m_device->getDescriptorAllocator().free(m_descriptorSets[i]);
+		vkDestroyBuffer(m_device->getLogicalDevice(), m_buffers[i], nullptr);
+		vkFreeMemory(m_device->getLogicalDevice(), m_buffersMemory[i], nullptr);
+	}
+
+	vkDestroyDescriptorSetLayout(m_device->getLogicalDevice(), m_layout, nullptr);
+}
+
+uint32_t ObjectStorage::push(const ObjectData& object, uint32_t currentFrame) {
+	uint32_t index;
+	memcpy(reserve(1, currentFrame, index), &object, sizeof(ObjectData));
+	return index;
+}
+
+ObjectData* ObjectStorage::reserve(uint32_t count, uint32_t currentFrame, uint32_t& firstIndex) {
+	firstIndex = m_counts[currentFrame];
+	if (count > m_capacity - firstIndex) {
+		throw std::runtime_error("failed to store object data, too many objects in one frame!");
+	}
+
+	m_counts[currentFrame] += count;
+	return m_buffersMapped[currentFrame] + firstIndex;
+}
+
+void ObjectStorage::createDescriptorSetLayout() {
+	VkDescriptorSetLayoutBinding binding {};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	binding.descriptorCount = 1;
+	binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	binding.pImmutableSamplers = nullptr;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &binding;
+
+	if (vkCreateDescriptorSetLayout(m_device->getLogicalDevice(), &layoutInfo, nullptr,
+	                                &m_layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create object descriptor set layout!");
+	}
+}
+
+void ObjectStorage::createDescriptorSets() {
+	for (uint32_t frameIdx = 0; frameIdx < MAX_FRAMES_IN_FLIGHT; frameIdx++) {
+		m_descriptorSets[frameIdx] =
+			m_device->getDescriptorAllocator().allocate(m_layout, DESCRIPTOR_CLASS_GENERAL);
+
+		VkDescriptorBufferInfo bufferInfo {};
+		bufferInfo.buffer = m_buffers[frameIdx];
+		bufferInfo.offset = 0;
+		bufferInfo.range = VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet write {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = m_descriptorSets[frameIdx].set;
+		write.dstBinding = 0;
+		write.dstArrayElement = 0;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write.descriptorCount = 1;
+		write.pBufferInfo = &bufferInfo;
+
+		vkUpdateDescriptorSets(m_device->getLogicalDevice(), 1, &write, 0, nullptr);
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstring>
+#include <vulkan/vulkan_core.h>
+
+#include "device.hpp"
+#include "descriptor_allocator.hpp"
+#include "renderer/shader.hpp"
+#include "util/constants.hpp"
+#include "util/memory.hpp"
+
+/**
+ * @class ObjectStorage
+ * @brief A storage buffer per frame in flight, holding the per draw data of every object
+ *
+ * Each draw appends one ObjectData and passes the returned index as its firstInstance, which
+ * shaders read back as gl_InstanceIndex. The buffer is bound once per frame as set 2, so no
+ * draw has to push constants or rebind anything.
+ */
+class ObjectStorage {
+  public:
+	ObjectStorage(Ref<VulkanDevice> device);
+	~ObjectStorage();
+
+	ObjectStorage(const ObjectStorage&) = delete;
+
+	/**
+	 * @brief Forgets every object written for the given frame. The GPU must be done with them.
+	 */
+	inline void resetFrame(uint32_t currentFrame) { m_counts[currentFrame] = 0; }
+
+	/**
+	 * @brief Writes the data of one object for the current frame
+	 *
+	 * @return The index of the object's slot, to be used as the draw's firstInstance
+	 */
+	uint32_t push(const ObjectData& object, uint32_t currentFrame);
+	/**
+	 * @brief Reserves consecutive slots for the objects of an instanced draw, to be written in
+	 * place
+	 *
+	 * @param firstIndex Set to the index of the first slot, to be used as the draw's firstInstance
+	 * @return The mapped memory of the first slot
+	 */
+	ObjectData* reserve(uint32_t count, uint32_t currentFrame, uint32_t& firstIndex);
+
+	inline uint32_t getCount(uint32_t currentFrame) const { return m_counts[currentFrame]; }
+	inline uint32_t getCapacity() const { return m_capacity; }
+	inline VkBuffer getBuffer(uint32_t currentFrame) const { return m_buffers[currentFrame]; }
+	inline VkDescriptorSetLayout getLayout() const { return m_layout; }
+	inline VkDescriptorSet getDescriptorSet(uint32_t currentFrame) const {
+		return m_descriptorSets[currentFrame].set;
+	}
+
+  private:
+	void createDescriptorSetLayout();
+	void createDescriptorSets();
+
+  private:
+	Ref<VulkanDevice> m_device;
+
+	/* Max number of objects drawn in a single frame */
+	uint32_t m_capacity;
+	/* Number of objects written so far for each frame */
+	Frames<uint32_t> m_counts {};
+
+	Frames<VkBuffer> m_buffers;
+	Frames<VkDeviceMemory> m_buffersMemory;
+	/* CPU address linked to location of object data on GPU */
+	Frames<ObjectData*> m_buffersMapped;
+
+	VkDescriptorSetLayout m_layout;
+	/* Allocated from the device's DescriptorAllocator */
+	Frames<DescriptorAllocation> m_descriptorSets;
+};
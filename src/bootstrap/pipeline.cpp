@@ -2,8 +2,8 @@
 
 #include <algorithm>
 #include <array>
+#include <chrono>
 #include <cstdint>
-#include <cstring>
 #include <stdexcept>
 #include <glm/common.hpp>
 #include <glm/fwd.hpp>
@@ -11,7 +11,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <vulkan/vulkan_core.h>
 
-#include "renderer/texture_lib.hpp"
+#include "pipeline_library.hpp"
 #include "util/constants.hpp"
 #include "util/memory.hpp"
 #include "util/log.hpp"
@@ -20,17 +20,17 @@ VulkanPipeline::VulkanPipeline(Ref<VulkanDevice> device, const Ref<VulkanSwapCha
 	: m_device(device), m_swapChain(swapChain) {}
 
 VulkanPipeline::~VulkanPipeline() {
-	vkDestroySampler(m_device->getLogicalDevice(), m_textureSampler, nullptr);
+	if (m_optimizedPipeline.valid()) {
+		// Never got swapped in. Also makes sure the build is not still using our layout
+		vkDestroyPipeline(m_device->getLogicalDevice(), m_optimizedPipeline.get(), nullptr);
+	}
+	vkDestroyPipeline(m_device->getLogicalDevice(), m_linkedPipeline, nullptr);
 
 	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		// Destroy uniform buffers
-		vkDestroyBuffer(m_device->getLogicalDevice(), m_uniformBuffers[i], nullptr);
-		vkFreeMemory(m_device->getLogicalDevice(), m_uniformBuffersMemory[i], nullptr);
+		m_device->getDescriptorAllocator().free(m_uniformDescriptorSets[i]);
 	}
 
-	vkDestroyDescriptorPool(m_device->getLogicalDevice(), m_descriptorPool, nullptr);
 	vkDestroyDescriptorSetLayout(m_device->getLogicalDevice(), m_uniformLayout, nullptr);
-	vkDestroyDescriptorSetLayout(m_device->getLogicalDevice(), m_textureLayout, nullptr);
 	vkDestroyPipeline(m_device->getLogicalDevice(), m_pipeline, nullptr);
 	vkDestroyPipelineLayout(m_device->getLogicalDevice(), m_pipelineLayout, nullptr);
 }
@@ -40,13 +40,20 @@ void VulkanPipeline::create() {
 	if (!m_shader) {
 		throw(std::runtime_error("Tried to instantiate a pipeline without a shader!"));
 	}
+	if (!m_textureTable) {
+		throw(std::runtime_error("Tried to instantiate a pipeline without a texture table!"));
+	}
+	if (!m_uniformStorage) {
+		throw(std::runtime_error("Tried to instantiate a pipeline without uniform storage!"));
+	}
+	if (!m_objectStorage) {
+		throw(std::runtime_error("Tried to instantiate a pipeline without object storage!"));
+	}
 
 	setPushConstant(m_shader->getPushConstant());
 	setUniforms(m_shader->getUniforms());
 
 	createDescriptorSetLayout();
-	createTextureSampler();
-	createDescriptorPool();
 	createDescriptorSets();
 	VkRenderPass rp = m_isPostProcessing ? (m_swapChain->getPostProcessRenderPass())
 	                                     : m_swapChain->getOffscreenRenderPass();
@@ -60,11 +67,20 @@ void VulkanPipeline::setVertexArray(const VertexArray& vertexArray) {
 
 void VulkanPipeline::setShader(Ref<Shader> shader) {
 	m_shader = shader;
+	m_specValues = shader->getDefaultSpecialization();
+}
+
+void VulkanPipeline::setSpecialization(const SpecializationValues& values) {
+	if (values.size() != m_shader->getSpecializationConstants().size()) {
+		throw std::runtime_error("Specialization values do not match the constants of shader " +
+		                         m_shader->getName() + "!");
+	}
+
+	m_specValues = values;
 }
 
 uint32_t VulkanPipeline::setPushConstant(const PipelineDescriptor& pushConstant) {
 	uint32_t pushConstantID = m_pushConstants.size();
-	m_pushConstantIDs[pushConstant.name] = pushConstantID;
 
 	VkPushConstantRange pushConstantRange;
 	pushConstantRange.stageFlags = pushConstant.stage;
@@ -72,12 +88,9 @@ uint32_t VulkanPipeline::setPushConstant(const PipelineDescriptor& pushConstant)
 	pushConstantRange.size = pushConstant.size;
 
 	// TODO: I can only have one push constant object per pipeline. I could simulate multiple by
-	// using offsets, but there is a relatively small max size. I don't remember if I was clever
-	// enough to account for all this when I wrote this initially. If I wasn't, these vectors need
-	// to go, as they are misleading
+	// using offsets, but there is a relatively small max size
 	if (!pushConstant.name.empty()) {
 		m_pushConstants.push_back(pushConstantRange);
-		m_pushConstantSizes.push_back(pushConstant.size);
 		m_pushConstantOffset += pushConstant.size;
 	}
 
@@ -86,15 +99,12 @@ uint32_t VulkanPipeline::setPushConstant(const PipelineDescriptor& pushConstant)
 
 void VulkanPipeline::setUniforms(const std::vector<PipelineDescriptor>& uniforms) {
 	uint32_t id = 0;
-	uint32_t currOffset = 0;
 
 	m_uniformSizes.clear();
 	m_uniformOffsets.clear();
 	m_uniformBindings.clear();
 
 	for (const auto& uniform : uniforms) {
-		m_uniformIds[uniform.name] = id;
-
 		VkDescriptorSetLayoutBinding binding {};
 		binding.binding = id; // index of binding, order specified in shader code
 		binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -102,90 +112,34 @@ void VulkanPipeline::setUniforms(const std::vector<PipelineDescriptor>& uniforms
 		binding.stageFlags = uniform.stage;
 		binding.pImmutableSamplers = nullptr; // don't need samplers for uniforms
 
+		// Uniforms with the same name share one slot in the uniform storage
 		m_uniformSizes.push_back(uniform.size);
-		m_uniformOffsets.push_back(currOffset);
+		m_uniformOffsets.push_back(m_uniformStorage->getSlot(uniform.name, uniform.size));
 		m_uniformBindings.push_back(binding);
 
-		currOffset += uniform.size;
 		id++;
 	}
-
-	// Allocate memory on GPU to store uniforms
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		m_device->createBuffer(currOffset, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-		                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		                       m_uniformBuffers[i], m_uniformBuffersMemory[i]);
-
-		vkMapMemory(m_device->getLogicalDevice(), m_uniformBuffersMemory[i], 0, currOffset, 0,
-		            &m_uniformBuffersMapped[i]);
-	}
-}
-
-void VulkanPipeline::writePushConstant(VkCommandBuffer commandBuffer, const std::string& name,
-                                       const void* data, uint32_t currentFrame) {
-	const auto pushConstantID = m_pushConstantIDs.find(name);
-
-	if (pushConstantID == m_pushConstantIDs.end()) {
-		// push constant name was not found
-		LOG_TRACE("Truing to write unrecognized push constant {0}", name);
-		return;
-	}
-	VkPushConstantRange pushConstant = m_pushConstants[pushConstantID->second];
-
-	vkCmdPushConstants(commandBuffer, m_pipelineLayout, pushConstant.stageFlags,
-	                   pushConstant.offset, pushConstant.size, data);
-}
-
-void VulkanPipeline::writeUniform(const std::string& name, void* data, uint32_t currentFrame) {
-	const auto uniformId = m_uniformIds.find(name);
-
-	if (uniformId == m_uniformIds.end()) {
-		// uniform name was not found
-		LOG_TRACE("Trying to write unrecognized uniform: {0}", name);
-		return;
-	}
-
-	memcpy((char*) m_uniformBuffersMapped[currentFrame] + m_uniformOffsets[uniformId->second], data,
-	       m_uniformSizes[uniformId->second]);
 }
 
-void VulkanPipeline::bind(VkCommandBuffer commandBuffer) {
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+void VulkanPipeline::bind(CommandEncoder& encoder) {
+	encoder.bindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
 }
 
-void VulkanPipeline::bindTexture(Ref<Texture> tex) {
-	m_activeTex = tex;
-
-	if (std::find(m_textures.begin(), m_textures.end(), m_activeTex) == m_textures.end()) {
-		LOG_ERROR("Trying to bind a texture unavailable to pipeline");
-	}
+void VulkanPipeline::bindDescriptorSets(CommandEncoder& encoder, uint32_t currentFrame) {
+	// Kept on the stack, since draws may be recorded from several threads at once
+	std::array<VkDescriptorSet, 3> sets = getDescriptorSets(currentFrame);
+	encoder.bindDescriptorSets(VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0,
+	                           static_cast<uint32_t>(sets.size()), sets.data());
 }
 
-void VulkanPipeline::bindDescriptorSets(VkCommandBuffer commandBuffer, uint32_t currentFrame) {
-	m_activeDescriptorSets[0] = m_uniformDescriptorSets[currentFrame];
-	m_activeDescriptorSets[1] =
-		m_textureDescriptorSets[m_textureIdx[m_activeTex]]
-							   [currentFrame]; // TODO: should maybe consider error handling here
-	// Map insertion will happen automatically , but isn't guaranteed to line up w/ descriptor set
-	// order / len
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 2,
-	                        m_activeDescriptorSets.data(), 0, nullptr);
+std::array<VkDescriptorSet, 3> VulkanPipeline::getDescriptorSets(uint32_t currentFrame) const {
+	return {m_uniformDescriptorSets[currentFrame].set, m_textureTable->getDescriptorSet(),
+	        m_objectStorage->getDescriptorSet(currentFrame)};
 }
 
 void VulkanPipeline::createGraphicsPipeline(VkVertexInputBindingDescription bindingDesc,
                                             std::vector<VkVertexInputAttributeDescription> attrDesc,
                                             VkRenderPass renderPass) {
-	// Specify this pipelines dynamic state (i.e. vars that can be changed w/o recreation)
-	// To change, issue the corresponding vkCmd before render pass creation
-	std::vector<VkDynamicState> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT,
-	                                             VK_DYNAMIC_STATE_SCISSOR};
-
-	VkPipelineDynamicStateCreateInfo dynamicState {};
-	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-	dynamicState.pDynamicStates = dynamicStates.data();
-
 	// Specify bind point to incorporate vertex buffer into pipeline
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo {};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -197,9 +151,15 @@ void VulkanPipeline::createGraphicsPipeline(VkVertexInputBindingDescription bind
 
 	// Create state for fixed function pipeline stages
 	PipelineConfigInfo pi = defaultPipelineConfigInfo();
+	// The config is returned by value, so point its self references at this copy
+	pi.viewportInfo.pViewports = &pi.viewport;
+	pi.viewportInfo.pScissors = &pi.scissor;
+	pi.colorBlendInfo.pAttachments = &pi.colorBlendAttachment;
+	pi.dynamicStateInfo.pDynamicStates = pi.dynamicStates.data();
 
 	// Create pipeline layout
-	std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts = {m_uniformLayout, m_textureLayout};
+	std::array<VkDescriptorSetLayout, 3> descriptorSetLayouts = {
+		m_uniformLayout, m_textureTable->getLayout(), m_objectStorage->getLayout()};
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo {};
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	pipelineLayoutInfo.setLayoutCount = descriptorSetLayouts.size();
@@ -213,11 +173,37 @@ void VulkanPipeline::createGraphicsPipeline(VkVertexInputBindingDescription bind
 		throw std::runtime_error("failed to create pipeline layout!");
 	}
 
+	// Bake specialization constants into both stages. Each value is a 4 byte int, and entries
+	// for ids a stage doesn't declare are ignored by that stage
+	const auto& specConstants = m_shader->getSpecializationConstants();
+	std::vector<VkSpecializationMapEntry> specEntries(specConstants.size());
+	for (uint32_t i = 0; i < specConstants.size(); i++) {
+		specEntries[i].constantID = specConstants[i].id;
+		specEntries[i].offset = i * sizeof(int32_t);
+		specEntries[i].size = sizeof(int32_t);
+	}
+
+	VkSpecializationInfo specInfo {};
+	specInfo.mapEntryCount = static_cast<uint32_t>(specEntries.size());
+	specInfo.pMapEntries = specEntries.data();
+	specInfo.dataSize = m_specValues.size() * sizeof(int32_t);
+	specInfo.pData = m_specValues.data();
+
+	auto shaderStages = m_shader->getShaderStages();
+	for (auto& stage : shaderStages) {
+		stage.pSpecializationInfo = specEntries.empty() ? nullptr : &specInfo;
+	}
+
+	if (m_libraries) {
+		linkGraphicsPipeline(bindingDesc, attrDesc, renderPass, pi, shaderStages);
+		return;
+	}
+
 	// Create graphics pipeline
 	VkGraphicsPipelineCreateInfo pipelineInfo {};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = m_shader->getShaderStages().size();
-	pipelineInfo.pStages = m_shader->getShaderStages().data();
+	pipelineInfo.stageCount = shaderStages.size();
+	pipelineInfo.pStages = shaderStages.data();
 	pipelineInfo.pVertexInputState = &vertexInputInfo;
 	pipelineInfo.pInputAssemblyState = &pi.inputAssemblyInfo;
 	pipelineInfo.pViewportState = &pi.viewportInfo;
@@ -225,7 +211,7 @@ void VulkanPipeline::createGraphicsPipeline(VkVertexInputBindingDescription bind
 	pipelineInfo.pMultisampleState = &pi.multisampleInfo;
 	pipelineInfo.pDepthStencilState = &pi.depthStencilInfo;
 	pipelineInfo.pColorBlendState = &pi.colorBlendInfo;
-	pipelineInfo.pDynamicState = nullptr;
+	pipelineInfo.pDynamicState = &pi.dynamicStateInfo;
 	pipelineInfo.layout = m_pipelineLayout;
 	pipelineInfo.renderPass = renderPass;
 	pipelineInfo.subpass =
@@ -240,28 +226,45 @@ void VulkanPipeline::createGraphicsPipeline(VkVertexInputBindingDescription bind
 	}
 }
 
-void VulkanPipeline::createTextureSampler() {
-	VkSamplerCreateInfo samplerInfo {};
-	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	samplerInfo.magFilter = VK_FILTER_LINEAR;
-	samplerInfo.minFilter = VK_FILTER_LINEAR;
-	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.anisotropyEnable = VK_TRUE;
-	samplerInfo.maxAnisotropy = m_device->getMaxAnistropy();
-	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-	samplerInfo.unnormalizedCoordinates = VK_FALSE;
-	samplerInfo.compareEnable = VK_FALSE;
-	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	samplerInfo.mipLodBias = 0.0f;
-	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = 0.0f;
-
-	if (vkCreateSampler(m_device->getLogicalDevice(), &samplerInfo, nullptr, &m_textureSampler) !=
-	    VK_SUCCESS) {
-		throw std::runtime_error("failed to create texture sampler!");
+void VulkanPipeline::linkGraphicsPipeline(
+	VkVertexInputBindingDescription bindingDesc,
+	const std::vector<VkVertexInputAttributeDescription>& attrDesc, VkRenderPass renderPass,
+	const PipelineConfigInfo& config,
+	const std::array<VkPipelineShaderStageCreateInfo, 2>& shaderStages) {
+	PipelineParts parts;
+	parts[PIPELINE_PART_VERTEX_INPUT] = m_libraries->getVertexInput(bindingDesc, attrDesc, config);
+	parts[PIPELINE_PART_PRE_RASTERIZATION] = m_libraries->getPreRasterization(
+		*m_shader, m_specValues, shaderStages[0], m_pipelineLayout, renderPass, config);
+	parts[PIPELINE_PART_FRAGMENT_SHADER] = m_libraries->getFragmentShader(
+		*m_shader, m_specValues, shaderStages[1], m_pipelineLayout, renderPass, config);
+	parts[PIPELINE_PART_FRAGMENT_OUTPUT] = m_libraries->getFragmentOutput(renderPass, config);
+
+	m_pipeline = m_libraries->link(parts, m_pipelineLayout, false);
+
+	// Parts are owned by the cache, which outlives this build since we hold a reference to it
+	Ref<PipelineLibraryCache> libraries = m_libraries;
+	VkPipelineLayout layout = m_pipelineLayout;
+	m_optimizedPipeline = std::async(std::launch::async, [libraries, parts, layout]() {
+		try {
+			return libraries->link(parts, layout, true);
+		} catch (const std::runtime_error& e) {
+			LOG_WARN("Optimized pipeline build failed, keeping fast linked pipeline: {0}",
+			         e.what());
+			return static_cast<VkPipeline>(VK_NULL_HANDLE);
+		}
+	});
+}
+
+void VulkanPipeline::swapOptimizedPipeline() {
+	if (!m_optimizedPipeline.valid() ||
+	    m_optimizedPipeline.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+		return;
+	}
+
+	VkPipeline optimized = m_optimizedPipeline.get();
+	if (optimized != VK_NULL_HANDLE) {
+		m_linkedPipeline = m_pipeline;
+		m_pipeline = optimized;
 	}
 }
 
@@ -271,7 +274,8 @@ bool VulkanPipeline::canRender(const Model& model) {
 
 void VulkanPipeline::createDescriptorSetLayout() {
 	// Bindings for uniforms stored in m_uniformBindings
-	// Bindings for textures stored in m_textureBindings
+	// Textures and object data are provided by the bindless texture table and object storage,
+	// which own their own layouts
 
 	// Create layout for all uniform bindings in one descriptor set
 	VkDescriptorSetLayoutCreateInfo uniformLayoutInfo {};
@@ -283,100 +287,13 @@ void VulkanPipeline::createDescriptorSetLayout() {
 	                                &m_uniformLayout) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create descriptor set layout!");
 	}
-
-	// Create layout for descriptor set with two textures (albedo + normal)
-	std::array<VkDescriptorSetLayoutBinding, 2> textureBindings;
-
-	textureBindings[0].binding = 0;
-	textureBindings[0].descriptorCount = 1;
-	textureBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	textureBindings[0].pImmutableSamplers = nullptr;
-	textureBindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-	textureBindings[1].binding = 1;
-	textureBindings[1].descriptorCount = 1;
-	textureBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	textureBindings[1].pImmutableSamplers = nullptr;
-	textureBindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-	VkDescriptorSetLayoutCreateInfo textureLayoutInfo {};
-	textureLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	textureLayoutInfo.bindingCount = textureBindings.size();
-	textureLayoutInfo.pBindings = textureBindings.data();
-
-	if (vkCreateDescriptorSetLayout(m_device->getLogicalDevice(), &textureLayoutInfo, nullptr,
-	                                &m_textureLayout) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create descriptor set layout!");
-	}
-}
-
-void VulkanPipeline::createDescriptorPool() {
-	// Create descriptor for for each uniform and frame in flight
-	VkDescriptorPoolSize uniformBufferPoolSize {};
-	uniformBufferPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	uniformBufferPoolSize.descriptorCount =
-		m_uniformSizes.size() * static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-	m_poolSizes.push_back(uniformBufferPoolSize);
-
-	// Create descriptor for image sampler for each frame in flight
-	VkDescriptorPoolSize imageSamplerPoolSize;
-	imageSamplerPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	// NOTE: 2 here is one each for albedo and normal
-	imageSamplerPoolSize.descriptorCount =
-		2 * m_textures.size() * static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-	m_poolSizes.push_back(imageSamplerPoolSize);
-
-	// Create descriptor for ImGui
-	// PERF: this is wasteful, only the postprocessing pipeline needs space for imgui
-	m_poolSizes.push_back({VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1});
-
-	VkDescriptorPoolCreateInfo poolInfo {};
-	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-	poolInfo.poolSizeCount = static_cast<uint32_t>(m_poolSizes.size());
-	poolInfo.pPoolSizes = m_poolSizes.data(); // describes number and type of different descriptors
-	poolInfo.maxSets =
-		(m_textures.size() + 2) *
-		static_cast<uint32_t>(
-			MAX_FRAMES_IN_FLIGHT); // max number of descriptor sets allocated at a
-	                               // time (num textures + 1 for uniforms + 1 for ImGui)
-
-	if (vkCreateDescriptorPool(m_device->getLogicalDevice(), &poolInfo, nullptr,
-	                           &m_descriptorPool) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create descriptor pool!");
-	}
 }
 
 void VulkanPipeline::createDescriptorSets() {
-	// Allocate uniform descriptor sets (1 for each frame)
-	std::vector<VkDescriptorSetLayout> uniformLayouts(MAX_FRAMES_IN_FLIGHT, m_uniformLayout);
-
-	VkDescriptorSetAllocateInfo uniformAllocInfo {};
-	uniformAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	uniformAllocInfo.descriptorPool = m_descriptorPool;
-	uniformAllocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-	uniformAllocInfo.pSetLayouts = uniformLayouts.data();
-
-	if (vkAllocateDescriptorSets(m_device->getLogicalDevice(), &uniformAllocInfo,
-	                             m_uniformDescriptorSets.data()) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate uniform descriptor sets!");
-	}
-
-	// Allocate texture descriptor sets (1 for each texture and frame)
-	std::vector<VkDescriptorSetLayout> textureLayouts(MAX_FRAMES_IN_FLIGHT, m_textureLayout);
-
-	m_textureDescriptorSets.resize(m_textures.size());
-	for (uint32_t i = 0; i < m_textures.size(); i++) {
-		VkDescriptorSetAllocateInfo textureAllocInfo {};
-		textureAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		textureAllocInfo.descriptorPool = m_descriptorPool;
-		textureAllocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-		textureAllocInfo.pSetLayouts = textureLayouts.data();
-
-		if (vkAllocateDescriptorSets(m_device->getLogicalDevice(), &textureAllocInfo,
-		                             m_textureDescriptorSets[i].data()) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate texture descriptor sets!");
-		}
+	// Allocate uniform descriptor sets (1 for each frame). These live as long as the pipeline
+	for (auto& allocation : m_uniformDescriptorSets) {
+		allocation = m_device->getDescriptorAllocator().allocate(m_uniformLayout,
+		                                                         DESCRIPTOR_CLASS_UNIFORM);
 	}
 
 	// Populate descriptor sets (describe data that goes in each binding available to shader)
@@ -384,21 +301,19 @@ void VulkanPipeline::createDescriptorSets() {
 		// Uniforms
 		std::vector<VkDescriptorBufferInfo> bufferInfos(m_uniformSizes.size());
 		std::vector<VkWriteDescriptorSet> uniformDescriptorWrites(m_uniformSizes.size());
-		u_int32_t offset = 0;
 
 		for (uint32_t uniformIdx = 0; uniformIdx < m_uniformSizes.size(); uniformIdx++) {
 			// Buffer info: location / size of memory to read to get uniform data
 			VkDescriptorBufferInfo bufferInfo {};
-			bufferInfo.buffer = m_uniformBuffers[frameIdx];
-			bufferInfo.offset = offset;
+			bufferInfo.buffer = m_uniformStorage->getBuffer(frameIdx);
+			bufferInfo.offset = m_uniformOffsets[uniformIdx];
 			bufferInfo.range = m_uniformSizes[uniformIdx];
-			offset += m_uniformSizes[uniformIdx];
 
 			bufferInfos[uniformIdx] = bufferInfo;
 
 			// Descriptor writes: map buffer info to set / binding in shader
 			uniformDescriptorWrites[uniformIdx].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			uniformDescriptorWrites[uniformIdx].dstSet = m_uniformDescriptorSets[frameIdx];
+			uniformDescriptorWrites[uniformIdx].dstSet = m_uniformDescriptorSets[frameIdx].set;
 			uniformDescriptorWrites[uniformIdx].dstBinding = uniformIdx;
 			uniformDescriptorWrites[uniformIdx].dstArrayElement = 0;
 			uniformDescriptorWrites[uniformIdx].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -410,85 +325,6 @@ void VulkanPipeline::createDescriptorSets() {
 		vkUpdateDescriptorSets(m_device->getLogicalDevice(),
 		                       static_cast<uint32_t>(uniformDescriptorWrites.size()),
 		                       uniformDescriptorWrites.data(), 0, nullptr);
-
-		// Textures
-		setAvailableTextures(m_textures);
-	}
-}
-
-void VulkanPipeline::setAvailableTextures(const std::vector<Ref<Texture>>& textures) {
-	// Error checking on new list of available textures
-	uint32_t numTex = m_textures.size();
-	if (textures.size() < m_textures.size()) {
-		LOG_ERROR("Providing texture list to pipeline shorter than available descriptors. Padding "
-		          "with default texture.");
-		m_textures = textures;
-		m_textures.resize(numTex,
-		                  TextureLibrary::get()->getTexture(m_device, "res/texture/default.png"));
-	} else if (textures.size() > m_textures.size()) {
-		LOG_ERROR(
-			"Providing texture list to pipeline longer than available descriptors. Truncating");
-		m_textures = textures;
-		m_textures.resize(numTex);
-	}
-
-	// PERF: at this point, I probably don't need to bother with the idx dict anymore
-	m_textureIdx.clear();
-	for (uint32_t i = 0; i < m_textures.size(); i++) {
-		m_textureIdx[m_textures[i]] = i;
-	}
-
-	// Associate texture data with descriptor slots in pipeline layout
-	for (uint32_t frameIdx = 0; frameIdx < MAX_FRAMES_IN_FLIGHT; frameIdx++) {
-		std::vector<std::array<VkDescriptorImageInfo, 2>> imageInfos(m_textures.size());
-		std::vector<VkWriteDescriptorSet> textureDescriptorWrites(2 * m_textures.size());
-
-		for (uint32_t textureIdx = 0; textureIdx < m_textures.size(); textureIdx++) {
-			// Image info: image location / layout / sample method to get texture data
-			// albedo
-			imageInfos[textureIdx][0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfos[textureIdx][0].imageView = m_textures[textureIdx]->getImageView();
-			imageInfos[textureIdx][0].sampler = m_textureSampler;
-			// FIXME: this could be the place I need to use an offscreen sampler rather than main
-			// pass
-
-			// normal
-			imageInfos[textureIdx][1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfos[textureIdx][1].imageView =
-				TextureLibrary::get()
-					->getTexture(m_device, "res/model/mountain.norm")
-					->getImageView(); // FIXME: actually get normal somehow
-			imageInfos[textureIdx][1].sampler = m_textureSampler;
-
-			// Descriptor writes: map image info to set / binding in shader
-			// albedo
-			textureDescriptorWrites[2 * textureIdx].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			textureDescriptorWrites[2 * textureIdx].dstSet =
-				m_textureDescriptorSets[textureIdx][frameIdx];
-			textureDescriptorWrites[2 * textureIdx].dstBinding = 0;
-			textureDescriptorWrites[2 * textureIdx].dstArrayElement = 0;
-			textureDescriptorWrites[2 * textureIdx].descriptorType =
-				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			textureDescriptorWrites[2 * textureIdx].descriptorCount = 1;
-			textureDescriptorWrites[2 * textureIdx].pImageInfo = &imageInfos[textureIdx][0];
-
-			// normal
-			textureDescriptorWrites[2 * textureIdx + 1].sType =
-				VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			textureDescriptorWrites[2 * textureIdx + 1].dstSet =
-				m_textureDescriptorSets[textureIdx][frameIdx];
-			textureDescriptorWrites[2 * textureIdx + 1].dstBinding = 1;
-			textureDescriptorWrites[2 * textureIdx + 1].dstArrayElement = 0;
-			textureDescriptorWrites[2 * textureIdx + 1].descriptorType =
-				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			textureDescriptorWrites[2 * textureIdx + 1].descriptorCount = 1;
-			textureDescriptorWrites[2 * textureIdx + 1].pImageInfo = &imageInfos[textureIdx][1];
-		}
-
-		// Write to descriptor sets
-		vkUpdateDescriptorSets(m_device->getLogicalDevice(),
-		                       static_cast<uint32_t>(textureDescriptorWrites.size()),
-		                       textureDescriptorWrites.data(), 0, nullptr);
 	}
 }
 
@@ -589,5 +425,21 @@ PipelineConfigInfo VulkanPipeline::defaultPipelineConfigInfo() {
 	configInfo.depthStencilInfo.front = {}; // Optional
 	configInfo.depthStencilInfo.back = {};  // Optional
 
+	// Specify this pipelines dynamic state (i.e. vars that can be changed w/o recreation)
+	// The renderer sets these per draw from each model's RenderState, so models which only differ
+	// in these can share a pipeline
+	configInfo.dynamicStates = {VK_DYNAMIC_STATE_CULL_MODE, VK_DYNAMIC_STATE_FRONT_FACE,
+	                            VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE,
+	                            VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE,
+	                            VK_DYNAMIC_STATE_DEPTH_COMPARE_OP};
+	if (m_device->supportsDynamicBlendEnable()) {
+		configInfo.dynamicStates.push_back(VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT);
+	}
+
+	configInfo.dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	configInfo.dynamicStateInfo.dynamicStateCount =
+		static_cast<uint32_t>(configInfo.dynamicStates.size());
+	configInfo.dynamicStateInfo.pDynamicStates = configInfo.dynamicStates.data();
+
 	return configInfo;
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <future>
 #include <map>
 #include <unordered_map>
 #include <vector>
@@ -8,15 +9,20 @@
 
 #include "renderer/shader.hpp"
 #include "renderer/model.hpp"
-#include "renderer/texture.hpp"
 #include "util/constants.hpp"
 
+#include "command_encoder.hpp"
 #include "device.hpp"
+#include "object_storage.hpp"
+#include "texture_table.hpp"
+#include "uniform_storage.hpp"
 
 #include "vertex_array.hpp"
 #include "swapchain.hpp"
 #include "util/memory.hpp"
 
+class PipelineLibraryCache;
+
 struct PipelineConfigInfo {
 	VkViewport viewport;
 	VkRect2D scissor;
@@ -27,10 +33,11 @@ struct PipelineConfigInfo {
 	VkPipelineColorBlendAttachmentState colorBlendAttachment;
 	VkPipelineColorBlendStateCreateInfo colorBlendInfo;
 	VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
+	/* State set per draw instead. The values baked in above are ignored for these */
+	std::vector<VkDynamicState> dynamicStates;
+	VkPipelineDynamicStateCreateInfo dynamicStateInfo;
 };
 
-template <typename T> using Frames = std::array<T, MAX_FRAMES_IN_FLIGHT>;
-
 /**
  * @class VulkanPipeline
  * @brief Class describing a rendering pipeline to be used for a specific set of resources
@@ -47,22 +54,38 @@ class VulkanPipeline {
 	~VulkanPipeline();
 
   public:
-	void writeUniform(const std::string& name, void* data, uint32_t currentFrame);
-	inline void setActiveTexture(const Ref<Texture> tex) { m_activeTex = tex; }
-	void writePushConstant(VkCommandBuffer commandBuffer, const std::string& name, const void* data,
-	                       uint32_t currentFrame);
-
-	void bind(VkCommandBuffer commandBuffer);
-	void bindTexture(Ref<Texture> tex);
-	void setAvailableTextures(const std::vector<Ref<Texture>>& textures);
-	void bindDescriptorSets(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+	/**
+	 * @brief Binds the pipeline. Safe to call from several recording threads at once
+	 */
+	void bind(CommandEncoder& encoder);
+	/**
+	 * @brief Replaces the fast linked pipeline if the optimized one has finished building. Call
+	 * between frames, never while draws are being recorded
+	 */
+	void swapOptimizedPipeline();
+	/**
+	 * @brief Binds the uniforms and object data for the current frame, and the bindless texture
+	 * table
+	 *
+	 * None of these sets change between draws with this pipeline. The encoder skips the bind if
+	 * they are already bound.
+	 */
+	void bindDescriptorSets(CommandEncoder& encoder, uint32_t currentFrame);
+	/**
+	 * @brief Gets the sets bindDescriptorSets binds for the given frame
+	 */
+	std::array<VkDescriptorSet, 3> getDescriptorSets(uint32_t currentFrame) const;
+	/**
+	 * @brief Gets the pipeline currently bound by bind(). Changes when the optimized pipeline is
+	 * swapped in
+	 */
+	inline VkPipeline getHandle() const { return m_pipeline; }
 
 	bool canRender(const Model& model);
+	inline const Ref<Shader>& getShader() const { return m_shader; }
+	inline const SpecializationValues& getSpecialization() const { return m_specValues; }
 	void inline isPostProcessing(bool isPostProcessing) { m_isPostProcessing = isPostProcessing; }
 
-	// HACK: this exists solely to satisfy ImGui
-	VkDescriptorPool getDescriptorPool() const { return m_descriptorPool; }
-
   private: // core interface
 	/**
 	 * @brief Creates the pipeline object on the GPU
@@ -79,77 +102,92 @@ class VulkanPipeline {
 	 * @param shader The shader object for this pipeline to use
 	 */
 	void setShader(const Ref<Shader> shader);
+	/**
+	 * @brief Sets the values of the shader's specialization constants baked into this pipeline
+	 *
+	 * @param values One value per constant declared by the shader, in declaration order
+	 */
+	void setSpecialization(const SpecializationValues& values);
 	uint32_t setPushConstant(const PipelineDescriptor& pushConstant);
 	void setUniforms(const std::vector<PipelineDescriptor>& uniforms);
-	inline void initializeTextures(const std::vector<Ref<Texture>>& textures) {
-		m_textures = textures;
+	inline void setTextureTable(const Ref<BindlessTextureTable> textureTable) {
+		m_textureTable = textureTable;
+	}
+	inline void setUniformStorage(const Ref<UniformStorage> uniformStorage) {
+		m_uniformStorage = uniformStorage;
+	}
+	inline void setObjectStorage(const Ref<ObjectStorage> objectStorage) {
+		m_objectStorage = objectStorage;
+	}
+	/**
+	 * @brief Build this pipeline by linking cached parts instead of compiling it whole
+	 *
+	 * @param libraries The cache to take parts from, or nullptr to build monolithically
+	 */
+	inline void setLibraryCache(const Ref<PipelineLibraryCache> libraries) {
+		m_libraries = libraries;
 	}
 
 	void createGraphicsPipeline(VkVertexInputBindingDescription bindingDesc,
 	                            std::vector<VkVertexInputAttributeDescription> attrDesc,
 	                            VkRenderPass renderPass);
-	void createTextureSampler();
 
   private: // helper
 	void createDescriptorSetLayout();
-	void createDescriptorPool();
 	void createDescriptorSets();
 	PipelineConfigInfo defaultPipelineConfigInfo();
-
+	/**
+	 * @brief Fast links the pipeline from cached parts, and starts building an optimized
+	 * replacement in the background
+	 */
+	void linkGraphicsPipeline(VkVertexInputBindingDescription bindingDesc,
+	                          const std::vector<VkVertexInputAttributeDescription>& attrDesc,
+	                          VkRenderPass renderPass, const PipelineConfigInfo& config,
+	                          const std::array<VkPipelineShaderStageCreateInfo, 2>& shaderStages);
   private:
 	Ref<VulkanDevice> m_device;
 	const Ref<VulkanSwapChain> m_swapChain;
 
 	VkVertexInputBindingDescription m_vertexAttrBindings;
 	std::vector<VkVertexInputAttributeDescription> m_vertexAttr;
-	VkSampler m_textureSampler;
 	bool m_isPostProcessing;
 
-	std::array<VkDescriptorSet, 2> m_activeDescriptorSets;
-
 	Ref<Shader> m_shader;
+	/* Specialization constant values this variant was compiled with */
+	SpecializationValues m_specValues;
 
-	// Texture resources
-	Ref<Texture> m_activeTex;
-	std::vector<Ref<Texture>> m_textures;
-	std::unordered_map<Ref<Texture>, uint32_t>
-		m_textureIdx; // TODO: using two DS like this is clunky
-	// Descriptor set layout for textures: hardcoded to expect one albedo, one normal
-	VkDescriptorSetLayout m_textureLayout;
-	// List of descriptor sets (each with m_textureLayout layout). One descriptor set for each frame
-	// in flight and albedo / normal pair we render
-	std::vector<Frames<VkDescriptorSet>> m_textureDescriptorSets;
+	/* Global texture table, bound as set 1. Owned by the renderer, shared by all pipelines */
+	Ref<BindlessTextureTable> m_textureTable;
+	/* Per draw object data, bound as set 2. Owned by the renderer, shared by all pipelines */
+	Ref<ObjectStorage> m_objectStorage;
 
 	// Uniform resources
-	std::map<std::string, uint32_t>
-		m_pushConstantIDs; // HACK: I can really only have one push
-	                       // constant, having a map is redundant. See comment in writePushConstant
-	std::map<std::string, uint32_t> m_uniformIds;
+	/* Shared buffers holding the data of every uniform. Owned by the renderer */
+	Ref<UniformStorage> m_uniformStorage;
 	std::vector<uint32_t> m_uniformSizes;
+	/* Offset of each uniform's slot in the uniform storage */
 	std::vector<uint32_t> m_uniformOffsets;
-	/* Buffer to store uniforms data in */
-	Frames<VkBuffer> m_uniformBuffers;
-	/* Memory on GPU to store uniform buffers */
-	Frames<VkDeviceMemory> m_uniformBuffersMemory;
-	/* CPU address linked to location of uniforms on GPU */
-	Frames<void*> m_uniformBuffersMapped;
 	/* list of structs, each describing a uniform this pipeline makes available to shaders */
 	std::vector<VkDescriptorSetLayoutBinding> m_uniformBindings;
 	/* A list of buffers used by shaders. I use this to upload uniforms. */
 	VkDescriptorSetLayout m_uniformLayout;
-	/* Describes where to get uniform data, and how the GPU should use it */
-	Frames<VkDescriptorSet> m_uniformDescriptorSets;
+	/* Describes where to get uniform data, and how the GPU should use it. Allocated from the
+	 * device's DescriptorAllocator */
+	Frames<DescriptorAllocation> m_uniformDescriptorSets;
 
-	/* Pool to allocate descriptor sets from */
-	VkDescriptorPool m_descriptorPool;
-	std::vector<VkDescriptorPoolSize> m_poolSizes;
 	/* A list of descriptor layouts, describing dynamic resources used by pipeline */
 	VkPipelineLayout m_pipelineLayout;
 
 	// Push constant resources
 	std::vector<VkPushConstantRange> m_pushConstants;
-	std::vector<uint32_t> m_pushConstantSizes;
 	uint32_t m_pushConstantOffset = 0;
 
 	VkPipeline m_pipeline;
+
+	/* Cached pipeline parts to link from. Null if the device doesn't support pipeline libraries */
+	Ref<PipelineLibraryCache> m_libraries;
+	/* Link time optimized pipeline being built in the background */
+	std::future<VkPipeline> m_optimizedPipeline;
+	/* The fast linked pipeline, kept alive once replaced as in flight frames may still use it */
+	VkPipeline m_linkedPipeline = VK_NULL_HANDLE;
 };
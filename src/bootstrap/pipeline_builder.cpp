@@ -1,14 +1,40 @@
 #include "pipeline_builder.hpp"
 
-PipelineBuilder::PipelineBuilder(Ref<VulkanDevice> device, const Ref<VulkanSwapChain> swapchain)
-	: m_device(device), m_swapChain(swapchain) {}
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+
+PipelineBuilder::PipelineBuilder(Ref<VulkanDevice> device, const Ref<VulkanSwapChain> swapchain,
+                                 const Ref<BindlessTextureTable> textureTable,
+                                 const Ref<UniformStorage> uniformStorage,
+                                 const Ref<ObjectStorage> objectStorage)
+	: m_device(device), m_swapChain(swapchain), m_textureTable(textureTable),
+	  m_uniformStorage(uniformStorage), m_objectStorage(objectStorage) {
+	if (m_device->supportsGraphicsPipelineLibrary()) {
+		m_libraries = CreateRef<PipelineLibraryCache>(m_device);
+	}
+}
 
 PipelineBuilder::~PipelineBuilder() {}
 
 Ref<VulkanPipeline> PipelineBuilder::buildPipeline(VertexArray vertexArray,
                                                    const Ref<Shader> shader,
-                                                   const std::vector<Ref<Texture>>& textures,
                                                    bool isPostProcessing) {
+	return buildPipeline(vertexArray, shader, isPostProcessing,
+	                     shader->getDefaultSpecialization());
+}
+
+Ref<VulkanPipeline> PipelineBuilder::buildPipeline(VertexArray vertexArray,
+                                                   const Ref<Shader> shader, bool isPostProcessing,
+                                                   const SpecializationValues& specialization) {
+	PROFILE_FUNC();
+	VariantKey key = {shader.get(), isPostProcessing, specialization};
+	{
+		std::lock_guard<std::mutex> lock(m_variantMutex);
+		auto variant = m_variants.find(key);
+		if (variant != m_variants.end()) {
+			return variant->second;
+		}
+	}
 
 	// TODO: I really want the pipeline constructor to be private, and this to be a friend class.
 	// However, the CreateRef wraps it in a way that friend doesn't work.
@@ -16,10 +42,29 @@ Ref<VulkanPipeline> PipelineBuilder::buildPipeline(VertexArray vertexArray,
 
 	pipeline->setVertexArray(vertexArray);
 	pipeline->setShader(shader);
-	pipeline->initializeTextures(textures);
+	pipeline->setSpecialization(specialization);
+	pipeline->setTextureTable(m_textureTable);
+	pipeline->setUniformStorage(m_uniformStorage);
+	pipeline->setObjectStorage(m_objectStorage);
+	pipeline->setLibraryCache(m_libraries);
 	pipeline->isPostProcessing(isPostProcessing);
 
 	pipeline->create();
 
-	return pipeline;
+	// If another thread built the same variant meanwhile, keep the one already cached
+	std::lock_guard<std::mutex> lock(m_variantMutex);
+	return m_variants.emplace(key, pipeline).first->second;
+}
+
+std::shared_future<Ref<VulkanPipeline>>
+PipelineBuilder::buildPipelineAsync(VertexArray vertexArray, const Ref<Shader> shader,
+                                    bool isPostProcessing,
+                                    const SpecializationValues& specialization) {
+	LOG_INFO("Compiling {0} pipeline variant in the background", shader->getName());
+	return std::async(std::launch::async,
+	                  [=]() {
+						  return buildPipeline(vertexArray, shader, isPostProcessing,
+		                                       specialization);
+					  })
+		.share();
 }
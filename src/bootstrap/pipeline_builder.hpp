@@ -1,12 +1,20 @@
 #pragma once
 
+#include <future>
+#include <map>
+#include <mutex>
+#include <tuple>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
 #include "pipeline.hpp"
+#include "pipeline_library.hpp"
 #include "vertex_array.hpp"
 #include "bootstrap/device.hpp"
+#include "bootstrap/object_storage.hpp"
 #include "bootstrap/swapchain.hpp"
+#include "bootstrap/texture_table.hpp"
+#include "bootstrap/uniform_storage.hpp"
 #include "renderer/shader.hpp"
 #include "util/memory.hpp"
 
@@ -18,7 +26,10 @@
  */
 class PipelineBuilder {
   public:
-	PipelineBuilder(Ref<VulkanDevice> device, const Ref<VulkanSwapChain> swapchain);
+	PipelineBuilder(Ref<VulkanDevice> device, const Ref<VulkanSwapChain> swapchain,
+	                const Ref<BindlessTextureTable> textureTable,
+	                const Ref<UniformStorage> uniformStorage,
+	                const Ref<ObjectStorage> objectStorage);
 	~PipelineBuilder();
 
 	PipelineBuilder(const PipelineBuilder&) = delete;
@@ -28,15 +39,49 @@ class PipelineBuilder {
 	 *
 	 * @param vertexArray Describes the layout of vertex data rendered with this model
 	 * @param shader The shader used by this pipeline to render data
-	 * @param textures List of Textures available to this pipeline
+	 * @param isPostProcessing Whether this pipeline renders in the postprocessing pass
 	 *
 	 * @return A VulkanPipeline to render objects with the given structure
 	 */
 	Ref<VulkanPipeline> buildPipeline(VertexArray vertexArray, const Ref<Shader> shader,
-	                                  const std::vector<Ref<Texture>>& textures,
 	                                  bool isPostProcessing = false);
 
+	/**
+	 * @brief Gets a variant of a pipeline with the given specialization constant values
+	 *
+	 * Variants are cached by shader, pass, and constant values, so switching back to a previously
+	 * used setting does not recompile anything.
+	 *
+	 * @param specialization Values for each of the shader's specialization constants
+	 */
+	Ref<VulkanPipeline> buildPipeline(VertexArray vertexArray, const Ref<Shader> shader,
+	                                  bool isPostProcessing,
+	                                  const SpecializationValues& specialization);
+
+	/**
+	 * @brief Same as buildPipeline, but compiles the variant on a background thread
+	 *
+	 * Cached variants are returned immediately. The caller should keep rendering with its current
+	 * pipeline until the future is ready.
+	 */
+	std::shared_future<Ref<VulkanPipeline>>
+	buildPipelineAsync(VertexArray vertexArray, const Ref<Shader> shader, bool isPostProcessing,
+	                   const SpecializationValues& specialization);
+
   private:
 	Ref<VulkanDevice> m_device;
 	const Ref<VulkanSwapChain> m_swapChain;
+	/* Every pipeline samples textures from this table */
+	const Ref<BindlessTextureTable> m_textureTable;
+	/* Every pipeline reads its uniforms from this storage */
+	const Ref<UniformStorage> m_uniformStorage;
+	/* Every pipeline reads per draw object data from this storage */
+	const Ref<ObjectStorage> m_objectStorage;
+	/* Parts shared between pipelines, or null if pipelines must be built whole */
+	Ref<PipelineLibraryCache> m_libraries;
+
+	/* Every variant built so far. Also keeps variants alive while in flight frames use them */
+	using VariantKey = std::tuple<const Shader*, bool, SpecializationValues>;
+	std::map<VariantKey, Ref<VulkanPipeline>> m_variants;
+	std::mutex m_variantMutex;
 };
@@ -0,0 +1,231 @@
+#include "pipeline_library.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vulkan/vulkan_core.h>
+
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+
+// Identifies a shader stage by its shader, its specialization and the render pass it targets
+static std::vector<uint64_t> stageKey(const Shader& shader,
+                                      const SpecializationValues& specialization,
+                                      VkRenderPass renderPass) {
+	std::vector<uint64_t> key = {reinterpret_cast<uint64_t>(&shader),
+	                             reinterpret_cast<uint64_t>(renderPass)};
+	for (int32_t value : specialization) {
+		key.push_back(static_cast<uint32_t>(value));
+	}
+
+	return key;
+}
+
+// Each part may only declare the dynamic states it contains, so pick those out of the config
+static VkPipelineDynamicStateCreateInfo partDynamicState(PipelineLibraryPart part,
+                                                         const PipelineConfigInfo& config,
+                                                         std::vector<VkDynamicState>& storage) {
+	static const std::array<std::vector<VkDynamicState>, PIPELINE_PART_COUNT> partStates = {{
+		{},
+		{VK_DYNAMIC_STATE_CULL_MODE, VK_DYNAMIC_STATE_FRONT_FACE},
+		{VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE, VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE,
+	     VK_DYNAMIC_STATE_DEPTH_COMPARE_OP},
+		{VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT},
+	}};
+
+	storage.clear();
+	for (VkDynamicState state : config.dynamicStates) {
+		const auto& states = partStates[part];
+		if (std::find(states.begin(), states.end(), state) != states.end()) {
+			storage.push_back(state);
+		}
+	}
+
+	VkPipelineDynamicStateCreateInfo dynamicState {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(storage.size());
+	dynamicState.pDynamicStates = storage.data();
+	return dynamicState;
+}
+
+PipelineLibraryCache::PipelineLibraryCache(Ref<VulkanDevice> device) : m_device(device) {}
+
+PipelineLibraryCache::~PipelineLibraryCache() {
+	// Linked pipelines do not depend on their libraries, so it is safe to destroy these first
+	for (const auto& parts : m_parts) {
+		for (const auto& part : parts) {
+			vkDestroyPipeline(m_device->getLogicalDevice(), part.second, nullptr);
+		}
+	}
+}
+
+VkPipeline PipelineLibraryCache::getVertexInput(
+	const VkVertexInputBindingDescription& binding,
+	const std::vector<VkVertexInputAttributeDescription>& attributes,
+	const PipelineConfigInfo& config) {
+	PartKey key = {binding.binding, binding.stride, static_cast<uint64_t>(binding.inputRate),
+	               static_cast<uint64_t>(config.inputAssemblyInfo.topology)};
+	for (const auto& attribute : attributes) {
+		key.insert(key.end(), {attribute.location, attribute.binding,
+		                       static_cast<uint64_t>(attribute.format), attribute.offset});
+	}
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo {};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = 1;
+	vertexInputInfo.pVertexBindingDescriptions = &binding;
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+	vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
+
+	VkGraphicsPipelineCreateInfo pipelineInfo {};
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &config.inputAssemblyInfo;
+
+	return findOrCreatePart(PIPELINE_PART_VERTEX_INPUT, key, pipelineInfo);
+}
+
+VkPipeline PipelineLibraryCache::getPreRasterization(const Shader& shader,
+                                                     const SpecializationValues& specialization,
+                                                     const VkPipelineShaderStageCreateInfo& stage,
+                                                     VkPipelineLayout layout,
+                                                     VkRenderPass renderPass,
+                                                     const PipelineConfigInfo& config) {
+	std::vector<VkDynamicState> dynamicStates;
+	VkPipelineDynamicStateCreateInfo dynamicState =
+		partDynamicState(PIPELINE_PART_PRE_RASTERIZATION, config, dynamicStates);
+
+	VkGraphicsPipelineCreateInfo pipelineInfo {};
+	pipelineInfo.stageCount = 1;
+	pipelineInfo.pStages = &stage;
+	pipelineInfo.pViewportState = &config.viewportInfo;
+	pipelineInfo.pRasterizationState = &config.rasterizationInfo;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = layout;
+	pipelineInfo.renderPass = renderPass;
+	pipelineInfo.subpass = 0;
+
+	return findOrCreatePart(PIPELINE_PART_PRE_RASTERIZATION,
+	                        stageKey(shader, specialization, renderPass), pipelineInfo);
+}
+
+VkPipeline PipelineLibraryCache::getFragmentShader(const Shader& shader,
+                                                   const SpecializationValues& specialization,
+                                                   const VkPipelineShaderStageCreateInfo& stage,
+                                                   VkPipelineLayout layout,
+                                                   VkRenderPass renderPass,
+                                                   const PipelineConfigInfo& config) {
+	std::vector<VkDynamicState> dynamicStates;
+	VkPipelineDynamicStateCreateInfo dynamicState =
+		partDynamicState(PIPELINE_PART_FRAGMENT_SHADER, config, dynamicStates);
+
+	VkGraphicsPipelineCreateInfo pipelineInfo {};
+	pipelineInfo.stageCount = 1;
+	pipelineInfo.pStages = &stage;
+	pipelineInfo.pMultisampleState = &config.multisampleInfo;
+	pipelineInfo.pDepthStencilState = &config.depthStencilInfo;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = layout;
+	pipelineInfo.renderPass = renderPass;
+	pipelineInfo.subpass = 0;
+
+	return findOrCreatePart(PIPELINE_PART_FRAGMENT_SHADER,
+	                        stageKey(shader, specialization, renderPass), pipelineInfo);
+}
+
+VkPipeline PipelineLibraryCache::getFragmentOutput(VkRenderPass renderPass,
+                                                   const PipelineConfigInfo& config) {
+	std::vector<VkDynamicState> dynamicStates;
+	VkPipelineDynamicStateCreateInfo dynamicState =
+		partDynamicState(PIPELINE_PART_FRAGMENT_OUTPUT, config, dynamicStates);
+
+	// Blend state is baked into this part, so pipelines blending differently can't share it.
+	// Blend enable only tells them apart when it can't be set per draw
+	const VkPipelineColorBlendAttachmentState& blend = config.colorBlendAttachment;
+	bool dynamicBlendEnable = std::find(dynamicStates.begin(), dynamicStates.end(),
+	                                    VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT) !=
+	                          dynamicStates.end();
+	PartKey key = {reinterpret_cast<uint64_t>(renderPass),
+	               dynamicBlendEnable ? VK_TRUE : blend.blendEnable,
+	               static_cast<uint64_t>(blend.srcColorBlendFactor),
+	               static_cast<uint64_t>(blend.dstColorBlendFactor),
+	               static_cast<uint64_t>(blend.colorBlendOp),
+	               static_cast<uint64_t>(blend.srcAlphaBlendFactor),
+	               static_cast<uint64_t>(blend.dstAlphaBlendFactor),
+	               static_cast<uint64_t>(blend.alphaBlendOp),
+	               blend.colorWriteMask};
+
+	VkGraphicsPipelineCreateInfo pipelineInfo {};
+	pipelineInfo.pColorBlendState = &config.colorBlendInfo;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.pMultisampleState = &config.multisampleInfo;
+	pipelineInfo.renderPass = renderPass;
+	pipelineInfo.subpass = 0;
+
+	return findOrCreatePart(PIPELINE_PART_FRAGMENT_OUTPUT, key, pipelineInfo);
+}
+
+VkPipeline PipelineLibraryCache::link(const PipelineParts& parts, VkPipelineLayout layout,
+                                      bool optimize) {
+	PROFILE_FUNC();
+	VkPipelineLibraryCreateInfoKHR libraryInfo {};
+	libraryInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+	libraryInfo.libraryCount = static_cast<uint32_t>(parts.size());
+	libraryInfo.pLibraries = parts.data();
+
+	VkGraphicsPipelineCreateInfo pipelineInfo {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.pNext = &libraryInfo;
+	pipelineInfo.flags = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+	pipelineInfo.layout = layout;
+
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(m_device->getLogicalDevice(), VK_NULL_HANDLE, 1, &pipelineInfo,
+	                              nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to link graphics pipeline!");
+	}
+
+	return pipeline;
+}
+
+VkPipeline PipelineLibraryCache::findOrCreatePart(PipelineLibraryPart part, const PartKey& key,
+                                                  VkGraphicsPipelineCreateInfo& pipelineInfo) {
+	static const std::array<VkGraphicsPipelineLibraryFlagsEXT, PIPELINE_PART_COUNT> partFlags = {
+		VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+		VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+		VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+		VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT,
+	};
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto cached = m_parts[part].find(key);
+		if (cached != m_parts[part].end()) {
+			return cached->second;
+		}
+	}
+
+	// Compile outside of the lock, so parts of other pipelines can be built at the same time
+	VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo {};
+	libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+	libraryInfo.flags = partFlags[part];
+
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.pNext = &libraryInfo;
+	// Keep enough information around to allow link time optimization later
+	pipelineInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR |
+	                     VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(m_device->getLogicalDevice(), VK_NULL_HANDLE, 1, &pipelineInfo,
+	                              nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create graphics pipeline library!");
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto inserted = m_parts[part].emplace(key, pipeline);
+	if (!inserted.second) {
+		// Another thread compiled the same part meanwhile
+		vkDestroyPipeline(m_device->getLogicalDevice(), pipeline, nullptr);
+	}
+
+	return inserted.first->second;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "device.hpp"
+#include "pipeline.hpp"
+#include "renderer/shader.hpp"
+#include "util/memory.hpp"
+
+/* The four independently compiled parts of a graphics pipeline */
+enum PipelineLibraryPart {
+	PIPELINE_PART_VERTEX_INPUT = 0,
+	PIPELINE_PART_PRE_RASTERIZATION,
+	PIPELINE_PART_FRAGMENT_SHADER,
+	PIPELINE_PART_FRAGMENT_OUTPUT,
+	PIPELINE_PART_COUNT
+};
+
+using PipelineParts = std::array<VkPipeline, PIPELINE_PART_COUNT>;
+
+/**
+ * @class PipelineLibraryCache
+ * @brief Compiles and caches the parts of graphics pipelines (VK_EXT_graphics_pipeline_library)
+ *
+ * Most pipelines share their vertex input and fragment output, and spec constant variants of the
+ * same shader share all but one shader stage. Each part is compiled once, and complete pipelines
+ * are produced by linking parts together. A fast link is cheap enough to do mid frame, while a
+ * link time optimized pipeline can be built in the background to replace it.
+ *
+ * Only used when the device supports graphics pipeline libraries.
+ */
+class PipelineLibraryCache {
+  public:
+	PipelineLibraryCache(Ref<VulkanDevice> device);
+	~PipelineLibraryCache();
+
+	PipelineLibraryCache(const PipelineLibraryCache&) = delete;
+
+	VkPipeline getVertexInput(const VkVertexInputBindingDescription& binding,
+	                          const std::vector<VkVertexInputAttributeDescription>& attributes,
+	                          const PipelineConfigInfo& config);
+	/**
+	 * @brief Gets the part holding the vertex shader and rasterization state
+	 *
+	 * @param shader The shader the stage belongs to, used to identify the part
+	 * @param specialization The constants baked into the stage, used to identify the part
+	 * @param stage The vertex stage, with its specialization info filled in
+	 */
+	VkPipeline getPreRasterization(const Shader& shader, const SpecializationValues& specialization,
+	                               const VkPipelineShaderStageCreateInfo& stage,
+	                               VkPipelineLayout layout, VkRenderPass renderPass,
+	                               const PipelineConfigInfo& config);
+	/**
+	 * @brief Gets the part holding the fragment shader and depth state
+	 *
+	 * @param stage The fragment stage, with its specialization info filled in
+	 */
+	VkPipeline getFragmentShader(const Shader& shader, const SpecializationValues& specialization,
+	                             const VkPipelineShaderStageCreateInfo& stage,
+	                             VkPipelineLayout layout, VkRenderPass renderPass,
+	                             const PipelineConfigInfo& config);
+	VkPipeline getFragmentOutput(VkRenderPass renderPass, const PipelineConfigInfo& config);
+
+	/**
+	 * @brief Links parts into a complete pipeline
+	 *
+	 * @param optimize Whether to perform link time optimization. This takes about as long as a
+	 * monolithic build, so should be done off the main thread
+	 * @return A pipeline owned by the caller
+	 */
+	VkPipeline link(const PipelineParts& parts, VkPipelineLayout layout, bool optimize);
+
+  private:
+	using PartKey = std::vector<uint64_t>;
+
+	/**
+	 * @brief Returns the cached part with the given key, or creates it from the given info
+	 */
+	VkPipeline findOrCreatePart(PipelineLibraryPart part, const PartKey& key,
+	                            VkGraphicsPipelineCreateInfo& pipelineInfo);
+
+  private:
+	Ref<VulkanDevice> m_device;
+
+	std::array<std::map<PartKey, VkPipeline>, PIPELINE_PART_COUNT> m_parts;
+	std::mutex m_mutex;
+};
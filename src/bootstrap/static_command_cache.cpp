@@ -0,0 +1,68 @@
+#include "static_command_cache.hpp"
+
+#include <stdexcept>
+
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+
+StaticCommandCache::StaticCommandCache(Ref<VulkanDevice> device)
+	: m_device(device), m_encoder(device) {
+	VkCommandPoolCreateInfo poolInfo {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // buffers recorded one by one
+	poolInfo.queueFamilyIndex = m_device->getQueueFamilyIndices().graphicsFamily.value();
+
+	if (vkCreateCommandPool(m_device->getLogicalDevice(), &poolInfo, nullptr, &m_pool) !=
+	    VK_SUCCESS) {
+		throw std::runtime_error("failed to create static command pool!");
+	}
+}
+
+StaticCommandCache::~StaticCommandCache() {
+	vkDestroyCommandPool(m_device->getLogicalDevice(), m_pool, nullptr);
+}
+
+VkCommandBuffer StaticCommandCache::get(uint32_t currentFrame, uint32_t imageIndex,
+                                        uint64_t signature,
+                                        const VkCommandBufferInheritanceInfo& inheritance,
+                                        const std::function<void(CommandEncoder&)>& record) {
+	Entry& entry = m_entries[(static_cast<uint64_t>(currentFrame) << 32) | imageIndex];
+	if (entry.recorded && entry.signature == signature) {
+		return entry.buffer;
+	}
+
+	PROFILE_FUNC();
+	if (entry.buffer == VK_NULL_HANDLE) {
+		VkCommandBufferAllocateInfo allocInfo {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = m_pool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(m_device->getLogicalDevice(), &allocInfo, &entry.buffer) !=
+		    VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate static command buffer!");
+		}
+	}
+
+	// Beginning implicitly resets the buffer. It is submitted many times, but never twice at once
+	VkCommandBufferBeginInfo beginInfo {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritance;
+	if (vkBeginCommandBuffer(entry.buffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording static command buffer!");
+	}
+
+	m_encoder.begin(entry.buffer);
+	record(m_encoder);
+
+	if (vkEndCommandBuffer(entry.buffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record static command buffer!");
+	}
+
+	LOG_TRACE("Recorded static commands for frame {0}, image {1}", currentFrame, imageIndex);
+	entry.signature = signature;
+	entry.recorded = true;
+	m_recordCount++;
+	return entry.buffer;
+}
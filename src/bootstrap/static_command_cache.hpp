@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <unordered_map>
+#include <vulkan/vulkan_core.h>
+
+#include "command_encoder.hpp"
+#include "device.hpp"
+#include "util/memory.hpp"
+
+/**
+ * @class StaticCommandCache
+ * @brief Secondary command buffers recorded once for each frame in flight and swapchain image,
+ * and only recorded again when something they were recorded with changes
+ *
+ * Meant for passes whose commands are the same every frame, with only the data they read
+ * (uniforms, storage buffers) changing. A buffer is only ever submitted by its own frame in
+ * flight, so by the time that frame comes around again it is no longer in use, and can be
+ * recorded over without waiting.
+ */
+class StaticCommandCache {
+  public:
+	StaticCommandCache(Ref<VulkanDevice> device);
+	~StaticCommandCache();
+
+	StaticCommandCache(const StaticCommandCache&) = delete;
+
+	/**
+	 * @brief Gets the buffer for this frame and image, recording it first if it was never
+	 * recorded, or was recorded with a different signature
+	 *
+	 * @param signature Hash of every handle the commands depend on (pipelines, descriptor sets,
+	 * framebuffer, ...). Any change to it records the buffer again
+	 * @param inheritance The render pass and framebuffer the buffer will be executed in
+	 * @param record Records the pass' commands
+	 */
+	VkCommandBuffer get(uint32_t currentFrame, uint32_t imageIndex, uint64_t signature,
+	                    const VkCommandBufferInheritanceInfo& inheritance,
+	                    const std::function<void(CommandEncoder&)>& record);
+
+	/* Number of times any buffer has been recorded */
+	inline uint32_t getRecordCount() const { return m_recordCount; }
+
+  private:
+	struct Entry {
+		VkCommandBuffer buffer = VK_NULL_HANDLE;
+		uint64_t signature = 0;
+		bool recorded = false;
+	};
+
+	Ref<VulkanDevice> m_device;
+	VkCommandPool m_pool;
+	/* Keyed by frame in flight in the high bits, swapchain image in the low */
+	std::unordered_map<uint64_t, Entry> m_entries;
+	CommandEncoder m_encoder;
+	uint32_t m_recordCount = 0;
+};
+
+/**
+ * @brief Mixes a value into a running command buffer signature (FNV-1a, one step per value)
+ */
+template <typename T> inline void hashSignature(uint64_t& signature, const T& value) {
+	static_assert(std::is_trivially_copyable_v<T>, "only plain handles can be hashed");
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+	for (size_t i = 0; i < sizeof(T); i++) {
+		signature = (signature ^ bytes[i]) * 0x100000001b3ull;
+	}
+}
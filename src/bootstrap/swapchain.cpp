@@ -22,7 +22,7 @@ VulkanSwapChain::VulkanSwapChain(Ref<VulkanInstance> instance, Ref<VulkanDevice>
 	createSwapChain(m_device, m_window, m_surface);
 	createImageViews();
 	createOffscreenRenderPass();
-	createPostProcessingRenderPass();
+	createPostProcessingRenderPasses();
 	createDepthResources();
 	createFramebuffers();
 	createOffscreenFrameBufs();
@@ -41,6 +41,7 @@ VulkanSwapChain::~VulkanSwapChain() {
 
 	vkDestroyRenderPass(m_device->getLogicalDevice(), m_offscreenRenderPass, nullptr);
 	vkDestroyRenderPass(m_device->getLogicalDevice(), m_postprocessRenderPass, nullptr);
+	vkDestroyRenderPass(m_device->getLogicalDevice(), m_uiRenderPass, nullptr);
 }
 
 void VulkanSwapChain::createSwapChain(const Ref<VulkanDevice> device, const Ref<GLFWWindow> window,
@@ -71,6 +72,12 @@ void VulkanSwapChain::createSwapChain(const Ref<VulkanDevice> device, const Ref<
 	createInfo.imageExtent = extent;
 	createInfo.imageArrayLayers = 1;
 	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	// Copied out of for captures, if the surface allows it
+	m_capturable = swapChainSupport.capabilities.supportedUsageFlags &
+	               VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	if (m_capturable) {
+		createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
 	createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.presentMode = presentMode;
@@ -220,6 +227,7 @@ void VulkanSwapChain::recreate() {
 	createOffscreenFrameBufs();
 
 	m_beenRecreated = true;
+	m_generation++;
 }
 
 void VulkanSwapChain::cleanup() {
@@ -252,8 +260,9 @@ void VulkanSwapChain::createImageViews() {
 
 void VulkanSwapChain::createDepthResources() {
 	VkFormat depthFormat = m_device->findDepthFormat();
+	// Sampled as well, to upsample the sky around the edges of geometry
 	m_device->createImage(m_extent.width, m_extent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL,
-	                      VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+	                      VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 	                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthImage, m_depthImageMemory);
 	m_depthImageView =
 		m_device->createImageView(m_depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
@@ -308,7 +317,8 @@ void VulkanSwapChain::createOffscreenRenderPass() {
 	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	// Nothing writes depth after the geometry pass, later passes only test against or sample it
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 
 	// create reference to attached image
 	VkAttachmentReference colorAttachmentRef {};
@@ -327,16 +337,23 @@ void VulkanSwapChain::createOffscreenRenderPass() {
 	subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
 	// Make render subpass depend on image being available
-	std::array<VkSubpassDependency, 2> dependencies;
+	std::array<VkSubpassDependency, 3> dependencies;
 
-	// Any previous render pass must have finished fragment shading before writing colors
+	// Any previous render pass must have finished fragment shading before writing colors. Depth
+	// is shared by every frame in flight, and the last frame's low resolution sky may still be
+	// sampling it in a compute pass, so clearing it waits on that too
 	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 	dependencies[0].dstSubpass = 0;
-	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[0].srcStageMask =
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 	dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+	                               VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+	                               VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstAccessMask =
+		VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	// Compute isn't a framebuffer stage, so this can't be by region
+	dependencies[0].dependencyFlags = 0;
 
 	// We must have finished writing colors before any future render pass can begin fragment shading
 	dependencies[1].srcSubpass = 0;
@@ -347,6 +364,16 @@ void VulkanSwapChain::createOffscreenRenderPass() {
 	dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 	dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
+	// Likewise for depth, which the low resolution sky samples in a compute pass
+	dependencies[2].srcSubpass = 0;
+	dependencies[2].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[2].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[2].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[2].dstStageMask =
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	dependencies[2].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	dependencies[2].dependencyFlags = 0;
+
 	// Create render pass
 	std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
 	VkRenderPassCreateInfo renderPassInfo {};
@@ -389,7 +416,7 @@ void VulkanSwapChain::createFramebuffers() {
 	}
 }
 
-void VulkanSwapChain::createPostProcessingRenderPass() {
+void VulkanSwapChain::createPostProcessingRenderPasses() {
 	VkAttachmentDescription colorAttachment {};
 	colorAttachment.format = m_imageFormat;
 	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -400,9 +427,8 @@ void VulkanSwapChain::createPostProcessingRenderPass() {
 	colorAttachment.stencilStoreOp =
 		VK_ATTACHMENT_STORE_OP_DONT_CARE; // We don't use the stencil buffer
 	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	colorAttachment.finalLayout =
-		VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // Ultimately, we want the color buffer to display to the
-	                                     // screen
+	// The UI pass draws over it next
+	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 	VkAttachmentDescription depthAttachment {};
 	depthAttachment.format = m_device->findDepthFormat();
@@ -411,8 +437,9 @@ void VulkanSwapChain::createPostProcessingRenderPass() {
 	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	// Only tested against, so it can be sampled at the same time
+	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 
 	// create reference to attached image
 	VkAttachmentReference colorAttachmentRef {};
@@ -421,7 +448,7 @@ void VulkanSwapChain::createPostProcessingRenderPass() {
 
 	VkAttachmentReference depthAttachmentRef {};
 	depthAttachmentRef.attachment = 1;
-	depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 
 	// Define subpass to do rendering
 	VkSubpassDescription subpass {};
@@ -448,7 +475,8 @@ void VulkanSwapChain::createPostProcessingRenderPass() {
 	dependencies[1].dstSubpass = 0;
 	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependencies[1].srcAccessMask = 0;
+	// Also orders the UI pass after the postprocessing pass's writes
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 	dependencies[1].dstAccessMask =
 		VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
 	dependencies[1].dependencyFlags = 0;
@@ -468,6 +496,14 @@ void VulkanSwapChain::createPostProcessingRenderPass() {
 	                       &m_postprocessRenderPass) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create render pass!");
 	}
+
+	// The UI pass only differs in leaving the image to present, so it is compatible with the same
+	// framebuffers
+	attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	if (vkCreateRenderPass(m_device->getLogicalDevice(), &renderPassInfo, nullptr,
+	                       &m_uiRenderPass) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create render pass!");
+	}
 }
 
 void VulkanSwapChain::createSyncObjects() {
@@ -21,6 +21,9 @@ class VulkanSwapChain {
 
 	inline const VkRenderPass getOffscreenRenderPass() const { return m_offscreenRenderPass; }
 	inline const VkRenderPass getPostProcessRenderPass() const { return m_postprocessRenderPass; }
+	/* Draws over the postprocessed image and leaves it ready to present. Takes the same
+	 * framebuffers as the postprocessing pass */
+	inline const VkRenderPass getUIRenderPass() const { return m_uiRenderPass; }
 	/* const std::vector<Ref<Texture>> getOffscreenFramebuffers() const {
 	    std::vector<Ref<Texture>> tex;
 	    for (const auto& fb : m_offscreenFramebuffers) {
@@ -34,9 +37,23 @@ class VulkanSwapChain {
 	inline const VkFramebuffer getOffscreenFramebuffer(uint32_t imageIndex) const {
 		return m_offscreenFramebuffers[imageIndex];
 	}
+	/**
+	 * @brief Gets the depth buffer shared by every image. Between the geometry and
+	 * postprocessing passes it is in VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+	 */
+	inline VkImageView getDepthImageView() const { return m_depthImageView; }
 	inline const VkExtent2D& getExtent() const { return m_extent; }
+	inline VkImage getImage(uint32_t imageIndex) const { return m_images[imageIndex]; }
+	inline VkFormat getImageFormat() const { return m_imageFormat; }
+	/**
+	 * @brief Whether images can be copied out of once rendered, i.e. to capture frames. Between
+	 * frames they are in VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+	 */
+	inline bool isCapturable() const { return m_capturable; }
 	inline float getAspectRatio() const { return m_extent.width / (float) m_extent.height; }
 	inline bool beenRecreated() const { return m_beenRecreated; }
+	/* Number of times the swapchain has been recreated. Handles from before a change are stale */
+	inline uint32_t getGeneration() const { return m_generation; }
 
   private:
 	void createSwapChain(const Ref<VulkanDevice> device, const Ref<GLFWWindow> window,
@@ -48,7 +65,7 @@ class VulkanSwapChain {
 	void createDepthResources();
 
 	void createOffscreenFrameBufs();
-	void createPostProcessingRenderPass();
+	void createPostProcessingRenderPasses();
 
 	void recreate();
 	void cleanup();
@@ -79,11 +96,14 @@ class VulkanSwapChain {
 	Ref<GLFWWindow> m_window;
 	const VkSurfaceKHR m_surface;
 	bool m_beenRecreated = false;
+	uint32_t m_generation = 0;
 
 	VkSwapchainKHR m_swapChain;
 
 	VkFormat m_imageFormat;
 	VkExtent2D m_extent;
+	/* Whether images were created with VK_IMAGE_USAGE_TRANSFER_SRC_BIT */
+	bool m_capturable = false;
 
 	/* Each render pass instance defines a set of image resources, referred to as attachments, used
 	 * during rendering*/
@@ -91,6 +111,8 @@ class VulkanSwapChain {
 	// NOTE: Could consider using subpasses here to make this more compact, not sure if good
 	// performance wise
 	VkRenderPass m_postprocessRenderPass;
+	/* Separate from the postprocessing pass so the two can be timed apart */
+	VkRenderPass m_uiRenderPass;
 	std::vector<VkImage> m_images;
 	std::vector<VkImageView> m_imageViews;
 	VkImage m_depthImage;
@@ -0,0 +1,176 @@
+#include "texture_table.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "renderer/texture_lib.hpp"
+#include "util/constants.hpp"
+#include "util/log.hpp"
+
+BindlessTextureTable::BindlessTextureTable(Ref<VulkanDevice> device)
+	: m_device(device),
+	  m_capacity(std::min(MAX_BINDLESS_TEXTURES, device->getMaxBindlessTextures())) {
+	createSampler();
+	createDescriptorSetLayout();
+	createDescriptorPool();
+	createDescriptorSet();
+}
+
+BindlessTextureTable::~BindlessTextureTable() {
+	vkDestroyDescriptorPool(m_device->getLogicalDevice(), m_descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(m_device->getLogicalDevice(), m_layout, nullptr);
+	vkDestroySampler(m_device->getLogicalDevice(), m_sampler, nullptr);
+}
+
+void BindlessTextureTable::sync() {
+	const auto& textures = TextureLibrary::get()->getTextures();
+	if (textures.size() <= m_numSynced) {
+		return;
+	}
+
+	if (textures.size() > m_capacity) {
+		LOG_ERROR("Bindless texture table is full ({0} slots). Ignoring {1} textures", m_capacity,
+		          textures.size() - m_capacity);
+	}
+	uint32_t end = std::min(static_cast<uint32_t>(textures.size()), m_capacity);
+
+	std::vector<VkDescriptorImageInfo> imageInfos(end - m_numSynced);
+	std::vector<VkWriteDescriptorSet> writes(end - m_numSynced);
+
+	for (uint32_t i = m_numSynced; i < end; i++) {
+		VkDescriptorImageInfo& imageInfo = imageInfos[i - m_numSynced];
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = textures[i]->getImageView();
+		imageInfo.sampler = m_sampler;
+
+		VkWriteDescriptorSet& write = writes[i - m_numSynced];
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = m_descriptorSet;
+		write.dstBinding = 0;
+		write.dstArrayElement = textures[i]->getIndex(); // slot assigned by the TextureLibrary
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.descriptorCount = 1;
+		write.pImageInfo = &imageInfo;
+	}
+
+	vkUpdateDescriptorSets(m_device->getLogicalDevice(), static_cast<uint32_t>(writes.size()),
+	                       writes.data(), 0, nullptr);
+	LOG_TRACE("Added {0} textures to bindless table", end - m_numSynced);
+
+	m_numSynced = end;
+}
+
+void BindlessTextureTable::rewrite(const Texture& texture) {
+	if (texture.getIndex() >= m_numSynced) {
+		// Not written yet, the next sync picks up its current image
+		return;
+	}
+
+	VkDescriptorImageInfo imageInfo {};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = texture.getImageView();
+	imageInfo.sampler = m_sampler;
+
+	VkWriteDescriptorSet write {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = m_descriptorSet;
+	write.dstBinding = 0;
+	write.dstArrayElement = texture.getIndex();
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.descriptorCount = 1;
+	write.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(m_device->getLogicalDevice(), 1, &write, 0, nullptr);
+}
+
+void BindlessTextureTable::createSampler() {
+	VkSamplerCreateInfo samplerInfo {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.anisotropyEnable = VK_TRUE;
+	samplerInfo.maxAnisotropy = m_device->getMaxAnistropy();
+	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.mipLodBias = 0.0f;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = 0.0f;
+
+	if (vkCreateSampler(m_device->getLogicalDevice(), &samplerInfo, nullptr, &m_sampler) !=
+	    VK_SUCCESS) {
+		throw std::runtime_error("failed to create texture sampler!");
+	}
+}
+
+void BindlessTextureTable::createDescriptorSetLayout() {
+	VkDescriptorSetLayoutBinding binding {};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	binding.descriptorCount = m_capacity;
+	// Compute shaders read textures too, i.e. lookup tables baked from other tables
+	binding.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+	binding.pImmutableSamplers = nullptr;
+
+	// Slots past the number of loaded textures are never written, and slots can be written while
+	// the set is bound
+	VkDescriptorBindingFlagsEXT bindingFlags =
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+		VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+		VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo {};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	bindingFlagsInfo.bindingCount = 1;
+	bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &binding;
+
+	if (vkCreateDescriptorSetLayout(m_device->getLogicalDevice(), &layoutInfo, nullptr,
+	                                &m_layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create bindless descriptor set layout!");
+	}
+}
+
+void BindlessTextureTable::createDescriptorPool() {
+	VkDescriptorPoolSize poolSize {};
+	poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSize.descriptorCount = m_capacity;
+
+	VkDescriptorPoolCreateInfo poolInfo {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = 1; // the table is shared by every pipeline and frame in flight
+
+	if (vkCreateDescriptorPool(m_device->getLogicalDevice(), &poolInfo, nullptr,
+	                           &m_descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create bindless descriptor pool!");
+	}
+}
+
+void BindlessTextureTable::createDescriptorSet() {
+	VkDescriptorSetAllocateInfo allocInfo {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = m_descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &m_layout;
+
+	if (vkAllocateDescriptorSets(m_device->getLogicalDevice(), &allocInfo, &m_descriptorSet) !=
+	    VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate bindless descriptor set!");
+	}
+}
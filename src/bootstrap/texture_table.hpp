@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include "device.hpp"
+#include "renderer/texture.hpp"
+#include "util/memory.hpp"
+
+/**
+ * @class BindlessTextureTable
+ * @brief A single descriptor set holding every texture known to the TextureLibrary
+ *
+ * Shaders index the table with the value of Texture::getIndex(). The binding is partially bound
+ * and update-after-bind, so newly loaded textures can be written into the table while it is bound
+ * in command buffers that are still executing. Pipelines never need to know which textures exist.
+ */
+class BindlessTextureTable {
+  public:
+	BindlessTextureTable(Ref<VulkanDevice> device);
+	~BindlessTextureTable();
+
+	BindlessTextureTable(const BindlessTextureTable&) = delete;
+
+	/**
+	 * @brief Writes descriptors for any textures loaded since the last call
+	 *
+	 * Should be called once per frame, before any draws that may reference new textures.
+	 */
+	void sync();
+	/**
+	 * @brief Writes the descriptor of a texture already in the table again, i.e. after its image
+	 * was replaced. The slot must not be in use by any command buffer still executing
+	 */
+	void rewrite(const Texture& texture);
+
+	inline VkDescriptorSetLayout getLayout() const { return m_layout; }
+	inline VkDescriptorSet getDescriptorSet() const { return m_descriptorSet; }
+	inline uint32_t getCapacity() const { return m_capacity; }
+
+  private:
+	void createSampler();
+	void createDescriptorSetLayout();
+	void createDescriptorPool();
+	void createDescriptorSet();
+
+  private:
+	Ref<VulkanDevice> m_device;
+
+	/* Max number of textures the table can hold */
+	uint32_t m_capacity;
+	/* Number of textures from the TextureLibrary already written to the table */
+	uint32_t m_numSynced = 0;
+
+	/* Sampler shared by every texture in the table */
+	VkSampler m_sampler;
+	VkDescriptorSetLayout m_layout;
+	VkDescriptorPool m_descriptorPool;
+	VkDescriptorSet m_descriptorSet;
+};
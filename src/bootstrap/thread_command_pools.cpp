@@ -0,0 +1,58 @@
+#include "thread_command_pools.hpp"
+
+#include <stdexcept>
+
+ThreadCommandPools::ThreadCommandPools(Ref<VulkanDevice> device, uint32_t numThreads)
+	: m_device(device), m_pools(numThreads) {
+	VkCommandPoolCreateInfo poolInfo {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // rerecorded every frame
+	poolInfo.queueFamilyIndex = m_device->getQueueFamilyIndices().graphicsFamily.value();
+
+	for (auto& threadPools : m_pools) {
+		for (auto& pool : threadPools) {
+			if (vkCreateCommandPool(m_device->getLogicalDevice(), &poolInfo, nullptr,
+			                        &pool.pool) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create thread command pool!");
+			}
+		}
+	}
+}
+
+ThreadCommandPools::~ThreadCommandPools() {
+	for (auto& threadPools : m_pools) {
+		for (auto& pool : threadPools) {
+			vkDestroyCommandPool(m_device->getLogicalDevice(), pool.pool, nullptr);
+		}
+	}
+}
+
+void ThreadCommandPools::resetFrame(uint32_t currentFrame) {
+	for (auto& threadPools : m_pools) {
+		Pool& pool = threadPools[currentFrame];
+		if (pool.used > 0) {
+			vkResetCommandPool(m_device->getLogicalDevice(), pool.pool, 0);
+			pool.used = 0;
+		}
+	}
+}
+
+VkCommandBuffer ThreadCommandPools::getSecondary(uint32_t thread, uint32_t currentFrame) {
+	Pool& pool = m_pools[thread][currentFrame];
+	if (pool.used == pool.buffers.size()) {
+		VkCommandBufferAllocateInfo allocInfo {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = pool.pool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY; // executed from the primary buffer
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer buffer;
+		if (vkAllocateCommandBuffers(m_device->getLogicalDevice(), &allocInfo, &buffer) !=
+		    VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate secondary command buffer!");
+		}
+		pool.buffers.push_back(buffer);
+	}
+
+	return pool.buffers[pool.used++];
+}
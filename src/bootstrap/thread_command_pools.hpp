@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "device.hpp"
+#include "util/constants.hpp"
+#include "util/memory.hpp"
+
+/**
+ * @class ThreadCommandPools
+ * @brief One command pool per recording thread per frame in flight, handing out secondary command
+ * buffers
+ *
+ * Command pools must not be used by two threads at once, so each worker records only from its own
+ * pool. Each frame's pools are reset as a whole once that frame's fence has signalled, which is
+ * cheaper than resetting buffers one at a time.
+ */
+class ThreadCommandPools {
+  public:
+	ThreadCommandPools(Ref<VulkanDevice> device, uint32_t numThreads);
+	~ThreadCommandPools();
+
+	ThreadCommandPools(const ThreadCommandPools&) = delete;
+
+	/**
+	 * @brief Resets every thread's pool for the given frame, recycling all of its buffers. The
+	 * frame must no longer be executing.
+	 */
+	void resetFrame(uint32_t currentFrame);
+	/**
+	 * @brief Gets an unused secondary command buffer from the thread's pool, allocating one if
+	 * needed. Only call from the given thread.
+	 *
+	 * @return A secondary VkCommandBuffer in its initial state
+	 */
+	VkCommandBuffer getSecondary(uint32_t thread, uint32_t currentFrame);
+
+  private:
+	struct Pool {
+		VkCommandPool pool = VK_NULL_HANDLE;
+		/* Every buffer allocated from the pool, freed with it */
+		std::vector<VkCommandBuffer> buffers;
+		/* Number of buffers handed out since the last reset */
+		uint32_t used = 0;
+	};
+
+	Ref<VulkanDevice> m_device;
+	/* Indexed by thread */
+	std::vector<Frames<Pool>> m_pools;
+};
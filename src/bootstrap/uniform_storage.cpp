@@ -0,0 +1,54 @@
+#include "uniform_storage.hpp"
+
+#include <stdexcept>
+#include <vulkan/vulkan_core.h>
+
+#include "util/log.hpp"
+
+// Size of each frame's uniform buffer. Every uniform of every shader has to fit
+static const uint32_t UNIFORM_STORAGE_SIZE = 64 * 1024;
+
+UniformStorage::UniformStorage(Ref<VulkanDevice> device)
+	: m_device(device), m_capacity(UNIFORM_STORAGE_SIZE) {
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		m_device->createBuffer(m_capacity, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+		                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		                       m_buffers[i], m_buffersMemory[i]);
+
+		void* mapped;
+		vkMapMemory(m_device->getLogicalDevice(), m_buffersMemory[i], 0, m_capacity, 0, &mapped);
+		m_buffersMapped[i] = static_cast<char*>(mapped);
+	}
+}
+
+UniformStorage::~UniformStorage() {
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		vkDestroyBuffer(m_device->getLogicalDevice(), m_buffers[i], nullptr);
+		vkFreeMemory(m_device->getLogicalDevice(), m_buffersMemory[i], nullptr);
+	}
+}
+
+uint32_t UniformStorage::getSlot(const std::string& name, uint32_t size) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto slot = m_slots.find(name);
+	if (slot != m_slots.end()) {
+		if (slot->second.second != size) {
+			throw std::runtime_error("Uniform " + name + " used with different sizes!");
+		}
+		return slot->second.first;
+	}
+
+	// Descriptors can only point at suitably aligned offsets
+	uint32_t alignment = m_device->getMinUniformBufferOffsetAlignment();
+	uint32_t offset = (m_size + alignment - 1) / alignment * alignment;
+	if (offset + size > m_capacity) {
+		throw std::runtime_error("failed to reserve uniform " + name + ", storage is full!");
+	}
+
+	LOG_TRACE("Reserved uniform slot for {0} at offset {1}", name, offset);
+	m_slots[name] = {offset, size};
+	m_size = offset + size;
+	return offset;
+}
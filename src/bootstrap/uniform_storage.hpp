@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vulkan/vulkan_core.h>
+
+#include "device.hpp"
+#include "util/constants.hpp"
+#include "util/gpu_layout.hpp"
+#include "util/memory.hpp"
+
+/**
+ * @class UniformHandle
+ * @brief A uniform resolved once by name. Writing through it needs no lookups.
+ */
+template <typename T> class UniformHandle {
+	static_assert(GpuLayout<T>::value, "uniform type has no checked GPU layout");
+	friend class UniformStorage;
+
+  public:
+	UniformHandle() = default;
+
+  private:
+	explicit UniformHandle(uint32_t offset) : m_offset(offset) {}
+
+	/* Offset of this uniform's slot in each frame's buffer */
+	uint32_t m_offset = 0;
+};
+
+/**
+ * @class UniformStorage
+ * @brief One host visible buffer per frame in flight, holding every uniform by name
+ *
+ * Each named uniform gets a single slot, which every pipeline using that uniform reads from. A
+ * write is therefore one memcpy, no matter how many pipelines use the uniform.
+ */
+class UniformStorage {
+  public:
+	UniformStorage(Ref<VulkanDevice> device);
+	~UniformStorage();
+
+	UniformStorage(const UniformStorage&) = delete;
+
+	/**
+	 * @brief Gets the offset of the slot for the given uniform, reserving one on first use
+	 *
+	 * @param name The name of the uniform, as listed in the shader uniform map
+	 * @param size The size of the uniform. Must match every other use of the same name
+	 */
+	uint32_t getSlot(const std::string& name, uint32_t size);
+
+	template <typename T> UniformHandle<T> getHandle(const std::string& name) {
+		return UniformHandle<T>(getSlot(name, sizeof(T)));
+	}
+
+	template <typename T>
+	inline void write(UniformHandle<T> handle, const T& data, uint32_t currentFrame) {
+		memcpy(m_buffersMapped[currentFrame] + handle.m_offset, &data, sizeof(T));
+	}
+
+	inline VkBuffer getBuffer(uint32_t currentFrame) const { return m_buffers[currentFrame]; }
+
+  private:
+	Ref<VulkanDevice> m_device;
+
+	/* Bytes reserved so far, and the max that can be */
+	uint32_t m_size = 0;
+	uint32_t m_capacity;
+
+	/* Offset and size of each uniform's slot */
+	std::unordered_map<std::string, std::pair<uint32_t, uint32_t>> m_slots;
+	/* Pipelines may be built off the main thread */
+	std::mutex m_mutex;
+
+	Frames<VkBuffer> m_buffers;
+	Frames<VkDeviceMemory> m_buffersMemory;
+	/* CPU address linked to location of uniforms on GPU */
+	Frames<char*> m_buffersMapped;
+};
@@ -6,7 +6,12 @@
 
 class GLFWWindow {
   public:
-	GLFWWindow(std::string name, uint32_t width = 800, uint32_t height = 600);
+	/**
+	 * @param visible Whether to show the window. Hidden windows still have a surface to render
+	 * to, i.e. to run without anyone watching
+	 */
+	GLFWWindow(std::string name, uint32_t width = 800, uint32_t height = 600,
+	           bool visible = true);
 	~GLFWWindow();
 
 	GLFWWindow(const GLFWWindow&) = delete;
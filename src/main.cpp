@@ -1,14 +1,28 @@
+#include <cstring>
+#include <string>
+
 #include "application/application.hpp"
 #include "util/log.hpp"
 #include "util/profiler.hpp"
 
-int main() {
+// Where --sweep writes its results if not given a path
+static const char* const DEFAULT_SWEEP_PATH = "sweep.csv";
+
+int main(int argc, char** argv) {
 	Log::Init(spdlog::level::info);
-	Application app;
+
+	// --sweep [path] sweeps quality settings in a hidden window, then exits
+	bool sweep = argc > 1 && std::strcmp(argv[1], "--sweep") == 0;
+	std::string sweepPath = sweep && argc > 2 ? argv[2] : DEFAULT_SWEEP_PATH;
+	Application app(sweep);
 
 	try {
 		PROFILE_BEGIN_SESSION("Runtime", "Runtime_Profile.json");
-		app.run();
+		if (sweep) {
+			app.runSweep(sweepPath);
+		} else {
+			app.run();
+		}
 		PROFILE_END_SESSION();
 	} catch (const std::exception& e) {
 		LOG_ERROR("{0}", e.what());
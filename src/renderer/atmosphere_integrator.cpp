@@ -0,0 +1,368 @@
+#include "atmosphere_integrator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "util/profiler.hpp"
+#include "util/simd.hpp"
+
+#if SUNSET_SIMD_WIDTH > 1
+#include <immintrin.h>
+#endif
+
+// Distance to a sphere a ray misses, as in raySphere() of atmosphere.glsl
+static const float MAX_FLOAT = 3.402823466e+38f;
+// Color atmosphere.frag draws where the eye sees the ground
+static const glm::vec3 GROUND_COLOR = {0.80f, 0.43f, 0.18f};
+// Lowered from the planet's surface before testing whether a ray hits it, as atmosphere.frag does
+static const float PLANET_EPSILON = 0.1f;
+
+// One float per ray, SUNSET_SIMD_WIDTH rays at a time. Comparisons give a Mask, with every bit
+// set in the lanes they hold for
+
+#if SUNSET_SIMD_WIDTH == 8
+
+struct Lanes {
+	__m256 v;
+};
+struct Mask {
+	__m256 v;
+};
+
+static inline Lanes splat(float f) { return {_mm256_set1_ps(f)}; }
+static inline Lanes load(const float* src) { return {_mm256_loadu_ps(src)}; }
+static inline void store(float* dst, Lanes a) { _mm256_storeu_ps(dst, a.v); }
+static inline Lanes operator+(Lanes a, Lanes b) { return {_mm256_add_ps(a.v, b.v)}; }
+static inline Lanes operator-(Lanes a, Lanes b) { return {_mm256_sub_ps(a.v, b.v)}; }
+static inline Lanes operator*(Lanes a, Lanes b) { return {_mm256_mul_ps(a.v, b.v)}; }
+static inline Lanes operator/(Lanes a, Lanes b) { return {_mm256_div_ps(a.v, b.v)}; }
+static inline Lanes min(Lanes a, Lanes b) { return {_mm256_min_ps(a.v, b.v)}; }
+static inline Lanes max(Lanes a, Lanes b) { return {_mm256_max_ps(a.v, b.v)}; }
+static inline Lanes sqrt(Lanes a) { return {_mm256_sqrt_ps(a.v)}; }
+static inline Lanes round(Lanes a) {
+	return {_mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)};
+}
+static inline Mask operator<(Lanes a, Lanes b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+static inline Mask operator>(Lanes a, Lanes b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+static inline Mask operator>=(Lanes a, Lanes b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)}; }
+static inline Mask operator&(Mask a, Mask b) { return {_mm256_and_ps(a.v, b.v)}; }
+static inline Lanes select(Mask mask, Lanes a, Lanes b) {
+	return {_mm256_blendv_ps(b.v, a.v, mask.v)};
+}
+static inline void storeMask(float* dst, Mask mask) {
+	_mm256_storeu_ps(dst, _mm256_and_ps(mask.v, _mm256_set1_ps(1.0f)));
+}
+// 2^n, for whole numbers n in the range of a float's exponent. AVX has no 256 bit integer
+// instructions, so the exponent bits are built a half at a time
+static inline Lanes exp2Whole(Lanes n) {
+	__m256i whole = _mm256_cvtps_epi32(n.v);
+	__m128i bias = _mm_set1_epi32(127);
+	__m128i lo = _mm_slli_epi32(_mm_add_epi32(_mm256_castsi256_si128(whole), bias), 23);
+	__m128i hi = _mm_slli_epi32(_mm_add_epi32(_mm256_extractf128_si256(whole, 1), bias), 23);
+	return {_mm256_castsi256_ps(_mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1))};
+}
+
+#elif SUNSET_SIMD_WIDTH == 4
+
+struct Lanes {
+	__m128 v;
+};
+struct Mask {
+	__m128 v;
+};
+
+static inline Lanes splat(float f) { return {_mm_set1_ps(f)}; }
+static inline Lanes load(const float* src) { return {_mm_loadu_ps(src)}; }
+static inline void store(float* dst, Lanes a) { _mm_storeu_ps(dst, a.v); }
+static inline Lanes operator+(Lanes a, Lanes b) { return {_mm_add_ps(a.v, b.v)}; }
+static inline Lanes operator-(Lanes a, Lanes b) { return {_mm_sub_ps(a.v, b.v)}; }
+static inline Lanes operator*(Lanes a, Lanes b) { return {_mm_mul_ps(a.v, b.v)}; }
+static inline Lanes operator/(Lanes a, Lanes b) { return {_mm_div_ps(a.v, b.v)}; }
+static inline Lanes min(Lanes a, Lanes b) { return {_mm_min_ps(a.v, b.v)}; }
+static inline Lanes max(Lanes a, Lanes b) { return {_mm_max_ps(a.v, b.v)}; }
+static inline Lanes sqrt(Lanes a) { return {_mm_sqrt_ps(a.v)}; }
+// SSE2 has no rounding instruction, but converting to integers rounds to nearest
+static inline Lanes round(Lanes a) { return {_mm_cvtepi32_ps(_mm_cvtps_epi32(a.v))}; }
+static inline Mask operator<(Lanes a, Lanes b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+static inline Mask operator>(Lanes a, Lanes b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+static inline Mask operator>=(Lanes a, Lanes b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+static inline Mask operator&(Mask a, Mask b) { return {_mm_and_ps(a.v, b.v)}; }
+// Blends need SSE4.1, so pick bits with the mask instead
+static inline Lanes select(Mask mask, Lanes a, Lanes b) {
+	return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))};
+}
+static inline void storeMask(float* dst, Mask mask) {
+	_mm_storeu_ps(dst, _mm_and_ps(mask.v, _mm_set1_ps(1.0f)));
+}
+// 2^n, for whole numbers n in the range of a float's exponent
+static inline Lanes exp2Whole(Lanes n) {
+	__m128i whole = _mm_cvtps_epi32(n.v);
+	return {_mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(whole, _mm_set1_epi32(127)), 23))};
+}
+
+#else
+
+struct Lanes {
+	float v;
+};
+struct Mask {
+	bool v;
+};
+
+static inline Lanes splat(float f) { return {f}; }
+static inline Lanes load(const float* src) { return {*src}; }
+static inline void store(float* dst, Lanes a) { *dst = a.v; }
+static inline Lanes operator+(Lanes a, Lanes b) { return {a.v + b.v}; }
+static inline Lanes operator-(Lanes a, Lanes b) { return {a.v - b.v}; }
+static inline Lanes operator*(Lanes a, Lanes b) { return {a.v * b.v}; }
+static inline Lanes operator/(Lanes a, Lanes b) { return {a.v / b.v}; }
+static inline Lanes min(Lanes a, Lanes b) { return {std::min(a.v, b.v)}; }
+static inline Lanes max(Lanes a, Lanes b) { return {std::max(a.v, b.v)}; }
+static inline Lanes sqrt(Lanes a) { return {std::sqrt(a.v)}; }
+static inline Lanes round(Lanes a) { return {std::nearbyint(a.v)}; }
+static inline Mask operator<(Lanes a, Lanes b) { return {a.v < b.v}; }
+static inline Mask operator>(Lanes a, Lanes b) { return {a.v > b.v}; }
+static inline Mask operator>=(Lanes a, Lanes b) { return {a.v >= b.v}; }
+static inline Mask operator&(Mask a, Mask b) { return {a.v && b.v}; }
+static inline Lanes select(Mask mask, Lanes a, Lanes b) { return mask.v ? a : b; }
+static inline void storeMask(float* dst, Mask mask) { *dst = mask.v ? 1.0f : 0.0f; }
+static inline Lanes exp2Whole(Lanes n) { return {std::ldexp(1.0f, static_cast<int>(n.v))}; }
+
+#endif
+
+/**
+ * @brief e^x, to within a couple of ulps. Cephes' expf: 2^n times a polynomial of what is left
+ */
+static inline Lanes exp(Lanes x) {
+	// Past these, the result would over or underflow
+	x = min(max(x, splat(-87.3f)), splat(88.3f));
+	Lanes n = round(x * splat(1.44269504f));
+	// ln(2) split in two, so n * ln(2) loses no precision
+	Lanes r = x - n * splat(0.693359375f) - n * splat(-2.12194440e-4f);
+
+	Lanes p = splat(1.9875691500e-4f);
+	p = p * r + splat(1.3981999507e-3f);
+	p = p * r + splat(8.3334519073e-3f);
+	p = p * r + splat(4.1665795894e-2f);
+	p = p * r + splat(1.6666665459e-1f);
+	p = p * r + splat(5.0000001201e-1f);
+	Lanes y = p * r * r + r + splat(1.0f);
+	return y * exp2Whole(n);
+}
+
+/* A vector per ray */
+struct Vec3Lanes {
+	Lanes x, y, z;
+};
+
+static inline Vec3Lanes splat(const glm::vec3& v) { return {splat(v.x), splat(v.y), splat(v.z)}; }
+static inline Vec3Lanes operator+(const Vec3Lanes& a, const Vec3Lanes& b) {
+	return {a.x + b.x, a.y + b.y, a.z + b.z};
+}
+static inline Vec3Lanes operator-(const Vec3Lanes& a, const Vec3Lanes& b) {
+	return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+static inline Vec3Lanes operator*(const Vec3Lanes& a, Lanes s) {
+	return {a.x * s, a.y * s, a.z * s};
+}
+static inline Lanes dot(const Vec3Lanes& a, const Vec3Lanes& b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+/* Shape of the atmosphere, in the terms every ray is integrated in */
+struct AtmosphereShape {
+	glm::vec3 center;
+	float radius;
+	float planetRadius;
+	float thickness;
+	float densityFalloff;
+
+	AtmosphereShape(const Atmosphere& atmosphere, const glm::vec3& planetCenter)
+		: center(planetCenter), radius(atmosphere.radius),
+		  planetRadius(atmosphere.radius * atmosphere.offsetFactor),
+		  thickness(atmosphere.radius * (1.0f - atmosphere.offsetFactor)),
+		  densityFalloff(atmosphere.densityFalloff) {}
+};
+
+/**
+ * @brief raySphere() of atmosphere.glsl
+ *
+ * @param dstToSphere Set to the distance to the sphere, or MAX_FLOAT if the ray misses it
+ * @param dstThroughSphere Set to the distance through the sphere, or 0 if the ray misses it
+ */
+static void raySphere(const Vec3Lanes& origin, const Vec3Lanes& dir, const glm::vec3& center,
+                      float radius, Lanes& dstToSphere, Lanes& dstThroughSphere) {
+	Vec3Lanes offset = origin - splat(center);
+
+	Lanes a = dot(dir, dir);
+	Lanes b = splat(2.0f) * dot(dir, offset);
+	Lanes c = dot(offset, offset) - splat(radius * radius);
+	Lanes d = b * b - splat(4.0f) * a * c;
+
+	Lanes s = sqrt(max(d, splat(0.0f)));
+	Lanes dstToSphereNear = max(splat(0.0f), (splat(0.0f) - b - s) / (splat(2.0f) * a));
+	Lanes dstToSphereFar = (s - b) / (splat(2.0f) * a);
+
+	// Only intersections in front of the ray count
+	Mask hit = (d > splat(0.0f)) & (dstToSphereFar >= splat(0.0f));
+	dstToSphere = select(hit, dstToSphereNear, splat(MAX_FLOAT));
+	dstThroughSphere = select(hit, dstToSphereFar - dstToSphereNear, splat(0.0f));
+}
+
+/**
+ * @brief densityAtPoint() of the atmosphere shaders
+ */
+static inline Lanes densityAtPoint(const Vec3Lanes& point, const AtmosphereShape& shape) {
+	Vec3Lanes up = point - splat(shape.center);
+	Lanes height = (sqrt(dot(up, up)) - splat(shape.planetRadius)) / splat(shape.thickness);
+	return exp(splat(0.0f) - height * splat(shape.densityFalloff)) * (splat(1.0f) - height);
+}
+
+/**
+ * @brief Integrates density along a ray, by the midpoint rule like optical_depth.comp
+ */
+static Lanes opticalDepth(const Vec3Lanes& origin, const Vec3Lanes& dir, Lanes len,
+                          const AtmosphereShape& shape, uint32_t numSamples) {
+	Lanes stepSize = len / splat(static_cast<float>(numSamples));
+	Lanes depth = splat(0.0f);
+	for (uint32_t i = 0; i < numSamples; i++) {
+		Vec3Lanes samplePoint = origin + dir * (stepSize * splat(i + 0.5f));
+		depth = depth + densityAtPoint(samplePoint, shape);
+	}
+	return depth * stepSize;
+}
+
+/**
+ * @brief calculateLight() of the atmosphere shaders, for rays from the eye at the origin
+ *
+ * @param light Set to the light scattered towards the eye, per color channel
+ * @return Which rays see sky rather than the ground
+ */
+static Mask calculateLight(const Vec3Lanes& dir, const AtmosphereShape& shape,
+                           const Atmosphere& atmosphere, const glm::vec3& sunPos,
+                           const ReferenceSkySettings& settings, std::array<Lanes, 3>& light) {
+	Vec3Lanes eyePos = splat(glm::vec3(0.0f));
+	Lanes planetDist, planetLen, atmosDist, atmosLen;
+	raySphere(eyePos, dir, shape.center, shape.planetRadius - PLANET_EPSILON, planetDist,
+	          planetLen);
+	raySphere(eyePos, dir, shape.center, shape.radius, atmosDist, atmosLen);
+	Lanes distInAtmos = min(atmosLen, planetDist - atmosDist);
+
+	// Midpoint rule, where the shaders also sample the end points. Optical depth back to the eye
+	// is summed up along the way, rather than marched again from every point
+	Lanes stepSize = distInAtmos / splat(static_cast<float>(settings.inScatteringPoints));
+	Lanes viewRayOpticalDepth = splat(0.0f);
+	light.fill(splat(0.0f));
+	for (uint32_t i = 0; i < settings.inScatteringPoints; i++) {
+		Vec3Lanes inScatterPoint = eyePos + dir * (stepSize * splat(i + 0.5f));
+		Lanes localDensity = densityAtPoint(inScatterPoint, shape);
+		Lanes halfStepDepth = localDensity * stepSize * splat(0.5f);
+		viewRayOpticalDepth = viewRayOpticalDepth + halfStepDepth;
+
+		Vec3Lanes toSun = splat(sunPos) - inScatterPoint;
+		Vec3Lanes dirToSun = toSun * (splat(1.0f) / sqrt(dot(toSun, toSun)));
+		Lanes sunDist, sunRayLen;
+		raySphere(inScatterPoint, dirToSun, shape.center, shape.radius, sunDist, sunRayLen);
+		Lanes sunRayOpticalDepth = opticalDepth(inScatterPoint, dirToSun, sunRayLen, shape,
+		                                        settings.opticalDepthPoints);
+
+		Lanes depth = sunRayOpticalDepth + viewRayOpticalDepth;
+		for (uint32_t channel = 0; channel < 3; channel++) {
+			Lanes coef = splat(atmosphere.defractionCoef[channel]);
+			Lanes transmittance = exp(splat(0.0f) - depth * coef);
+			light[channel] = light[channel] + localDensity * transmittance * coef * stepSize;
+		}
+		viewRayOpticalDepth = viewRayOpticalDepth + halfStepDepth;
+	}
+
+	return atmosLen < planetDist;
+}
+
+AtmosphereIntegrator::AtmosphereIntegrator(uint32_t numThreads)
+	: m_pool(numThreads > 0 ? numThreads : std::max(std::thread::hardware_concurrency(), 1u)) {}
+
+std::vector<glm::vec4> AtmosphereIntegrator::renderSky(const Atmosphere& atmosphere,
+                                                       const LightSource& light,
+                                                       const glm::mat4& viewProj,
+                                                       const glm::uvec2& size,
+                                                       const ReferenceSkySettings& settings) {
+	PROFILE_FUNC();
+	std::vector<glm::vec4> pixels(size.x * size.y);
+	AtmosphereShape shape(atmosphere, atmosphere.center);
+	glm::mat4 invViewProj = glm::inverse(viewProj);
+
+	m_pool.parallelFor(size.y, [&](uint32_t row, uint32_t) {
+		for (uint32_t x = 0; x < size.x; x += SUNSET_SIMD_WIDTH) {
+			// Lanes past the end of the row repeat its last pixel, and are thrown away
+			std::array<float, SUNSET_SIMD_WIDTH> dirX, dirY, dirZ;
+			for (uint32_t lane = 0; lane < SUNSET_SIMD_WIDTH; lane++) {
+				uint32_t column = std::min(x + lane, size.x - 1);
+				glm::vec2 uv = (glm::vec2(column, row) + 0.5f) / glm::vec2(size);
+				glm::vec4 viewPos = invViewProj * glm::vec4(uv * 2.0f - 1.0f, 1.0f, 1.0f);
+				glm::vec3 dir = glm::normalize(glm::vec3(viewPos) / viewPos.w);
+				dirX[lane] = dir.x;
+				dirY[lane] = dir.y;
+				dirZ[lane] = dir.z;
+			}
+
+			Vec3Lanes dir = {load(dirX.data()), load(dirY.data()), load(dirZ.data())};
+			std::array<Lanes, 3> inScattered;
+			Mask sky = calculateLight(dir, shape, atmosphere, light.pos, settings, inScattered);
+
+			std::array<std::array<float, SUNSET_SIMD_WIDTH>, 3> color;
+			std::array<float, SUNSET_SIMD_WIDTH> seesSky;
+			for (uint32_t channel = 0; channel < 3; channel++) {
+				store(color[channel].data(), inScattered[channel]);
+			}
+			storeMask(seesSky.data(), sky);
+
+			uint32_t count = std::min<uint32_t>(SUNSET_SIMD_WIDTH, size.x - x);
+			for (uint32_t lane = 0; lane < count; lane++) {
+				glm::vec4& pixel = pixels[row * size.x + x + lane];
+				if (seesSky[lane] > 0.0f) {
+					pixel = glm::vec4(color[0][lane], color[1][lane], color[2][lane], 1.0f);
+				} else {
+					pixel = glm::vec4(GROUND_COLOR, 0.0f);
+				}
+			}
+		}
+	});
+
+	return pixels;
+}
+
+std::vector<float> AtmosphereIntegrator::bakeOpticalDepth(const Atmosphere& atmosphere,
+                                                          const glm::uvec2& size,
+                                                          uint32_t numSamples) {
+	PROFILE_FUNC();
+	std::vector<float> texels(size.x * size.y);
+	// Only height and angle matter, so the planet is at the origin and rays start above it
+	AtmosphereShape shape(atmosphere, glm::vec3(0.0f));
+	glm::vec2 lastTexel = glm::max(glm::vec2(size) - 1.0f, glm::vec2(1.0f));
+
+	m_pool.parallelFor(size.y, [&](uint32_t row, uint32_t) {
+		// Inverse of opticalDepthUV, for the texel centers of this row
+		float height = shape.planetRadius + row / lastTexel.y * shape.thickness;
+		for (uint32_t x = 0; x < size.x; x += SUNSET_SIMD_WIDTH) {
+			std::array<float, SUNSET_SIMD_WIDTH> cosZenith;
+			for (uint32_t lane = 0; lane < SUNSET_SIMD_WIDTH; lane++) {
+				cosZenith[lane] = std::min(x + lane, size.x - 1) / lastTexel.x * 2.0f - 1.0f;
+			}
+
+			Lanes cosLanes = load(cosZenith.data());
+			Vec3Lanes origin = splat(glm::vec3(0.0f, height, 0.0f));
+			Vec3Lanes dir = {sqrt(max(splat(0.0f), splat(1.0f) - cosLanes * cosLanes)), cosLanes,
+			                 splat(0.0f)};
+			Lanes dist, len;
+			raySphere(origin, dir, shape.center, shape.radius, dist, len);
+
+			std::array<float, SUNSET_SIMD_WIDTH> depth;
+			store(depth.data(), opticalDepth(origin, dir, len, shape, numSamples));
+			uint32_t count = std::min<uint32_t>(SUNSET_SIMD_WIDTH, size.x - x);
+			std::copy_n(depth.begin(), count, texels.begin() + row * size.x + x);
+		}
+	});
+
+	return texels;
+}
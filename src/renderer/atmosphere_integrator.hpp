@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "renderer/shader.hpp"
+#include "util/thread_pool.hpp"
+
+/* Sample counts the reference sky is integrated with */
+struct ReferenceSkySettings {
+	/* Points along each view ray light is scattered towards the eye from */
+	uint32_t inScatteringPoints = 256;
+	/* Points along the ray from each of those to the sun */
+	uint32_t opticalDepthPoints = 256;
+};
+
+/**
+ * @class AtmosphereIntegrator
+ * @brief Integrates the atmosphere on the CPU, as a reference to measure the GPU's shortcuts
+ * against
+ *
+ * Follows the same model as atmosphere.frag did before it read lookup tables: single Rayleigh
+ * scattering of a point light, through air whose density falls off exponentially with height.
+ * Nothing is cached between rays, and sample counts can be as high as the caller can wait for,
+ * so the result converges to the exact integral rather than to what any table holds.
+ *
+ * The march along each view ray is not the one sky_view.comp does. It takes the midpoint of each
+ * step, where the shader samples both end points, and sums optical depth back to the eye along
+ * the way, where the shader takes the difference of two lookups in the optical depth table. Both
+ * converge to the same integral, but at equal sample counts they differ, so it is only a fair
+ * reference at sample counts well past the shader's. bakeOpticalDepth() does follow
+ * optical_depth.comp exactly.
+ *
+ * Rays are marched SUNSET_SIMD_WIDTH at a time, and rows are spread across a thread pool. Needs no
+ * GPU at all.
+ */
+class AtmosphereIntegrator {
+  public:
+	/**
+	 * @param numThreads Threads rows are spread across, or 0 for one per core
+	 */
+	AtmosphereIntegrator(uint32_t numThreads = 0);
+
+	AtmosphereIntegrator(const AtmosphereIntegrator&) = delete;
+
+	/**
+	 * @brief Renders the sky the atmosphere pass would draw for a camera at the origin
+	 *
+	 * @param viewProj The camera's view projection matrix
+	 * @param size Resolution of the image
+	 * @return size.x * size.y pixels, row by row from the top like the swapchain's images. Alpha
+	 * is 1 where the pixel sees sky, and 0 where it sees the ground, which is drawn a flat color
+	 */
+	std::vector<glm::vec4> renderSky(const Atmosphere& atmosphere, const LightSource& light,
+	                                 const glm::mat4& viewProj, const glm::uvec2& size,
+	                                 const ReferenceSkySettings& settings);
+	/**
+	 * @brief Bakes the optical depth LUT exactly as optical_depth.comp does, for machines which
+	 * can't run it, see SkyRenderer
+	 *
+	 * @param size Resolution of the table, by view angle and height
+	 * @param numSamples Samples integrated along the ray of each texel
+	 * @return size.x * size.y optical depths, row by row from the ground up
+	 */
+	std::vector<float> bakeOpticalDepth(const Atmosphere& atmosphere, const glm::uvec2& size,
+	                                    uint32_t numSamples);
+
+  private:
+	ThreadPool m_pool;
+};
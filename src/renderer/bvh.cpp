@@ -0,0 +1,446 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <array>
+
+#include "util/profiler.hpp"
+
+// Centroid bins per split of the SAH build
+static const uint32_t SAH_BINS = 12;
+// Changes before a background rebuild is worth it, at minimum. Otherwise a quarter of the items
+static const uint32_t MIN_CHANGES_FOR_REBUILD = 64;
+
+static AABB emptyBox() {
+	return {glm::vec3(std::numeric_limits<float>::max()),
+	        glm::vec3(-std::numeric_limits<float>::max())};
+}
+
+static AABB merge(const AABB& a, const AABB& b) {
+	return {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+}
+
+static float surfaceArea(const AABB& box) {
+	glm::vec3 d = glm::max(box.max - box.min, glm::vec3(0.0f));
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+/**
+ * @brief Slab test of a ray against a box
+ *
+ * @param tEnter Set to the distance along the ray where it enters the box, 0 if it starts inside
+ */
+static bool intersectRay(const AABB& box, const glm::vec3& origin, const glm::vec3& invDir,
+                         float maxT, float& tEnter) {
+	glm::vec3 t1 = (box.min - origin) * invDir;
+	glm::vec3 t2 = (box.max - origin) * invDir;
+	glm::vec3 tMin = glm::min(t1, t2), tMax = glm::max(t1, t2);
+	tEnter = std::max({tMin.x, tMin.y, tMin.z, 0.0f});
+	float tExit = std::min({tMax.x, tMax.y, tMax.z, maxT});
+	return tEnter <= tExit;
+}
+
+uint32_t BVH::insert(const AABB& bounds, uint32_t userData) {
+	uint32_t item;
+	if (!m_freeItems.empty()) {
+		item = m_freeItems.back();
+		m_freeItems.pop_back();
+	} else {
+		item = m_items.size();
+		m_items.emplace_back();
+	}
+
+	uint32_t leaf = allocateNode();
+	m_nodes[leaf].bounds = bounds;
+	m_nodes[leaf].item = item;
+	m_items[item] = {bounds, userData, leaf, true};
+	insertLeaf(leaf);
+
+	m_numItems++;
+	m_changesSinceBuild++;
+	return item;
+}
+
+void BVH::remove(uint32_t item) {
+	removeLeaf(m_items[item].leaf);
+	m_items[item].leaf = NONE;
+	m_items[item].alive = false;
+	(isRebuilding() ? m_removedDuringBuild : m_freeItems).push_back(item);
+
+	m_numItems--;
+	m_changesSinceBuild++;
+}
+
+void BVH::setBounds(uint32_t item, const AABB& bounds) {
+	m_items[item].bounds = bounds;
+	m_moved.push_back(item);
+	m_changesSinceBuild++;
+}
+
+void BVH::update() {
+	PROFILE_FUNC();
+	if (isRebuilding() &&
+	    m_pendingBuild.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+		swapIn(m_pendingBuild.get());
+	}
+
+	for (uint32_t item : m_moved) {
+		if (m_items[item].alive) {
+			uint32_t leaf = m_items[item].leaf;
+			m_nodes[leaf].bounds = m_items[item].bounds;
+			refitUpwards(m_nodes[leaf].parent);
+		}
+	}
+	m_moved.clear();
+
+	// Patching and refitting make the tree looser over time. Build a fresh one on the side
+	if (!isRebuilding() &&
+	    m_changesSinceBuild > std::max(MIN_CHANGES_FOR_REBUILD, m_numItems / 4)) {
+		m_changesSinceBuild = 0;
+		m_pendingBuild = std::async(std::launch::async, build, m_items);
+	}
+}
+
+void BVH::rebuild() {
+	PROFILE_FUNC();
+	if (isRebuilding()) {
+		swapIn(m_pendingBuild.get());
+	}
+	m_changesSinceBuild = 0;
+	swapIn(build(m_items));
+	m_moved.clear();
+}
+
+void BVH::queryFrustum(const Frustum& frustum, std::vector<uint32_t>& results) const {
+	if (m_root == NONE) {
+		return;
+	}
+
+	std::vector<uint32_t> stack = {m_root};
+	while (!stack.empty()) {
+		const Node& node = m_nodes[stack.back()];
+		stack.pop_back();
+		if (!frustum.intersects(node.bounds)) {
+			continue;
+		}
+
+		if (node.item != NONE) {
+			results.push_back(m_items[node.item].userData);
+		} else {
+			stack.push_back(node.left);
+			stack.push_back(node.right);
+		}
+	}
+}
+
+void BVH::querySphere(const glm::vec3& center, float radius,
+                      std::vector<uint32_t>& results) const {
+	if (m_root == NONE) {
+		return;
+	}
+
+	std::vector<uint32_t> stack = {m_root};
+	while (!stack.empty()) {
+		const Node& node = m_nodes[stack.back()];
+		stack.pop_back();
+		glm::vec3 closest = glm::clamp(center, node.bounds.min, node.bounds.max);
+		if (glm::dot(closest - center, closest - center) > radius * radius) {
+			continue;
+		}
+
+		if (node.item != NONE) {
+			results.push_back(m_items[node.item].userData);
+		} else {
+			stack.push_back(node.left);
+			stack.push_back(node.right);
+		}
+	}
+}
+
+std::optional<RayHit>
+BVH::raycast(const glm::vec3& origin, const glm::vec3& dir, float maxT,
+             const std::function<std::optional<float>(uint32_t)>& exact) const {
+	float tEnter;
+	glm::vec3 invDir = 1.0f / dir;
+	if (m_root == NONE || !intersectRay(m_nodes[m_root].bounds, origin, invDir, maxT, tEnter)) {
+		return std::nullopt;
+	}
+
+	std::optional<RayHit> hit;
+	float nearest = maxT;
+	// Entry distance is kept with each node, so nodes behind a closer hit are skipped
+	std::vector<std::pair<uint32_t, float>> stack = {{m_root, tEnter}};
+	while (!stack.empty()) {
+		auto [index, t] = stack.back();
+		stack.pop_back();
+		if (t > nearest) {
+			continue;
+		}
+
+		const Node& node = m_nodes[index];
+		if (node.item != NONE) {
+			uint32_t userData = m_items[node.item].userData;
+			std::optional<float> itemT = exact ? exact(userData) : std::optional<float>(t);
+			if (itemT.has_value() && itemT.value() <= nearest) {
+				nearest = itemT.value();
+				hit = RayHit {userData, nearest};
+			}
+			continue;
+		}
+
+		// Visit the nearer child first
+		float tLeft, tRight;
+		bool hitLeft = intersectRay(m_nodes[node.left].bounds, origin, invDir, nearest, tLeft);
+		bool hitRight = intersectRay(m_nodes[node.right].bounds, origin, invDir, nearest, tRight);
+		if (hitLeft && hitRight && tLeft < tRight) {
+			stack.push_back({node.right, tRight});
+			stack.push_back({node.left, tLeft});
+		} else {
+			if (hitLeft) {
+				stack.push_back({node.left, tLeft});
+			}
+			if (hitRight) {
+				stack.push_back({node.right, tRight});
+			}
+		}
+	}
+	return hit;
+}
+
+BVH::Build BVH::build(std::vector<Item> items) {
+	PROFILE_FUNC();
+	Build result;
+
+	std::vector<uint32_t> order;
+	for (uint32_t i = 0; i < items.size(); i++) {
+		if (items[i].alive) {
+			order.push_back(i);
+		}
+	}
+	if (!order.empty()) {
+		// Every item gets a leaf, and every leaf but one a parent
+		result.nodes.reserve(2 * order.size() - 1);
+		result.root = buildRange(result, items, order, 0, order.size());
+	}
+	return result;
+}
+
+uint32_t BVH::buildRange(Build& result, const std::vector<Item>& items,
+                         std::vector<uint32_t>& order, uint32_t first, uint32_t last) {
+	if (last - first == 1) {
+		Node leaf;
+		leaf.bounds = items[order[first]].bounds;
+		leaf.item = order[first];
+		result.nodes.push_back(leaf);
+		return result.nodes.size() - 1;
+	}
+
+	AABB centroids = emptyBox();
+	for (uint32_t i = first; i < last; i++) {
+		glm::vec3 c = items[order[i]].bounds.center();
+		centroids = {glm::min(centroids.min, c), glm::max(centroids.max, c)};
+	}
+	glm::vec3 extent = centroids.max - centroids.min;
+	int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+	uint32_t mid = first + (last - first) / 2;
+	if (extent[axis] > 0.0f) {
+		// Bin the items by centroid along the widest axis
+		auto binOf = [&](uint32_t item) {
+			float offset = items[item].bounds.center()[axis] - centroids.min[axis];
+			return std::min(SAH_BINS - 1, static_cast<uint32_t>(SAH_BINS * offset / extent[axis]));
+		};
+		std::array<AABB, SAH_BINS> binBounds;
+		std::array<uint32_t, SAH_BINS> binCounts {};
+		binBounds.fill(emptyBox());
+		for (uint32_t i = first; i < last; i++) {
+			uint32_t bin = binOf(order[i]);
+			binBounds[bin] = merge(binBounds[bin], items[order[i]].bounds);
+			binCounts[bin]++;
+		}
+
+		// Sweep from the right to get the cost of everything after each boundary, then from the
+		// left to find the cheapest boundary
+		std::array<float, SAH_BINS> rightCost {};
+		AABB right = emptyBox();
+		uint32_t rightCount = 0;
+		for (uint32_t bin = SAH_BINS - 1; bin > 0; bin--) {
+			right = merge(right, binBounds[bin]);
+			rightCount += binCounts[bin];
+			rightCost[bin] = rightCount ? surfaceArea(right) * rightCount : 0.0f;
+		}
+		AABB left = emptyBox();
+		uint32_t leftCount = 0;
+		uint32_t bestSplit = 0;
+		float bestCost = std::numeric_limits<float>::max();
+		for (uint32_t bin = 0; bin < SAH_BINS - 1; bin++) {
+			left = merge(left, binBounds[bin]);
+			leftCount += binCounts[bin];
+			float cost = (leftCount ? surfaceArea(left) * leftCount : 0.0f) + rightCost[bin + 1];
+			if (leftCount > 0 && leftCount < last - first && cost < bestCost) {
+				bestCost = cost;
+				bestSplit = bin;
+			}
+		}
+
+		if (bestCost < std::numeric_limits<float>::max()) {
+			mid = std::partition(order.begin() + first, order.begin() + last,
+			                     [&](uint32_t item) { return binOf(item) <= bestSplit; }) -
+			      order.begin();
+		}
+	}
+
+	// Children first, so every inner node comes after both of its children
+	uint32_t leftChild = buildRange(result, items, order, first, mid);
+	uint32_t rightChild = buildRange(result, items, order, mid, last);
+
+	Node node;
+	node.bounds = merge(result.nodes[leftChild].bounds, result.nodes[rightChild].bounds);
+	node.left = leftChild;
+	node.right = rightChild;
+	result.nodes.push_back(node);
+	uint32_t index = result.nodes.size() - 1;
+	result.nodes[leftChild].parent = index;
+	result.nodes[rightChild].parent = index;
+	return index;
+}
+
+void BVH::swapIn(Build&& result) {
+	PROFILE_FUNC();
+	m_nodes = std::move(result.nodes);
+	m_freeNodes.clear();
+	m_root = result.root;
+
+	// Items may have moved since the snapshot. Leaves come before their parents, so one pass in
+	// order refits the whole tree
+	std::vector<uint32_t> removed;
+	std::vector<bool> inBuild(m_items.size(), false);
+	for (uint32_t i = 0; i < m_nodes.size(); i++) {
+		Node& node = m_nodes[i];
+		if (node.item == NONE) {
+			node.bounds = merge(m_nodes[node.left].bounds, m_nodes[node.right].bounds);
+		} else if (m_items[node.item].alive) {
+			node.bounds = m_items[node.item].bounds;
+			m_items[node.item].leaf = i;
+			inBuild[node.item] = true;
+		} else {
+			removed.push_back(i);
+		}
+	}
+
+	// Patch in inserts and removes made during the build
+	for (uint32_t leaf : removed) {
+		removeLeaf(leaf);
+	}
+	for (uint32_t item = 0; item < m_items.size(); item++) {
+		if (m_items[item].alive && !inBuild[item]) {
+			uint32_t leaf = allocateNode();
+			m_nodes[leaf].bounds = m_items[item].bounds;
+			m_nodes[leaf].item = item;
+			m_items[item].leaf = leaf;
+			insertLeaf(leaf);
+		}
+	}
+
+	m_freeItems.insert(m_freeItems.end(), m_removedDuringBuild.begin(),
+	                   m_removedDuringBuild.end());
+	m_removedDuringBuild.clear();
+}
+
+uint32_t BVH::allocateNode() {
+	if (!m_freeNodes.empty()) {
+		uint32_t node = m_freeNodes.back();
+		m_freeNodes.pop_back();
+		return node;
+	}
+	m_nodes.emplace_back();
+	return m_nodes.size() - 1;
+}
+
+void BVH::freeNode(uint32_t node) {
+	m_nodes[node] = Node();
+	m_freeNodes.push_back(node);
+}
+
+void BVH::insertLeaf(uint32_t leaf) {
+	m_nodes[leaf].parent = NONE;
+	if (m_root == NONE) {
+		m_root = leaf;
+		return;
+	}
+
+	// Walk down towards the sibling which grows the total surface area the least (Catto's branch
+	// and bound, without rotations)
+	AABB bounds = m_nodes[leaf].bounds;
+	uint32_t sibling = m_root;
+	while (m_nodes[sibling].item == NONE) {
+		const Node& node = m_nodes[sibling];
+		float area = surfaceArea(node.bounds);
+		float combined = surfaceArea(merge(node.bounds, bounds));
+		// Cost of making a new parent for this node and the leaf, or of pushing it further down
+		float cost = 2.0f * combined;
+		float inheritance = 2.0f * (combined - area);
+
+		auto descendCost = [&](uint32_t child) {
+			const Node& c = m_nodes[child];
+			float grown = surfaceArea(merge(c.bounds, bounds));
+			return (c.item != NONE ? grown : grown - surfaceArea(c.bounds)) + inheritance;
+		};
+		float leftCost = descendCost(node.left);
+		float rightCost = descendCost(node.right);
+		if (cost < leftCost && cost < rightCost) {
+			break;
+		}
+		sibling = leftCost < rightCost ? node.left : node.right;
+	}
+
+	uint32_t oldParent = m_nodes[sibling].parent;
+	uint32_t newParent = allocateNode();
+	m_nodes[newParent].parent = oldParent;
+	m_nodes[newParent].left = sibling;
+	m_nodes[newParent].right = leaf;
+	m_nodes[sibling].parent = newParent;
+	m_nodes[leaf].parent = newParent;
+
+	if (oldParent == NONE) {
+		m_root = newParent;
+	} else if (m_nodes[oldParent].left == sibling) {
+		m_nodes[oldParent].left = newParent;
+	} else {
+		m_nodes[oldParent].right = newParent;
+	}
+	refitUpwards(newParent);
+}
+
+void BVH::removeLeaf(uint32_t leaf) {
+	if (leaf == m_root) {
+		m_root = NONE;
+		freeNode(leaf);
+		return;
+	}
+
+	// The leaf's sibling takes its parent's place
+	uint32_t parent = m_nodes[leaf].parent;
+	uint32_t grandparent = m_nodes[parent].parent;
+	uint32_t sibling = m_nodes[parent].left == leaf ? m_nodes[parent].right : m_nodes[parent].left;
+	m_nodes[sibling].parent = grandparent;
+	if (grandparent == NONE) {
+		m_root = sibling;
+	} else {
+		if (m_nodes[grandparent].left == parent) {
+			m_nodes[grandparent].left = sibling;
+		} else {
+			m_nodes[grandparent].right = sibling;
+		}
+		refitUpwards(grandparent);
+	}
+	freeNode(parent);
+	freeNode(leaf);
+}
+
+void BVH::refitUpwards(uint32_t node) {
+	while (node != NONE) {
+		Node& n = m_nodes[node];
+		n.bounds = merge(m_nodes[n.left].bounds, m_nodes[n.right].bounds);
+		node = n.parent;
+	}
+}
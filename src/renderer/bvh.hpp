@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "util/bounds.hpp"
+
+/* Nearest item hit by a ray */
+struct RayHit {
+	uint32_t userData;
+	/* Distance along the ray, in multiples of its direction */
+	float t;
+};
+
+/**
+ * @class BVH
+ * @brief Dynamic bounding volume hierarchy over world space boxes, for culling and picking
+ *
+ * Each item is a leaf of a binary tree of AABBs. Items can be inserted, moved, and removed at any
+ * time. Inserts and removes patch the tree in place, and moves only refit the boxes above the moved
+ * leaf. Both slowly make the tree worse, so once enough has changed, update() rebuilds the whole
+ * tree with binned SAH on a background thread, and swaps it in when it is done.
+ *
+ * Queries report the userData given to insert.
+ */
+class BVH {
+  public:
+	BVH() = default;
+	~BVH() = default;
+
+	BVH(const BVH&) = delete;
+
+	/**
+	 * @return A handle to the item, valid until it is removed
+	 */
+	uint32_t insert(const AABB& bounds, uint32_t userData);
+	void remove(uint32_t item);
+	/**
+	 * @brief Moves an item. The tree is refit on the next update()
+	 */
+	void setBounds(uint32_t item, const AABB& bounds);
+	/**
+	 * @brief Refits moved items, swaps in a finished background rebuild, and starts a new one if
+	 * the tree has changed too much since the last. Call once per frame, before querying.
+	 */
+	void update();
+	/**
+	 * @brief Rebuilds the whole tree with binned SAH, blocking until it is done
+	 */
+	void rebuild();
+
+	/**
+	 * @brief Appends every item whose box may be inside the frustum
+	 */
+	void queryFrustum(const Frustum& frustum, std::vector<uint32_t>& results) const;
+	/**
+	 * @brief Appends every item whose box touches the sphere
+	 */
+	void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& results) const;
+	/**
+	 * @brief Finds the nearest item along a ray
+	 *
+	 * @param maxT Ignore hits farther than this along the ray
+	 * @param exact Optional exact test for an item whose box was hit. Returns the distance to the
+	 * item itself, or nothing if the ray misses it. Without one, the distance to the box is used.
+	 */
+	std::optional<RayHit>
+	raycast(const glm::vec3& origin, const glm::vec3& dir,
+	        float maxT = std::numeric_limits<float>::infinity(),
+	        const std::function<std::optional<float>(uint32_t)>& exact = nullptr) const;
+
+	inline uint32_t size() const { return m_numItems; }
+	inline bool isRebuilding() const { return m_pendingBuild.valid(); }
+
+  private:
+	static const uint32_t NONE = UINT32_MAX;
+
+	struct Node {
+		AABB bounds;
+		uint32_t parent = NONE;
+		uint32_t left = NONE;
+		uint32_t right = NONE;
+		/* The item this leaf holds, or NONE for inner nodes */
+		uint32_t item = NONE;
+	};
+
+	struct Item {
+		AABB bounds;
+		uint32_t userData = 0;
+		/* Node holding this item in the current tree */
+		uint32_t leaf = NONE;
+		bool alive = false;
+	};
+
+	/* Tree built from a snapshot of the items, off the main thread */
+	struct Build {
+		std::vector<Node> nodes;
+		uint32_t root = NONE;
+	};
+
+	/**
+	 * @brief Builds a tree over every live item in the snapshot, with one item per leaf
+	 */
+	static Build build(std::vector<Item> items);
+	/**
+	 * @brief Recursively splits items [first, last) with binned SAH
+	 *
+	 * @return Index of the subtree's root node
+	 */
+	static uint32_t buildRange(Build& result, const std::vector<Item>& items,
+	                           std::vector<uint32_t>& order, uint32_t first, uint32_t last);
+	/**
+	 * @brief Replaces the tree with a finished build, patching in whatever changed meanwhile
+	 */
+	void swapIn(Build&& result);
+
+	uint32_t allocateNode();
+	void freeNode(uint32_t node);
+	void insertLeaf(uint32_t leaf);
+	void removeLeaf(uint32_t leaf);
+	/**
+	 * @brief Recomputes the bounds of the node and every one of its ancestors
+	 */
+	void refitUpwards(uint32_t node);
+
+  private:
+	std::vector<Node> m_nodes;
+	std::vector<uint32_t> m_freeNodes;
+	uint32_t m_root = NONE;
+
+	std::vector<Item> m_items;
+	std::vector<uint32_t> m_freeItems;
+	/* Items removed during a background build. Not reused until it is swapped in, since the new
+	 * tree may still refer to them */
+	std::vector<uint32_t> m_removedDuringBuild;
+	uint32_t m_numItems = 0;
+
+	/* Items moved since the last update */
+	std::vector<uint32_t> m_moved;
+	/* Inserts, removes, and moves since the last full build */
+	uint32_t m_changesSinceBuild = 0;
+
+	std::future<Build> m_pendingBuild;
+};
@@ -0,0 +1,148 @@
+#include "gpu_culler.hpp"
+
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "util/bounds.hpp"
+#include "util/profiler.hpp"
+
+// Threads per workgroup of cull.comp
+static const uint32_t CULL_GROUP_SIZE = 64;
+
+GpuCuller::GpuCuller(Ref<VulkanDevice> device, Ref<ObjectStorage> objectStorage)
+	: m_device(device), m_objectStorage(objectStorage),
+	  m_compact(device->getDrawIndexedIndirectCount() != nullptr) {
+	createBuffers();
+	createDescriptorSetLayout();
+	createDescriptorSets();
+
+	m_pipeline = CreateScopedRef<ComputePipeline>(
+		m_device, "cull", std::vector<VkDescriptorSetLayout> {m_layout}, sizeof(CullConstants));
+}
+
+GpuCuller::~GpuCuller() {
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		m_device->getDescriptorAllocator().free(m_descriptorSets[i]);
+		vkDestroyBuffer(m_device->getLogicalDevice(), m_commandBuffers[i], nullptr);
+		vkFreeMemory(m_device->getLogicalDevice(), m_commandBuffersMemory[i], nullptr);
+		vkDestroyBuffer(m_device->getLogicalDevice(), m_countBuffers[i], nullptr);
+		vkFreeMemory(m_device->getLogicalDevice(), m_countBuffersMemory[i], nullptr);
+	}
+
+	vkDestroyDescriptorSetLayout(m_device->getLogicalDevice(), m_layout, nullptr);
+}
+
+void GpuCuller::cull(CommandEncoder& encoder, const glm::mat4& viewProj, uint32_t currentFrame) {
+	PROFILE_FUNC();
+	uint32_t objectCount = m_objectStorage->getCount(currentFrame);
+	if (objectCount == 0) {
+		return;
+	}
+
+	CullConstants constants;
+	constants.planes = Frustum::fromViewProj(viewProj).planes;
+	constants.objectCount = objectCount;
+	constants.compact = m_compact;
+
+	// Every batch starts out with nothing visible
+	if (m_compact) {
+		encoder.fillBuffer(m_countBuffers[currentFrame], 0, objectCount * sizeof(uint32_t), 0);
+		encoder.memoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		                      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	}
+
+	m_pipeline->bind(encoder);
+	VkDescriptorSet set = m_descriptorSets[currentFrame].set;
+	m_pipeline->bindDescriptorSets(encoder, 1, &set);
+	m_pipeline->pushConstant(encoder, constants);
+	encoder.dispatch((objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+	encoder.memoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+	                      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+	                      VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+}
+
+void GpuCuller::draw(CommandEncoder& encoder, uint32_t firstObject, uint32_t objectCount,
+                     bool ordered, uint32_t currentFrame) {
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	VkDeviceSize offset = firstObject * stride;
+
+	if (m_compact && !ordered) {
+		encoder.drawIndexedIndirectCount(m_commandBuffers[currentFrame], offset,
+		                                 m_countBuffers[currentFrame],
+		                                 firstObject * sizeof(uint32_t), objectCount, stride);
+	} else {
+		encoder.drawIndexedIndirect(m_commandBuffers[currentFrame], offset, objectCount, stride);
+	}
+}
+
+void GpuCuller::createBuffers() {
+	uint32_t capacity = m_objectStorage->getCapacity();
+
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		// Only ever touched by the GPU
+		m_device->createBuffer(capacity * sizeof(VkDrawIndexedIndirectCommand),
+		                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+		                           VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_commandBuffers[i],
+		                       m_commandBuffersMemory[i]);
+		m_device->createBuffer(capacity * sizeof(uint32_t),
+		                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+		                           VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+		                           VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_countBuffers[i],
+		                       m_countBuffersMemory[i]);
+	}
+}
+
+void GpuCuller::createDescriptorSetLayout() {
+	// Objects, draw commands, draw counts
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings {};
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(m_device->getLogicalDevice(), &layoutInfo, nullptr,
+	                                &m_layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create culling descriptor set layout!");
+	}
+}
+
+void GpuCuller::createDescriptorSets() {
+	for (uint32_t frameIdx = 0; frameIdx < MAX_FRAMES_IN_FLIGHT; frameIdx++) {
+		m_descriptorSets[frameIdx] =
+			m_device->getDescriptorAllocator().allocate(m_layout, DESCRIPTOR_CLASS_GENERAL);
+
+		std::array<VkDescriptorBufferInfo, 3> bufferInfos {};
+		bufferInfos[0].buffer = m_objectStorage->getBuffer(frameIdx);
+		bufferInfos[1].buffer = m_commandBuffers[frameIdx];
+		bufferInfos[2].buffer = m_countBuffers[frameIdx];
+
+		std::array<VkWriteDescriptorSet, 3> writes {};
+		for (uint32_t i = 0; i < writes.size(); i++) {
+			bufferInfos[i].offset = 0;
+			bufferInfos[i].range = VK_WHOLE_SIZE;
+
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = m_descriptorSets[frameIdx].set;
+			writes[i].dstBinding = i;
+			writes[i].dstArrayElement = 0;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[i].descriptorCount = 1;
+			writes[i].pBufferInfo = &bufferInfos[i];
+		}
+
+		vkUpdateDescriptorSets(m_device->getLogicalDevice(), static_cast<uint32_t>(writes.size()),
+		                       writes.data(), 0, nullptr);
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vulkan/vulkan_core.h>
+
+#include "bootstrap/command_encoder.hpp"
+#include "bootstrap/compute_pipeline.hpp"
+#include "bootstrap/descriptor_allocator.hpp"
+#include "bootstrap/device.hpp"
+#include "bootstrap/object_storage.hpp"
+#include "util/constants.hpp"
+#include "util/gpu_layout.hpp"
+#include "util/memory.hpp"
+
+/* Push constant of cull.comp */
+struct CullConstants {
+	alignas(16) std::array<glm::vec4, 6> planes;
+	alignas(4) uint32_t objectCount;
+	alignas(4) uint32_t compact;
+};
+static_assert(offsetof(CullConstants, objectCount) == 96 &&
+              offsetof(CullConstants, compact) == 100);
+GPU_LAYOUT(CullConstants);
+
+/**
+ * @class GpuCuller
+ * @brief Frustum culls every object in the object storage with a compute shader, and draws the
+ * survivors with indirect draws
+ *
+ * Culling writes one VkDrawIndexedIndirectCommand per visible object, in the slots of its batch.
+ * When the device can read draw counts from a buffer, visible objects are packed at the start of
+ * their batch, and each batch is drawn with a single vkCmdDrawIndexedIndirectCount. Otherwise
+ * (or for batches marked OBJECT_BATCH_ORDERED_BIT), every slot keeps its command, culled objects
+ * drawing zero instances.
+ */
+class GpuCuller {
+  public:
+	GpuCuller(Ref<VulkanDevice> device, Ref<ObjectStorage> objectStorage);
+	~GpuCuller();
+
+	GpuCuller(const GpuCuller&) = delete;
+
+	/**
+	 * @brief Records culling of all objects stored for the current frame. Must be recorded outside
+	 * of a render pass, before any draw.
+	 *
+	 * @param viewProj The camera's view projection matrix, defining the frustum
+	 */
+	void cull(CommandEncoder& encoder, const glm::mat4& viewProj, uint32_t currentFrame);
+	/**
+	 * @brief Records the indirect draw of a batch of objects which were culled
+	 *
+	 * @param firstObject Slot of the batch's first object in the object storage
+	 * @param objectCount Number of objects in the batch
+	 * @param ordered Whether the batch was marked OBJECT_BATCH_ORDERED_BIT
+	 */
+	void draw(CommandEncoder& encoder, uint32_t firstObject, uint32_t objectCount, bool ordered,
+	          uint32_t currentFrame);
+
+  private:
+	void createBuffers();
+	void createDescriptorSetLayout();
+	void createDescriptorSets();
+
+  private:
+	Ref<VulkanDevice> m_device;
+	Ref<ObjectStorage> m_objectStorage;
+	/* Whether draw counts are read from m_countBuffers */
+	bool m_compact;
+
+	/* One draw command per object slot, written by culling */
+	Frames<VkBuffer> m_commandBuffers;
+	Frames<VkDeviceMemory> m_commandBuffersMemory;
+	/* Number of visible objects per batch, indexed by the batch's first slot */
+	Frames<VkBuffer> m_countBuffers;
+	Frames<VkDeviceMemory> m_countBuffersMemory;
+
+	VkDescriptorSetLayout m_layout;
+	/* Allocated from the device's DescriptorAllocator */
+	Frames<DescriptorAllocation> m_descriptorSets;
+
+	ScopedRef<ComputePipeline> m_pipeline;
+};
@@ -36,6 +36,6 @@ IndexBuffer::~IndexBuffer() {
 	vkFreeMemory(m_device->getLogicalDevice(), m_indexBufferMemory, nullptr);
 }
 
-void IndexBuffer::bind(VkCommandBuffer commandBuffer) {
-	vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+void IndexBuffer::bind(CommandEncoder& encoder) {
+	encoder.bindIndexBuffer(m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 }
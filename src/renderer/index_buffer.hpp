@@ -1,5 +1,6 @@
 #pragma once
 
+#include "bootstrap/command_encoder.hpp"
 #include "bootstrap/device.hpp"
 #include <vector>
 #include <vulkan/vulkan_core.h>
@@ -29,9 +30,9 @@ class IndexBuffer {
 	/**
 	 * @brief "Activates" this index buffer, causing its indices to be used for the next draw call
 	 *
-	 * @param commandBuffer The command buffer to record the binding to
+	 * @param encoder The encoder to record the binding to
 	 */
-	void bind(VkCommandBuffer commandBuffer);
+	void bind(CommandEncoder& encoder);
 
 	/**
 	 * @return Gets the number of indices in this index buffer
@@ -8,12 +8,16 @@
 #include "util/log.hpp"
 
 #include <tiny_obj_loader.h>
+#include <algorithm>
+#include <limits>
 #include <stdexcept>
 #include <unordered_map>
 
+std::atomic<uint32_t> Model::s_nextId = 0;
+
 Model::Model(Ref<VulkanDevice> device, const std::string& modelPath, Ref<Texture> tex,
-             Ref<Shader> shader)
-	: m_texture(tex), m_shader(shader) {
+             Ref<Shader> shader, Ref<Texture> normalMap)
+	: m_texture(tex), m_normalMap(normalMap), m_shader(shader), m_id(s_nextId++) {
 	// Load model data
 	tinyobj::attrib_t attrib;
 	std::vector<tinyobj::shape_t> shapes;
@@ -57,12 +61,27 @@ Model::Model(Ref<VulkanDevice> device, const std::string& modelPath, Ref<Texture
 		}
 	}
 
+	// Bound the vertices by a box, and a sphere around its center. Not the tightest sphere, but
+	// close enough for culling
+	glm::vec3 min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max());
+	for (const auto& vertex : vertices) {
+		min = glm::min(min, vertex.pos);
+		max = glm::max(max, vertex.pos);
+	}
+	m_localAABB = vertices.empty() ? AABB() : AABB {min, max};
+	glm::vec3 center = m_localAABB.center();
+	float radius = 0.0f;
+	for (const auto& vertex : vertices) {
+		radius = std::max(radius, glm::length(vertex.pos - center));
+	}
+	m_localBounds = glm::vec4(center, radius);
+
 	m_vertices =
 		CreateScopedRef<VertexBuffer>(device, vertices.data(), sizeof(Vertex), vertices.size());
 	m_indices = CreateScopedRef<IndexBuffer>(device, indices);
 }
 
-void Model::bind(VkCommandBuffer commandBuffer) {
-	m_vertices->bind(commandBuffer);
-	m_indices->bind(commandBuffer);
+void Model::bind(CommandEncoder& encoder) {
+	m_vertices->bind(encoder);
+	m_indices->bind(encoder);
 }
@@ -1,39 +1,70 @@
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <vulkan/vulkan_core.h>
 
+#include "bootstrap/command_encoder.hpp"
 #include "bootstrap/device.hpp"
+#include "renderer/render_state.hpp"
 #include "renderer/shader.hpp"
 #include "renderer/transform.hpp"
 #include "renderer/index_buffer.hpp"
 #include "renderer/texture.hpp"
 #include "renderer/vertex_buffer.hpp"
+#include "util/bounds.hpp"
 #include "util/memory.hpp"
 
 class Model {
   public:
 	// PERF: I should memos this, so I don't duplicate vertex data in CPU memory
 	Model(Ref<VulkanDevice> device, const std::string& modelPath, Ref<Texture> tex,
-	      Ref<Shader> shader);
+	      Ref<Shader> shader, Ref<Texture> normalMap = nullptr);
 	~Model() = default;
 
 	Model(const Model&) = delete;
 	Model& operator=(const Model&) = delete;
 
   public:
-	void bind(VkCommandBuffer commandBuffer);
+	void bind(CommandEncoder& encoder);
 	Ref<Texture> getTexture() { return m_texture; }
+	/**
+	 * @return The normal map of this model, or nullptr if the shader should use vertex normals
+	 */
+	Ref<Texture> getNormalMap() { return m_normalMap; }
 
 	inline uint32_t numIndices() { return m_indices->size(); }
 	inline Transform& getTransform() { return m_transform; }
 	inline const Ref<Shader> getShader() const { return m_shader; }
+	/**
+	 * @return A number unique to this model, used to group draws of the same mesh
+	 */
+	inline uint32_t getId() const { return m_id; }
+	inline const RenderState& getRenderState() const { return m_renderState; }
+	inline void setRenderState(const RenderState& renderState) { m_renderState = renderState; }
+	/**
+	 * @return Bounding sphere of the model's vertices in model space: xyz center, w radius
+	 */
+	inline const glm::vec4& getLocalBounds() const { return m_localBounds; }
+	/**
+	 * @return Bounding box of the model's vertices in model space
+	 */
+	inline const AABB& getLocalAABB() const { return m_localAABB; }
 
   private:
 	ScopedRef<VertexBuffer> m_vertices;
 	ScopedRef<IndexBuffer> m_indices;
 	Ref<Texture> m_texture;
+	Ref<Texture> m_normalMap;
 	Ref<Shader> m_shader;
+	/* Cull, depth, and blend state for this model. Opaque unless set otherwise */
+	RenderState m_renderState;
+	/* Bounding sphere of the vertex data, before the transform is applied */
+	glm::vec4 m_localBounds;
+	AABB m_localAABB;
 
 	Transform m_transform;
+
+	const uint32_t m_id;
+	static std::atomic<uint32_t> s_nextId;
 };
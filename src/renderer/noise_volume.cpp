@@ -0,0 +1,150 @@
+#include "noise_volume.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "renderer/texture_lib.hpp"
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+#include "util/thread_pool.hpp"
+
+// Lattice points are hashed through a table this long, so no octave may have more cells
+static const uint32_t HASH_SIZE = 256;
+// Red: gradient noise, green: value noise
+static const uint32_t CHANNELS = 2;
+// Edge directions of a cube, the gradients of improved Perlin noise. Picking from a fixed set
+// rather than random directions avoids clumping, and needs no normalization
+static const std::array<glm::vec3, 12> GRADIENTS = {{
+	{1, 1, 0},
+	{-1, 1, 0},
+	{1, -1, 0},
+	{-1, -1, 0},
+	{1, 0, 1},
+	{-1, 0, 1},
+	{1, 0, -1},
+	{-1, 0, -1},
+	{0, 1, 1},
+	{0, -1, 1},
+	{0, 1, -1},
+	{0, -1, -1},
+}};
+// Added to lattice coordinates before hashing, so the two channels and each octave differ
+static const uint32_t VALUE_NOISE_SEED = 101;
+static const uint32_t OCTAVE_SEED = 37;
+
+/**
+ * @brief Shuffles every byte into a table, with a fixed seed so the volume is the same every run
+ */
+static std::array<uint8_t, HASH_SIZE> makeHashTable() {
+	std::array<uint8_t, HASH_SIZE> table;
+	std::iota(table.begin(), table.end(), 0);
+	std::shuffle(table.begin(), table.end(), std::mt19937(0));
+	return table;
+}
+
+static const std::array<uint8_t, HASH_SIZE> HASH = makeHashTable();
+
+/**
+ * @brief Hashes a lattice point, already wrapped to the lattice of its octave
+ */
+static inline uint8_t hashPoint(const glm::uvec3& point, uint32_t seed) {
+	return HASH[(HASH[(HASH[(point.x + seed) % HASH_SIZE] + point.y) % HASH_SIZE] + point.z) %
+	            HASH_SIZE];
+}
+
+// Smoothest interpolation of Perlin noise, with zero first and second derivatives at each end
+static inline glm::vec3 quinticFade(const glm::vec3& t) {
+	return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+// Interpolation of value noise, matching the smoothstep the clouds' vertex noise used
+static inline glm::vec3 cubicFade(const glm::vec3& t) { return t * t * (3.0f - 2.0f * t); }
+
+static inline float trilinear(const std::array<float, 8>& corners, const glm::vec3& t) {
+	float x00 = glm::mix(corners[0], corners[1], t.x);
+	float x10 = glm::mix(corners[2], corners[3], t.x);
+	float x01 = glm::mix(corners[4], corners[5], t.x);
+	float x11 = glm::mix(corners[6], corners[7], t.x);
+	return glm::mix(glm::mix(x00, x10, t.y), glm::mix(x01, x11, t.y), t.z);
+}
+
+/**
+ * @brief Evaluates one octave of both noises at a point of a lattice which wraps every period
+ * cells
+ *
+ * @return Gradient noise, in roughly [-1, 1], then value noise, in [0, 1]
+ */
+static glm::vec2 latticeNoise(const glm::vec3& p, uint32_t period, uint32_t seed) {
+	glm::vec3 cell = glm::floor(p);
+	glm::vec3 f = p - cell;
+	glm::uvec3 i0 = glm::uvec3(cell) % period;
+	glm::uvec3 i1 = (i0 + 1u) % period;
+
+	std::array<float, 8> gradients, values;
+	for (uint32_t corner = 0; corner < 8; corner++) {
+		glm::uvec3 offset = {corner & 1, (corner >> 1) & 1, (corner >> 2) & 1};
+		glm::uvec3 point = {offset.x ? i1.x : i0.x, offset.y ? i1.y : i0.y,
+		                    offset.z ? i1.z : i0.z};
+		const glm::vec3& gradient = GRADIENTS[hashPoint(point, seed) % GRADIENTS.size()];
+		gradients[corner] = glm::dot(gradient, f - glm::vec3(offset));
+		values[corner] = hashPoint(point, seed + VALUE_NOISE_SEED) / float(HASH_SIZE - 1);
+	}
+
+	return {trilinear(gradients, quinticFade(f)), trilinear(values, cubicFade(f))};
+}
+
+NoiseVolume::NoiseVolume(Ref<VulkanDevice> device, const NoiseVolumeSettings& settings,
+                         uint32_t numThreads)
+	: m_settings(settings) {
+	PROFILE_FUNC();
+	if (m_settings.size == 0 || m_settings.cells == 0 || m_settings.octaves == 0 ||
+	    (m_settings.cells << (m_settings.octaves - 1)) > HASH_SIZE) {
+		throw std::runtime_error("failed to bake noise volume, unsupported settings!");
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	uint32_t size = m_settings.size;
+	std::vector<uint8_t> texels(size_t(CHANNELS) * size * size * size);
+	ThreadPool pool(numThreads > 0 ? numThreads
+	                               : std::max(std::thread::hardware_concurrency(), 1u));
+	pool.parallelFor(size, [&](uint32_t z, uint32_t) {
+		for (uint32_t y = 0; y < size; y++) {
+			for (uint32_t x = 0; x < size; x++) {
+				// At texel centers, so filtering between texels matches the noise between them
+				glm::vec3 uvw = (glm::vec3(x, y, z) + 0.5f) / float(size);
+				glm::vec2 noise(0.0f);
+				float amplitude = 1.0f, totalAmplitude = 0.0f;
+				for (uint32_t octave = 0; octave < m_settings.octaves; octave++) {
+					uint32_t period = m_settings.cells << octave;
+					noise += amplitude * latticeNoise(uvw * float(period), period,
+					                                  octave * OCTAVE_SEED);
+					totalAmplitude += amplitude;
+					amplitude *= 0.5f;
+				}
+				noise /= totalAmplitude;
+
+				glm::vec2 unorm =
+					glm::clamp(glm::vec2(0.5f * noise.x + 0.5f, noise.y), 0.0f, 1.0f);
+				size_t texel = CHANNELS * ((size_t(z) * size + y) * size + x);
+				texels[texel] = static_cast<uint8_t>(std::lround(unorm.x * 255.0f));
+				texels[texel + 1] = static_cast<uint8_t>(std::lround(unorm.y * 255.0f));
+			}
+		}
+	});
+
+	m_texture = CreateRef<Texture>(device, glm::uvec3(size), VK_FORMAT_R8G8_UNORM, texels.data(),
+	                               texels.size());
+	TextureLibrary::get()->registerTexture(m_texture);
+
+	float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start)
+	               .count();
+	LOG_INFO("Baked {0}^3 noise volume ({1} cells, {2} octaves) on {3} threads in {4:.1f} ms",
+	         size, m_settings.cells, m_settings.octaves, pool.size(), ms);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+#include "bootstrap/device.hpp"
+#include "renderer/texture.hpp"
+#include "util/memory.hpp"
+
+/* Shape of the noise baked into a NoiseVolume */
+struct NoiseVolumeSettings {
+	/* Texels along each side of the volume */
+	uint32_t size = 128;
+	/* Lattice cells along each side of the volume, in the first octave. Clouds sample a cell per
+	 * CloudSettings::noiseFreq world units, so at the default 16 one repeat spans 160 units, more
+	 * than a cloud is across */
+	uint32_t cells = 16;
+	/* Octaves summed, each with twice the cells and half the amplitude of the one before. 1 for
+	 * plain noise */
+	uint32_t octaves = 1;
+};
+
+/**
+ * @class NoiseVolume
+ * @brief A tiling volume of noise, baked once so shaders can take a filtered fetch instead of
+ * evaluating noise per vertex or fragment
+ *
+ * The red channel holds gradient (Perlin) noise, remapped from [-1, 1] to [0, 1]. The green
+ * channel holds value noise, smoothly interpolated between random values at each lattice point.
+ * Lattice points wrap at the edges of the volume, so it tiles seamlessly with a repeating
+ * sampler. Shaders sample it at a position in lattice cells divided by getPeriod().
+ *
+ * Texels are generated on a thread pool, a slice at a time, and uploaded as 8 bit channels, which
+ * every device can filter trilinearly. The texture is registered with the TextureLibrary, so it
+ * is sampled through the bindless texture table.
+ */
+class NoiseVolume {
+  public:
+	/**
+	 * @param numThreads Threads slices are spread across, or 0 for one per core
+	 */
+	NoiseVolume(Ref<VulkanDevice> device, const NoiseVolumeSettings& settings = {},
+	            uint32_t numThreads = 0);
+
+	NoiseVolume(const NoiseVolume&) = delete;
+
+	inline const Ref<Texture>& getTexture() const { return m_texture; }
+	inline uint32_t getIndex() const { return m_texture->getIndex(); }
+	/**
+	 * @brief Gets the lattice cells one repeat of the volume spans, in the first octave
+	 */
+	inline float getPeriod() const { return static_cast<float>(m_settings.cells); }
+
+  private:
+	NoiseVolumeSettings m_settings;
+	Ref<Texture> m_texture;
+};
@@ -0,0 +1,62 @@
+#include "quality_governor.hpp"
+
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+
+// Weight of the newest frame in the smoothed time. Timestamps of single frames are noisy
+static const float SMOOTHING = 0.1f;
+// Over budget this many frames in a row steps quality down. Kept short, dropped frames show
+static const uint32_t FRAMES_TO_STEP_DOWN = 20;
+// Under the headroom this many frames in a row steps quality up. Kept long, so a brief lull
+// doesn't undo a step down
+static const uint32_t FRAMES_TO_STEP_UP = 180;
+// Share of the budget the sky must stay under before stepping up. The next level up costs
+// roughly twice as much, so it has to fit in what is left
+static const float STEP_UP_HEADROOM = 0.45f;
+// Frames ignored after a change. Timings lag a couple of frames behind, and new settings bake
+// every table again in the frame they are applied
+static const uint32_t COOLDOWN_FRAMES = 30;
+
+QualityGovernor::QualityGovernor(float budget) : m_budget(budget), m_level(1) {}
+
+const std::vector<SkyQualityLevel>& QualityGovernor::getLevels() {
+	static const std::vector<SkyQualityLevel> levels = {
+		{"Ultra", 32, 64, 1, 1}, {"High", 16, 32, 1, 1}, {"Medium", 16, 32, 2, 1},
+		{"Low", 10, 16, 2, 2},   {"Lowest", 6, 8, 4, 2},
+	};
+	return levels;
+}
+
+bool QualityGovernor::update(float skyTime) {
+	m_smoothedTime += (skyTime - m_smoothedTime) * SMOOTHING;
+	if (m_cooldown > 0) {
+		m_cooldown--;
+		return false;
+	}
+
+	m_framesOver = m_smoothedTime > m_budget ? m_framesOver + 1 : 0;
+	m_framesUnder = m_smoothedTime < m_budget * STEP_UP_HEADROOM ? m_framesUnder + 1 : 0;
+
+	uint32_t level = m_level;
+	if (m_framesOver >= FRAMES_TO_STEP_DOWN && m_level + 1 < getLevels().size()) {
+		level = m_level + 1;
+	} else if (m_framesUnder >= FRAMES_TO_STEP_UP && m_level > 0) {
+		level = m_level - 1;
+	}
+	if (level == m_level) {
+		return false;
+	}
+
+	const SkyQualityLevel& next = getLevels()[level];
+	LOG_INFO("Sky quality {0} -> {1} ({2:.2f} ms of {3:.2f} ms budget): {4} in-scatter points, "
+	         "{5} optical depth points, 1/{6} sky resolution, 1/{7} sky-view LUT",
+	         getLevel().name, next.name, m_smoothedTime, m_budget, next.inScatteringPoints,
+	         next.opticalDepthPoints, next.skyScale, next.skyViewDivisor);
+	PROFILE_COUNTER("Sky quality level", level);
+
+	m_level = level;
+	m_framesOver = 0;
+	m_framesUnder = 0;
+	m_cooldown = COOLDOWN_FRAMES;
+	return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/* Settings the sky is rendered with at one step of the quality ladder */
+struct SkyQualityLevel {
+	const char* name;
+	/* Samples marched for each texel of the sky-view LUT */
+	uint32_t inScatteringPoints;
+	/* Samples integrated for each texel of the optical depth LUT */
+	uint32_t opticalDepthPoints;
+	/* Screen pixels along each side of a texel of the sky, see SkyRenderer::setLowResScale */
+	uint32_t skyScale;
+	/* Fraction of full resolution the sky-view LUT is baked at, see
+	 * SkyRenderer::setSkyViewDivisor */
+	uint32_t skyViewDivisor;
+};
+
+/**
+ * @class QualityGovernor
+ * @brief Picks the quality the sky is rendered at, so that it stays within a GPU time budget
+ *
+ * Fed the GPU time of the sky each frame, it steps down the ladder of levels after the time has
+ * stayed over budget for a while, and back up after it has stayed well under. The gap between
+ * the two thresholds, the delays and a cooldown after each change keep it from flickering
+ * between levels, i.e. while one frame's bake spikes.
+ */
+class QualityGovernor {
+  public:
+	/**
+	 * @param budget GPU time the sky may take each frame, in milliseconds
+	 */
+	QualityGovernor(float budget);
+
+	/**
+	 * @brief Takes the GPU time the sky took in a frame
+	 *
+	 * @return Whether the level changed, and so has to be applied
+	 */
+	bool update(float skyTime);
+
+	inline void setBudget(float budget) { m_budget = budget; }
+	inline float getBudget() const { return m_budget; }
+	inline uint32_t getLevelIndex() const { return m_level; }
+	inline const SkyQualityLevel& getLevel() const { return getLevels()[m_level]; }
+	/**
+	 * @brief Gets the smoothed GPU time decisions are made on, in milliseconds
+	 */
+	inline float getSmoothedTime() const { return m_smoothedTime; }
+
+	/**
+	 * @brief Gets every level, from highest quality to lowest
+	 */
+	static const std::vector<SkyQualityLevel>& getLevels();
+
+  private:
+	float m_budget;
+	/* Index into getLevels() */
+	uint32_t m_level;
+	float m_smoothedTime = 0.0f;
+	/* Frames in a row the smoothed time has been over budget, or far enough under it */
+	uint32_t m_framesOver = 0;
+	uint32_t m_framesUnder = 0;
+	/* Frames left before another change is considered */
+	uint32_t m_cooldown = 0;
+};
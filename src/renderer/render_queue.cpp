@@ -0,0 +1,78 @@
+#include "render_queue.hpp"
+
+#include <array>
+#include <cstring>
+
+#include "util/profiler.hpp"
+
+// Width of each field of a sort key, from the most to the least significant
+static const uint32_t PASS_BITS = 2;
+static const uint32_t PIPELINE_BITS = 10;
+static const uint32_t TEXTURE_BITS = 16;
+static const uint32_t MESH_BITS = 12;
+static const uint32_t DEPTH_BITS = 24;
+static_assert(PASS_BITS + PIPELINE_BITS + TEXTURE_BITS + MESH_BITS + DEPTH_BITS == 64);
+
+static inline uint64_t field(uint32_t value, uint32_t bits) {
+	return value & ((1ull << bits) - 1);
+}
+
+uint64_t RenderQueue::makeKey(RenderPass pass, uint32_t pipelineIdx, uint32_t textureIdx,
+                              uint32_t meshId, float depth) {
+	// Non negative floats compare the same as their bit patterns, so the top bits of the float
+	// are a depth with coarser precision but the same order
+	uint32_t depthBits;
+	memcpy(&depthBits, &depth, sizeof(depthBits));
+	depthBits >>= 32 - DEPTH_BITS;
+
+	uint64_t key = field(pass, PASS_BITS) << (64 - PASS_BITS);
+	if (pass == RENDER_PASS_TRANSPARENT) {
+		// Back to front: farther objects get smaller keys
+		uint64_t invDepth = field(~depthBits, DEPTH_BITS);
+		key |= invDepth << (64 - PASS_BITS - DEPTH_BITS);
+		key |= field(pipelineIdx, PIPELINE_BITS) << (TEXTURE_BITS + MESH_BITS);
+		key |= field(textureIdx, TEXTURE_BITS) << MESH_BITS;
+		key |= field(meshId, MESH_BITS);
+	} else {
+		key |= field(pipelineIdx, PIPELINE_BITS) << (TEXTURE_BITS + MESH_BITS + DEPTH_BITS);
+		key |= field(textureIdx, TEXTURE_BITS) << (MESH_BITS + DEPTH_BITS);
+		key |= field(meshId, MESH_BITS) << DEPTH_BITS;
+		key |= field(depthBits, DEPTH_BITS);
+	}
+
+	return key;
+}
+
+void RenderQueue::sort() {
+	PROFILE_FUNC();
+	if (m_packets.size() < 2) {
+		return;
+	}
+	m_scratch.resize(m_packets.size());
+
+	// One counting sort pass per byte, least significant first. Each pass is stable, so the
+	// order of earlier passes is kept between equal bytes
+	for (uint32_t shift = 0; shift < 64; shift += 8) {
+		std::array<uint32_t, 256> counts {};
+		for (const auto& packet : m_packets) {
+			counts[(packet.key >> shift) & 0xFF]++;
+		}
+
+		// All keys share this byte, nothing would move
+		if (counts[(m_packets[0].key >> shift) & 0xFF] == m_packets.size()) {
+			continue;
+		}
+
+		uint32_t offset = 0;
+		for (auto& count : counts) {
+			uint32_t num = count;
+			count = offset;
+			offset += num;
+		}
+
+		for (const auto& packet : m_packets) {
+			m_scratch[counts[(packet.key >> shift) & 0xFF]++] = packet;
+		}
+		m_packets.swap(m_scratch);
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class Model;
+
+/* Render passes in the order they are drawn in. Stored in the top bits of each sort key */
+enum RenderPass : uint8_t {
+	RENDER_PASS_OPAQUE = 0,
+	RENDER_PASS_TRANSPARENT = 1,
+};
+
+/* Everything needed to record one draw, captured when the draw is submitted */
+struct DrawPacket {
+	uint64_t key;
+	/* Index of the pipeline in the renderer's pipeline list */
+	uint32_t pipelineIdx;
+	/* Slot of the first instance's data in the object storage. Instances use consecutive slots */
+	uint32_t objectIdx;
+	uint32_t instanceCount;
+	Model* model;
+};
+
+/**
+ * @class RenderQueue
+ * @brief Collects the draws of a frame, so they can be recorded in an order which minimizes state
+ * changes
+ *
+ * Each packet carries a 64 bit key, and packets are recorded in ascending key order. Opaque keys
+ * are ordered pipeline > texture > mesh > depth, so draws sharing state end up next to each other,
+ * and are drawn front to back within a group to make use of early depth testing. Transparent keys
+ * put depth (inverted) right after the pass, since blending is only correct back to front.
+ */
+class RenderQueue {
+  public:
+	RenderQueue() = default;
+	~RenderQueue() = default;
+
+	RenderQueue(const RenderQueue&) = delete;
+
+	/**
+	 * @brief Builds the sort key of a draw
+	 *
+	 * @param pass The pass the draw belongs to
+	 * @param pipelineIdx The pipeline the draw uses. Only the low 10 bits are kept
+	 * @param textureIdx The bindless index of the draw's albedo texture. Low 16 bits are kept
+	 * @param meshId The id of the drawn model. Low 12 bits are kept
+	 * @param depth Distance from the camera to the object. Must not be negative
+	 */
+	static uint64_t makeKey(RenderPass pass, uint32_t pipelineIdx, uint32_t textureIdx,
+	                        uint32_t meshId, float depth);
+
+	inline void submit(const DrawPacket& packet) { m_packets.push_back(packet); }
+	/**
+	 * @brief Sorts the submitted packets by key, using an LSD radix sort
+	 */
+	void sort();
+	inline void clear() { m_packets.clear(); }
+
+	inline const std::vector<DrawPacket>& getPackets() const { return m_packets; }
+
+  private:
+	std::vector<DrawPacket> m_packets;
+	/* Scratch space for sorting, kept around to avoid allocating every frame */
+	std::vector<DrawPacket> m_scratch;
+};
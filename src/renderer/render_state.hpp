@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+/**
+ * @struct RenderState
+ * @brief Fixed function state set per draw with extended dynamic state
+ *
+ * None of this is baked into pipelines, so models differing only in these states share a
+ * pipeline.
+ */
+struct RenderState {
+	VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+	VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+	bool depthTest = true;
+	bool depthWrite = true;
+	VkCompareOp depthCompare = VK_COMPARE_OP_LESS_OR_EQUAL;
+	/* Ignored (always on) if the device can't set blend enable dynamically */
+	bool blend = false;
+
+	bool operator==(const RenderState& other) const {
+		return cullMode == other.cullMode && frontFace == other.frontFace &&
+		       depthTest == other.depthTest && depthWrite == other.depthWrite &&
+		       depthCompare == other.depthCompare && blend == other.blend;
+	}
+	bool operator!=(const RenderState& other) const { return !(*this == other); }
+
+	static RenderState opaque() { return {}; }
+
+	/* Alpha blended geometry. Still writes depth, since the sky is drawn behind everything
+	 * in the postprocessing pass and would otherwise cover it */
+	static RenderState transparent() {
+		RenderState state;
+		state.blend = true;
+		return state;
+	}
+
+	/* Fullscreen passes which only fill in pixels no geometry was drawn to */
+	static RenderState background() {
+		RenderState state;
+		state.depthWrite = false;
+		return state;
+	}
+};
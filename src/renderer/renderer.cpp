@@ -1,5 +1,7 @@
 #include "renderer.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <glm/fwd.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -9,6 +11,8 @@
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_vulkan.h>
 #include <iterator>
+#include <stdexcept>
+#include <thread>
 #include <vulkan/vulkan_core.h>
 
 #include "bootstrap/pipeline.hpp"
@@ -27,31 +31,54 @@ static void check_vk_result(VkResult err) {
 		abort();
 }
 
+// Draws in a frame before recording is split across threads. Below this, handing out the work
+// costs more than it saves
+static const uint32_t PARALLEL_RECORD_MIN_DRAWS = 512;
+// Most threads to record on. Past this, the primary buffer and submission dominate anyway
+static const uint32_t MAX_RECORD_THREADS = 8;
+
 VulkanRenderer::VulkanRenderer(Ref<VulkanInstance> instance, Ref<VulkanDevice> device,
                                Ref<GLFWWindow> window)
 	: m_swapChain(CreateRef<VulkanSwapChain>(instance, device, window)), m_device(device),
-	  m_pipelineBuilder(device, m_swapChain),
+	  m_textureTable(CreateRef<BindlessTextureTable>(device)),
+	  m_uniformStorage(CreateRef<UniformStorage>(device)),
+	  m_objectStorage(CreateRef<ObjectStorage>(device)),
+	  m_gpuProfiler(CreateRef<GpuProfiler>(device)),
+	  m_pipelineBuilder(device, m_swapChain, m_textureTable, m_uniformStorage, m_objectStorage),
 	  m_defaultVA({{VertexAtrributeType::VERTEX_ATTRIB_TYPE_F32, 3}, // pos
                    {VertexAtrributeType::VERTEX_ATTRIB_TYPE_F32, 3}, // normal
                    {VertexAtrributeType::VERTEX_ATTRIB_TYPE_F32, 3}, // color
                    {VertexAtrributeType::VERTEX_ATTRIB_TYPE_F32, 2}} // uv
                   ),
-	  m_textures({
-		  TextureLibrary::get()->getTexture(m_device, "res/texture/mountain.png"),
-		  TextureLibrary::get()->getTexture(m_device, "res/texture/viking_room.png"),
-		  TextureLibrary::get()->getTexture(m_device, "res/texture/default.png"),
-		  TextureLibrary::get()->getTexture(m_device, "res/skybox/skybox.png"),
-	  }) {
+	  m_encoder(device) {
+	// The main thread only waits while the workers record, so it needs no core of its own
+	uint32_t numRecordThreads =
+		std::clamp(std::thread::hardware_concurrency(), 1u, MAX_RECORD_THREADS);
+	m_recordPool = CreateScopedRef<ThreadPool>(numRecordThreads);
+	// One more set of pools for the main thread, which records the UI
+	m_threadCommandPools = CreateScopedRef<ThreadCommandPools>(m_device, numRecordThreads + 1);
+	m_staticCommands = CreateScopedRef<StaticCommandCache>(m_device);
+	for (uint32_t i = 0; i < numRecordThreads; i++) {
+		m_workerEncoders.push_back(CreateScopedRef<CommandEncoder>(m_device));
+	}
+	LOG_INFO("Recording draws on up to {0} threads", numRecordThreads);
+
+	if (m_device->supportsMultiDrawIndirect()) {
+		m_culler = CreateScopedRef<GpuCuller>(m_device, m_objectStorage);
+	} else {
+		LOG_WARN("Multi draw indirect is unsupported, objects will be culled on the CPU");
+	}
+
 	auto shader = ShaderLibrary::get()->getShader(m_device, "model");
-	m_pipelines.push_back(m_pipelineBuilder.buildPipeline(m_defaultVA, shader, m_textures));
-	m_activePipeline = m_pipelines[0];
+	m_pipelines.push_back(m_pipelineBuilder.buildPipeline(m_defaultVA, shader));
 
 	// Setup postprocessing
 	m_postprocessPipeline = m_pipelineBuilder.buildPipeline(
-		VertexArray(), ShaderLibrary::get()->getShader(m_device, "atmosphere"),
-		{TextureLibrary::get()->getTexture(m_device, "res/texture/default.png")}, true);
-	m_postprocessPipeline->bindTexture(
-		TextureLibrary::get()->getTexture(m_device, "res/texture/default.png"));
+		VertexArray(), ShaderLibrary::get()->getShader(m_device, "atmosphere"), true);
+	m_sky = CreateScopedRef<SkyRenderer>(m_device, m_textureTable, m_gpuProfiler);
+	m_atmosphereUniform = m_uniformStorage->getHandle<Atmosphere>("atmos");
+	m_lightUniform = m_uniformStorage->getHandle<LightSource>("light");
+	m_skyLUTsUniform = m_uniformStorage->getHandle<SkyLUTs>("skyLUTs");
 
 	// Setup ImGui
 	IMGUI_CHECKVERSION();
@@ -74,17 +101,24 @@ VulkanRenderer::VulkanRenderer(Ref<VulkanInstance> instance, Ref<VulkanDevice> d
 	init_info.QueueFamily = m_device->getQueueFamilyIndices().graphicsFamily.value();
 	init_info.Queue = m_device->getGraphicsQueue();
 	init_info.PipelineCache = VK_NULL_HANDLE;
-	init_info.DescriptorPool = m_postprocessPipeline->getDescriptorPool();
+	// ImGui manages its own sets (just the font atlas), so give it a small pool of its own
+	init_info.DescriptorPool = m_device->getDescriptorAllocator().createDedicatedPool(
+		{{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1}}, 1,
+		VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT);
 	init_info.Subpass = 0;
 	init_info.MinImageCount = 2; // Just choosing the minimum here for simplicity
 	init_info.ImageCount = 2;
 	init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
 	init_info.Allocator = nullptr; // Use default allocation mechanism
 	init_info.CheckVkResultFn = check_vk_result;
-	ImGui_ImplVulkan_Init(&init_info, m_swapChain->getPostProcessRenderPass());
+	ImGui_ImplVulkan_Init(&init_info, m_swapChain->getUIRenderPass());
 }
 
 VulkanRenderer::~VulkanRenderer() {
+	if (m_captureBuffer != VK_NULL_HANDLE) {
+		vkDestroyBuffer(m_device->getLogicalDevice(), m_captureBuffer, nullptr);
+		vkFreeMemory(m_device->getLogicalDevice(), m_captureBufferMemory, nullptr);
+	}
 	ImGui_ImplVulkan_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
@@ -92,6 +126,9 @@ VulkanRenderer::~VulkanRenderer() {
 
 void VulkanRenderer::beginScene() {
 	PROFILE_FUNC();
+	m_renderQueue.clear();
+	m_frameCullStats = {};
+	m_frameCullStats.onGpu = m_gpuCulling && m_culler;
 
 	// Get image from swap chain
 	auto imageIndexOpt = m_swapChain->aquireNextFrame(m_currentFrame);
@@ -101,12 +138,20 @@ void VulkanRenderer::beginScene() {
 	}
 	m_imageIndex = imageIndexOpt.value();
 
+	// This frame's fence has signalled, so its object slots and command buffers are free again
+	m_objectStorage->resetFrame(m_currentFrame);
+	m_threadCommandPools->resetFrame(m_currentFrame);
+	m_secondaryStats = {};
+
+	// Make textures loaded since last frame visible to shaders
+	m_textureTable->sync();
+
 	// Prepare to record draw commands
 	m_commandBuffer = m_device->getFrameCommandBuffer(m_currentFrame);
 
 	// Start recording
-	// PERF: This seems like I could record most of the commands once, leave small parts separate
-	// (i.e. uploading push constants), and reduce the time spent recording every frame
+	// Static passes are recorded once and resubmitted (see StaticCommandCache). Only the
+	// geometry pass and UI are recorded every frame
 	VkCommandBufferBeginInfo beginInfo {};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	beginInfo.flags = 0;                  // Optional
@@ -115,8 +160,216 @@ void VulkanRenderer::beginScene() {
 	if (vkBeginCommandBuffer(m_commandBuffer, &beginInfo) != VK_SUCCESS) {
 		throw std::runtime_error("failed to begin recording command buffer!");
 	}
+	m_encoder.begin(m_commandBuffer);
+	m_gpuProfiler->beginFrame(m_encoder, m_currentFrame);
+
+	// Timings of an earlier frame were just read back. The analytic sky has no settings to govern,
+	// and its timings would make the integrated sky look far cheaper than it is
+	if (m_governSkyQuality && m_sky->getModel() == SKY_MODEL_INTEGRATED &&
+	    m_qualityGovernor.update(getSkyGpuTime())) {
+		applySkyQuality(m_qualityGovernor.getLevel());
+	}
+}
+
+void VulkanRenderer::draw(Model& model) { submit(model, &model.getTransform(), 1); }
+
+void VulkanRenderer::drawInstanced(Model& model, std::vector<Transform>& instances) {
+	if (!instances.empty()) {
+		submit(model, instances.data(), static_cast<uint32_t>(instances.size()));
+	}
+}
+
+void VulkanRenderer::submit(Model& model, Transform* instances, uint32_t instanceCount) {
+	PROFILE_FUNC();
+	std::optional<uint32_t> pipelineIdx = findOrBuildPipeline(model);
+	if (!pipelineIdx.has_value()) {
+		// Pipeline is still compiling, the model will show up once it is ready
+		return;
+	}
+
+	const glm::vec4& localBounds = model.getLocalBounds();
+	bool transparent = model.getRenderState().blend;
+	// Only transparent batches are drawn in slot order on the GPU. An opaque batch culled there
+	// sorts by its first instance alone, so the depth of every instance isn't needed
+	bool instanceDepths = transparent || !m_frameCullStats.onGpu;
+
+	m_instanceOrder.resize(instanceCount);
+	m_instanceDepths.resize(instanceCount);
+	m_instanceTRS.resize(instanceCount);
+	for (auto* component : {&m_sphereX, &m_sphereY, &m_sphereZ, &m_sphereRadius}) {
+		component->resize(instanceCount);
+	}
+	for (uint32_t i = 0; i < instanceCount; i++) {
+		m_instanceTRS[i] = instances[i].getTRS();
+		glm::vec3 center = glm::vec3(m_instanceTRS[i] * glm::vec4(glm::vec3(localBounds), 1.0f));
+		glm::vec3 scale = glm::abs(instances[i].getScale());
+		m_sphereX[i] = center.x;
+		m_sphereY[i] = center.y;
+		m_sphereZ[i] = center.z;
+		m_sphereRadius[i] = localBounds.w * std::max({scale.x, scale.y, scale.z});
+		m_instanceOrder[i] = i;
+		if (instanceDepths || i == 0) {
+			m_instanceDepths[i] = glm::distance(m_viewPos, center);
+		}
+	}
 
-	// Start render pass
+	// Without GPU culling, instances outside the frustum are dropped here, before they take up an
+	// object slot
+	if (!m_frameCullStats.onGpu) {
+		m_instanceVisible.resize(instanceCount);
+		SphereBatch spheres {m_sphereX.data(), m_sphereY.data(), m_sphereZ.data(),
+		                     m_sphereRadius.data(), instanceCount};
+		uint32_t numVisible = simd::cullSpheres(m_frustum, spheres, m_instanceVisible.data());
+		m_frameCullStats.visible += numVisible;
+		m_frameCullStats.culled += instanceCount - numVisible;
+		if (numVisible == 0) {
+			return;
+		}
+
+		if (numVisible < instanceCount) {
+			m_instanceOrder.erase(std::remove_if(m_instanceOrder.begin(), m_instanceOrder.end(),
+			                                     [&](uint32_t i) { return !m_instanceVisible[i]; }),
+			                      m_instanceOrder.end());
+			instanceCount = numVisible;
+		}
+	} else {
+		m_frameCullStats.visible += instanceCount;
+	}
+
+	// Blending within an instanced draw is only correct if its instances go back to front
+	if (transparent && instanceCount > 1) {
+		std::sort(m_instanceOrder.begin(), m_instanceOrder.end(), [&](uint32_t a, uint32_t b) {
+			return m_instanceDepths[a] > m_instanceDepths[b];
+		});
+	}
+
+	DrawPacket packet;
+	packet.pipelineIdx = pipelineIdx.value();
+	packet.instanceCount = instanceCount;
+	packet.model = &model;
+	ObjectData* objects =
+		m_objectStorage->reserve(instanceCount, m_currentFrame, packet.objectIdx);
+
+	uint32_t albedoIdx = model.getTexture()->getIndex();
+	uint32_t normalIdx =
+		model.getNormalMap() ? model.getNormalMap()->getIndex() : INVALID_TEXTURE_INDEX;
+	// Transparent batches are drawn in slot order even when culled on the GPU
+	uint32_t batch = packet.objectIdx | (transparent ? OBJECT_BATCH_ORDERED_BIT : 0);
+	float depth = m_instanceDepths[m_instanceOrder[0]];
+	for (uint32_t i = 0; i < instanceCount; i++) {
+		uint32_t instance = m_instanceOrder[i];
+
+		// Written straight into mapped memory, so build it on the stack first
+		ObjectData object;
+		object.trs = m_instanceTRS[instance];
+		// Cached by the transform, so a matrix is only inverted after it moves
+		object.normalMatrix = instances[instance].getNormalMatrix();
+		object.bounds = glm::vec4(m_sphereX[instance], m_sphereY[instance], m_sphereZ[instance],
+		                          m_sphereRadius[instance]);
+		object.albedoIdx = albedoIdx;
+		object.normalIdx = normalIdx;
+		object.indexCount = model.numIndices();
+		object.batch = batch;
+		objects[i] = object;
+
+		// Opaque batches sort by their nearest instance, transparent by their farthest
+		if (instanceDepths) {
+			depth = transparent ? std::max(depth, m_instanceDepths[instance])
+			                    : std::min(depth, m_instanceDepths[instance]);
+		}
+	}
+
+	packet.key =
+		RenderQueue::makeKey(transparent ? RENDER_PASS_TRANSPARENT : RENDER_PASS_OPAQUE,
+	                         packet.pipelineIdx, albedoIdx, model.getId(), depth);
+	m_renderQueue.submit(packet);
+}
+
+void VulkanRenderer::recordPackets(CommandEncoder& encoder, const DrawPacket* packets,
+                                   uint32_t count, bool gpuCulling) {
+	// Bind everything each draw needs. The encoder drops whatever is already bound, and sorting
+	// makes sure most of it is
+	for (uint32_t i = 0; i < count; i++) {
+		const DrawPacket& packet = packets[i];
+		const Ref<VulkanPipeline>& pipeline = m_pipelines[packet.pipelineIdx];
+		pipeline->bind(encoder);
+		pipeline->bindDescriptorSets(encoder, m_currentFrame);
+		applyRenderState(encoder, packet.model->getRenderState());
+		packet.model->bind(encoder);
+
+		if (gpuCulling) {
+			m_culler->draw(encoder, packet.objectIdx, packet.instanceCount,
+			               packet.model->getRenderState().blend, m_currentFrame);
+		} else {
+			// The first object's slot is passed as the first instance index
+			encoder.drawIndexed(packet.model->numIndices(), packet.instanceCount, 0, 0,
+			                    packet.objectIdx);
+		}
+	}
+}
+
+void VulkanRenderer::recordPacketsParallel(const VkRenderPassBeginInfo& renderPassInfo,
+                                           bool gpuCulling) {
+	PROFILE_FUNC();
+	const std::vector<DrawPacket>& packets = m_renderQueue.getPackets();
+	uint32_t numChunks = m_recordPool->size();
+	uint32_t chunkSize = (packets.size() + numChunks - 1) / numChunks;
+	m_secondaryBuffers.resize(numChunks);
+	m_chunkStats.resize(numChunks);
+
+	// Secondary buffers are recorded for the offscreen render pass, which the primary buffer has
+	// already begun
+	VkCommandBufferInheritanceInfo inheritanceInfo {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = renderPassInfo.renderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = renderPassInfo.framebuffer;
+
+	// Each chunk is a contiguous run of the sorted queue, so executing the chunks in order keeps
+	// the sorted order
+	m_recordPool->parallelFor(numChunks, [&](uint32_t chunk, uint32_t worker) {
+		PROFILE_SCOPE("record draw chunk");
+		VkCommandBuffer commandBuffer = m_threadCommandPools->getSecondary(worker, m_currentFrame);
+
+		VkCommandBufferBeginInfo beginInfo {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+		                  VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording secondary command buffer!");
+		}
+
+		CommandEncoder& encoder = *m_workerEncoders[worker];
+		encoder.begin(commandBuffer);
+		uint32_t first = std::min<uint32_t>(chunk * chunkSize, packets.size());
+		uint32_t count = std::min<uint32_t>(chunkSize, packets.size() - first);
+		recordPackets(encoder, packets.data() + first, count, gpuCulling);
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record secondary command buffer!");
+		}
+		m_secondaryBuffers[chunk] = commandBuffer;
+		m_chunkStats[chunk] = encoder.getStats();
+	});
+
+	m_encoder.executeCommands(numChunks, m_secondaryBuffers.data());
+	for (const auto& stats : m_chunkStats) {
+		m_secondaryStats += stats;
+	}
+}
+
+void VulkanRenderer::endModelRendering() {
+	// Lookup tables and culling run in compute passes, so they have to be recorded before the
+	// render pass starts
+	m_sky->update(m_encoder, m_currentFrame);
+
+	bool gpuCulling = m_gpuCulling && m_culler;
+	if (gpuCulling) {
+		m_culler->cull(m_encoder, m_viewProj, m_currentFrame);
+	}
+
+	// Start main render pass
 	VkRenderPassBeginInfo renderPassInfo {};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	renderPassInfo.renderPass = m_swapChain->getOffscreenRenderPass();
@@ -129,36 +382,37 @@ void VulkanRenderer::beginScene() {
 	clearValues[1].depthStencil = {1.0f, 0};
 	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 	renderPassInfo.pClearValues = clearValues.data();
-	vkCmdBeginRenderPass(m_commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-	// Bind pipeline
-	m_pipelines[0]->bind(m_commandBuffer);
-}
 
-void VulkanRenderer::draw(Model& model) {
-	PROFILE_FUNC();
-	if (!m_activePipeline->canRender(model)) {
-		findOrBuildPipeline(model);
+	// Big frames are split across threads, each recording a secondary command buffer
+	uint32_t geometryScope = m_gpuProfiler->beginScope(m_encoder, "Geometry pass", m_currentFrame);
+	m_renderQueue.sort();
+	const std::vector<DrawPacket>& packets = m_renderQueue.getPackets();
+	if (packets.size() >= PARALLEL_RECORD_MIN_DRAWS && m_recordPool->size() > 1) {
+		m_encoder.beginRenderPass(renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		recordPacketsParallel(renderPassInfo, gpuCulling);
+	} else {
+		m_encoder.beginRenderPass(renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		recordPackets(m_encoder, packets.data(), packets.size(), gpuCulling);
 	}
 
-	model.bind(m_commandBuffer);
-
-	m_activePipeline->bindTexture(model.getTexture());
-	m_activePipeline->bindDescriptorSets(m_commandBuffer, m_currentFrame);
-
-	updatePushConstant("modelTRS", glm::value_ptr(model.getTransform().getTRS()));
-
-	// Draw
-	vkCmdDrawIndexed(m_commandBuffer, model.numIndices(), 1, 0, 0, 0);
-}
-
-void VulkanRenderer::endModelRendering() {
 	// End main render pass
-	vkCmdEndRenderPass(m_commandBuffer);
+	m_encoder.endRenderPass();
+	m_gpuProfiler->endScope(m_encoder, geometryScope, m_currentFrame);
+
+	// The low resolution sky skips pixels covered by geometry, so it waits for the depth buffer
+	m_sky->recordLowResSky(m_encoder, *m_swapChain, m_viewProj, m_currentFrame);
+	m_uniformStorage->write(m_skyLUTsUniform, m_sky->getLUTs(), m_currentFrame);
 
 	// postprocessing
 	{
 		PROFILE_SCOPE("postprocessing");
+		// Named by how the sky is drawn, so the timings of each mode can be told apart
+		std::string scopeName =
+			m_sky->getModel() == SKY_MODEL_ANALYTIC
+				? "Atmosphere pass (analytic sky)"
+				: "Atmosphere pass (sky at " + m_sky->getLowResScaleName() + " res)";
+		uint32_t atmosphereScope =
+			m_gpuProfiler->beginScope(m_encoder, scopeName, m_currentFrame, SKY_PROFILER_GROUP);
 		VkRenderPassBeginInfo renderPassInfo {};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 		renderPassInfo.renderPass = m_swapChain->getPostProcessRenderPass();
@@ -170,11 +424,32 @@ void VulkanRenderer::endModelRendering() {
 		clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
 		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassInfo.pClearValues = clearValues.data();
-		vkCmdBeginRenderPass(m_commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-		m_postprocessPipeline->bind(m_commandBuffer);
-		/* m_postprocessPipeline->bindTexture(m_swapChain->getOffscreenFramebuffer(0).color); */
-		m_postprocessPipeline->bindDescriptorSets(m_commandBuffer, m_currentFrame);
-		vkCmdDraw(m_commandBuffer, 3, 1, 0, 0);
+		// The atmosphere pass is cached in a secondary buffer
+		m_encoder.beginRenderPass(renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+		// The atmosphere pass records the same commands every frame, only its uniforms change. It
+		// only has to be recorded again if one of the handles it uses does
+		uint64_t signature = 0;
+		hashSignature(signature, m_swapChain->getGeneration());
+		hashSignature(signature, renderPassInfo.framebuffer);
+		hashSignature(signature, m_postprocessPipeline->getHandle());
+		hashSignature(signature, m_postprocessPipeline->getDescriptorSets(m_currentFrame));
+
+		VkCommandBufferInheritanceInfo inheritanceInfo {};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = renderPassInfo.renderPass;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = renderPassInfo.framebuffer;
+		VkCommandBuffer atmosphere = m_staticCommands->get(
+			m_currentFrame, m_imageIndex, signature, inheritanceInfo, [&](CommandEncoder& encoder) {
+				m_postprocessPipeline->bind(encoder);
+				m_postprocessPipeline->bindDescriptorSets(encoder, m_currentFrame);
+				applyRenderState(encoder, RenderState::background());
+				encoder.draw(3, 1, 0, 0);
+			});
+		m_encoder.executeCommands(1, &atmosphere);
+		m_encoder.endRenderPass();
+		m_gpuProfiler->endScope(m_encoder, atmosphereScope, m_currentFrame);
 	}
 }
 
@@ -187,18 +462,55 @@ void VulkanRenderer::beginUIRendering() {
 
 void VulkanRenderer::endScene() {
 	PROFILE_FUNC();
-	// Record ImGui Frame
-	m_activePipeline = m_postprocessPipeline;
-	m_activePipeline->bind(m_commandBuffer);
-
+	// Record ImGui Frame. ImGui binds its own pipeline and resources
 	ImGui::Render();
 	ImDrawData* draw_data = ImGui::GetDrawData();
-	ImGui_ImplVulkan_RenderDrawData(draw_data, m_commandBuffer);
+	{
+		// The UI has a pass of its own, so it isn't counted against the sky's GPU budget
+		uint32_t uiScope = m_gpuProfiler->beginScope(m_encoder, "UI pass", m_currentFrame);
+		VkRenderPassBeginInfo renderPassInfo {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = m_swapChain->getUIRenderPass();
+		renderPassInfo.framebuffer = m_swapChain->getFramebuffer(m_imageIndex);
+		renderPassInfo.renderArea.offset = {0, 0};
+		renderPassInfo.renderArea.extent = m_swapChain->getExtent();
+		// Recorded in a secondary buffer, so ImGui's binds don't go behind the encoder's back
+		m_encoder.beginRenderPass(renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+		VkCommandBufferInheritanceInfo inheritanceInfo {};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = renderPassInfo.renderPass;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = renderPassInfo.framebuffer;
+		VkCommandBuffer uiBuffer =
+			m_threadCommandPools->getSecondary(m_recordPool->size(), m_currentFrame);
+		VkCommandBufferBeginInfo beginInfo {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+		                  VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+		if (vkBeginCommandBuffer(uiBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording UI command buffer!");
+		}
+		ImGui_ImplVulkan_RenderDrawData(draw_data, uiBuffer);
+		if (vkEndCommandBuffer(uiBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record UI command buffer!");
+		}
+		m_encoder.executeCommands(1, &uiBuffer);
+		m_encoder.endRenderPass();
+		m_gpuProfiler->endScope(m_encoder, uiScope, m_currentFrame);
+	}
 
 	// ImGui::RenderPlatformWindowsDefault();
 	// ImGui::UpdatePlatformWindows();
 
-	vkCmdEndRenderPass(m_commandBuffer);
+	if (m_captureRequested) {
+		recordCapture();
+		m_captureRequested = false;
+	}
+	m_stats = m_encoder.getStats();
+	m_stats += m_secondaryStats;
+	m_cullStats = m_frameCullStats;
 
 	// Finish recording commands, submit drawing to GPU queue
 	if (vkEndCommandBuffer(m_commandBuffer) != VK_SUCCESS) {
@@ -214,39 +526,199 @@ void VulkanRenderer::endScene() {
 	m_swapChain->present(m_imageIndex, m_currentFrame);
 
 	m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+
+	// Swap variants in between frames, so uniforms for the next frame go to the new pipelines
+	swapReadyVariants();
+	// Likewise for optimized pipelines, which must not change while threads are recording
+	for (const auto& pipeline : m_pipelines) {
+		pipeline->swapOptimizedPipeline();
+	}
+	m_postprocessPipeline->swapOptimizedPipeline();
 }
 
-void VulkanRenderer::updateUniform(std::string name, void* data) {
-	for (auto pipeline : m_pipelines) {
-		pipeline->writeUniform(name, data, m_currentFrame);
+void VulkanRenderer::requestCapture() {
+	VkFormat format = m_swapChain->getImageFormat();
+	bool rgba8 = format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_R8G8B8A8_UNORM ||
+	             format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM;
+	if (!m_swapChain->isCapturable() || !rgba8) {
+		LOG_WARN("Swapchain images can't be copied out of, frames will not be captured");
+		return;
 	}
 
-	m_postprocessPipeline->writeUniform(name, data, m_currentFrame);
+	m_captureRequested = true;
 }
 
-void VulkanRenderer::updatePushConstant(const std::string& name, const void* data) {
-	for (auto pipeline : m_pipelines) {
-		pipeline->writePushConstant(m_commandBuffer, name, data, m_currentFrame);
+void VulkanRenderer::recordCapture() {
+	const VkExtent2D& extent = m_swapChain->getExtent();
+	if (extent.width != m_captureExtent.width || extent.height != m_captureExtent.height) {
+		if (m_captureBuffer != VK_NULL_HANDLE) {
+			// An earlier frame in flight may still be copying into the old buffer
+			m_device->flush();
+			vkDestroyBuffer(m_device->getLogicalDevice(), m_captureBuffer, nullptr);
+			vkFreeMemory(m_device->getLogicalDevice(), m_captureBufferMemory, nullptr);
+		}
+
+		VkDeviceSize size = 4ull * extent.width * extent.height;
+		m_device->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+		                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		                       m_captureBuffer, m_captureBufferMemory);
+		void* mapped;
+		vkMapMemory(m_device->getLogicalDevice(), m_captureBufferMemory, 0, size, 0, &mapped);
+		m_captureMapped = static_cast<uint8_t*>(mapped);
+		m_captureExtent = extent;
 	}
+
+	// The UI pass left the image ready to present
+	VkImage image = m_swapChain->getImage(m_imageIndex);
+	m_encoder.imageBarrier(image, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+	                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+	                       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+	                       VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+	                       VK_ACCESS_TRANSFER_READ_BIT);
+	m_encoder.copyImageToBuffer(image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, extent,
+	                            m_captureBuffer);
+	m_encoder.imageBarrier(image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+	                       VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+	                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+	m_encoder.memoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+	                        VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+	m_captured = true;
 }
 
-void VulkanRenderer::findOrBuildPipeline(const Model& model) {
-	bool compatiblePipeline = false;
-	for (const auto pipeline : m_pipelines) {
-		if (pipeline->canRender(model)) {
-			m_activePipeline = pipeline;
-			pipeline->bind(m_commandBuffer);
-			compatiblePipeline = true;
-			break;
+RgbaImage VulkanRenderer::getCapture() {
+	RgbaImage capture;
+	if (!m_captured) {
+		return capture;
+	}
+
+	m_device->flush();
+	capture.size = {m_captureExtent.width, m_captureExtent.height};
+	size_t size = 4ull * capture.size.x * capture.size.y;
+	capture.pixels.assign(m_captureMapped, m_captureMapped + size);
+
+	VkFormat format = m_swapChain->getImageFormat();
+	capture.srgb = format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_B8G8R8A8_SRGB;
+	if (format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM) {
+		for (size_t i = 0; i < capture.pixels.size(); i += 4) {
+			std::swap(capture.pixels[i], capture.pixels[i + 2]);
 		}
 	}
 
-	if (!compatiblePipeline) {
+	return capture;
+}
+
+void VulkanRenderer::setSkyQualityGovernor(bool enabled) {
+	if (enabled && !m_device->supportsTimestamps()) {
+		LOG_WARN("Can't govern sky quality without GPU timestamps");
+		return;
+	}
+
+	m_governSkyQuality = enabled;
+	if (enabled) {
+		applySkyQuality(m_qualityGovernor.getLevel());
+	}
+}
+
+void VulkanRenderer::applySkyQuality(const SkyQualityLevel& level) {
+	m_sky->setInScatteringSamples(level.inScatteringPoints);
+	m_sky->setOpticalDepthSamples(level.opticalDepthPoints);
+	m_sky->setLowResScale(level.skyScale);
+	m_sky->setSkyViewDivisor(level.skyViewDivisor);
+}
+
+void VulkanRenderer::setSpecializationConstant(const std::string& name, int32_t value) {
+	auto constant = m_specConstants.find(name);
+	if (constant != m_specConstants.end() && constant->second == value) {
+		return;
+	}
+	m_specConstants[name] = value;
+
+	auto requestVariant = [&](const Ref<VulkanPipeline>& pipeline, const VertexArray& vertexArray,
+	                          bool isPostProcessing) {
+		const Ref<Shader>& shader = pipeline->getShader();
+		SpecializationValues values = getSpecialization(*shader);
+		if (values == pipeline->getSpecialization()) {
+			return;
+		}
+
+		m_pendingVariants.push_back(
+			m_pipelineBuilder.buildPipelineAsync(vertexArray, shader, isPostProcessing, values));
+	};
+
+	for (const auto& pipeline : m_pipelines) {
+		requestVariant(pipeline, m_defaultVA, false);
+	}
+	requestVariant(m_postprocessPipeline, VertexArray(), true);
+}
+
+SpecializationValues VulkanRenderer::getSpecialization(const Shader& shader) const {
+	SpecializationValues values;
+	for (const auto& constant : shader.getSpecializationConstants()) {
+		auto value = m_specConstants.find(constant.name);
+		values.push_back(value != m_specConstants.end() ? value->second : constant.defaultValue);
+	}
+
+	return values;
+}
+
+void VulkanRenderer::swapReadyVariants() {
+	for (auto it = m_pendingVariants.begin(); it != m_pendingVariants.end();) {
+		if (it->wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			it++;
+			continue;
+		}
+
+		// Settings may have changed again while compiling, in which case this variant is stale.
+		// It stays cached by the builder in case the setting comes back
+		Ref<VulkanPipeline> variant = it->get();
+		if (m_pendingShaders.erase(variant->getShader().get())) {
+			// First pipeline for a new shader
+			m_pipelines.push_back(variant);
+		} else if (variant->getSpecialization() == getSpecialization(*variant->getShader())) {
+			for (auto& pipeline : m_pipelines) {
+				if (pipeline->getShader() == variant->getShader()) {
+					pipeline = variant;
+				}
+			}
+			if (m_postprocessPipeline->getShader() == variant->getShader()) {
+				m_postprocessPipeline = variant;
+			}
+		}
+
+		it = m_pendingVariants.erase(it);
+	}
+}
+
+std::optional<uint32_t> VulkanRenderer::findOrBuildPipeline(const Model& model) {
+	// Consecutive draws often use the same pipeline
+	if (m_lastPipelineIdx < m_pipelines.size() &&
+	    m_pipelines[m_lastPipelineIdx]->canRender(model)) {
+		return m_lastPipelineIdx;
+	}
+
+	for (uint32_t i = 0; i < m_pipelines.size(); i++) {
+		if (m_pipelines[i]->canRender(model)) {
+			m_lastPipelineIdx = i;
+			return i;
+		}
+	}
+
+	if (m_pendingShaders.insert(model.getShader().get()).second) {
 		LOG_WARN("Pipeline-model mismatch!");
 		LOG_INFO("Constructing new pipeline");
-		auto pipeline = m_pipelineBuilder.buildPipeline(m_defaultVA, model.getShader(), m_textures);
-		m_activePipeline = pipeline;
-		pipeline->bind(m_commandBuffer);
-		m_pipelines.push_back(pipeline);
+		m_pendingVariants.push_back(m_pipelineBuilder.buildPipelineAsync(
+			m_defaultVA, model.getShader(), false, getSpecialization(*model.getShader())));
 	}
+
+	return std::nullopt;
+}
+
+void VulkanRenderer::applyRenderState(CommandEncoder& encoder, const RenderState& renderState) {
+	encoder.setCullMode(renderState.cullMode);
+	encoder.setFrontFace(renderState.frontFace);
+	encoder.setDepthTestEnable(renderState.depthTest);
+	encoder.setDepthWriteEnable(renderState.depthWrite);
+	encoder.setDepthCompareOp(renderState.depthCompare);
+	encoder.setColorBlendEnable(renderState.blend);
 }
@@ -1,14 +1,43 @@
 #pragma once
 
+#include <future>
+#include <map>
+#include <optional>
+#include <set>
 #include <string>
+#include <vector>
 #include <vulkan/vulkan_core.h>
 
+#include "bootstrap/command_encoder.hpp"
 #include "bootstrap/device.hpp"
+#include "bootstrap/gpu_profiler.hpp"
+#include "bootstrap/object_storage.hpp"
 #include "bootstrap/pipeline.hpp"
 #include "bootstrap/pipeline_builder.hpp"
+#include "bootstrap/static_command_cache.hpp"
 #include "bootstrap/swapchain.hpp"
+#include "bootstrap/texture_table.hpp"
+#include "bootstrap/thread_command_pools.hpp"
+#include "bootstrap/uniform_storage.hpp"
 
+#include "renderer/gpu_culler.hpp"
 #include "renderer/model.hpp"
+#include "renderer/quality_governor.hpp"
+#include "renderer/render_queue.hpp"
+#include "renderer/render_state.hpp"
+#include "renderer/sky_renderer.hpp"
+#include "util/bounds.hpp"
+#include "util/image_compare.hpp"
+#include "util/simd.hpp"
+#include "util/thread_pool.hpp"
+
+/* Objects submitted in a frame, and how many of them frustum culling dropped */
+struct CullStats {
+	uint32_t visible = 0;
+	uint32_t culled = 0;
+	/* Culled by the GPU, after submission. Culled objects are not counted then */
+	bool onGpu = false;
+};
 
 class VulkanRenderer {
   public:
@@ -22,16 +51,227 @@ class VulkanRenderer {
 
   public:
 	void beginScene();
+	/**
+	 * @brief Queues a model to be drawn this frame
+	 *
+	 * Nothing is recorded yet. Queued draws are sorted and recorded in endModelRendering.
+	 */
 	void draw(Model& model);
+	/**
+	 * @brief Queues one draw of the model for each of the given transforms
+	 *
+	 * All instances share the model's mesh, textures, and render state, and are drawn with a
+	 * single instanced draw call. The model's own transform is ignored.
+	 */
+	void drawInstanced(Model& model, std::vector<Transform>& instances);
 	void endModelRendering();
 	void beginUIRendering();
 	void endScene();
 
-	void updateUniform(std::string name, void* data);
-	void updatePushConstant(const std::string& name, const void* data);
+	/**
+	 * @brief Resolves a uniform by name. Do this once at setup, then write through the handle.
+	 *
+	 * @param name The name of the uniform, as listed in the shader uniform map
+	 */
+	template <typename T> inline UniformHandle<T> getUniform(const std::string& name) {
+		return m_uniformStorage->getHandle<T>(name);
+	}
+	/**
+	 * @brief Writes a uniform for the current frame, for every pipeline that uses it
+	 */
+	template <typename T> inline void updateUniform(UniformHandle<T> handle, const T& data) {
+		m_uniformStorage->write(handle, data, m_currentFrame);
+	}
+	/**
+	 * @brief Sets a named specialization constant for every shader that declares it
+	 *
+	 * Pipeline variants using the new value are compiled in the background. Until they are ready,
+	 * the current variants keep rendering with the old value.
+	 */
+	void setSpecializationConstant(const std::string& name, int32_t value);
+	/**
+	 * @brief Writes the atmosphere uniform for the current frame, and bakes the atmosphere's
+	 * lookup tables again if its shape changed
+	 */
+	inline void updateAtmosphere(const Atmosphere& atmosphere) {
+		updateUniform(m_atmosphereUniform, atmosphere);
+		m_sky->setAtmosphere(atmosphere);
+	}
+	/**
+	 * @brief Writes the light uniform for the current frame. The light is also the atmosphere's
+	 * sun, so the sky is baked again if it moved
+	 */
+	inline void updateLight(const LightSource& light) {
+		updateUniform(m_lightUniform, light);
+		m_sky->setSunPosition(light.pos);
+	}
+	/**
+	 * @brief Sets the number of samples baked into each texel of the optical depth LUT
+	 */
+	inline void setOpticalDepthSamples(uint32_t numSamples) {
+		m_sky->setOpticalDepthSamples(numSamples);
+	}
+	/**
+	 * @brief Sets the number of samples marched for each texel of the sky-view LUT
+	 */
+	inline void setInScatteringSamples(uint32_t numSamples) {
+		m_sky->setInScatteringSamples(numSamples);
+	}
+	/**
+	 * @brief Sets the fraction of screen resolution the sky is drawn at, then upsampled
+	 *
+	 * @param scale Screen pixels along each side of a texel of the sky: 1 (full resolution), 2,
+	 * or 4
+	 */
+	inline void setSkyScale(uint32_t scale) { m_sky->setLowResScale(scale); }
+	/**
+	 * @brief Sets the resolution the sky-view LUT is baked at, as a fraction of its full size
+	 *
+	 * @param divisor 1 for full resolution, 2 for half along each axis
+	 */
+	inline void setSkyViewDivisor(uint32_t divisor) { m_sky->setSkyViewDivisor(divisor); }
+	/**
+	 * @brief Sets whether small moves of the sun only march a quarter of the sky-view LUT each
+	 * frame, converging over the next few frames, rather than all of it at once
+	 */
+	inline void setTemporalSky(bool enabled) { m_sky->setTemporalSkyView(enabled); }
+	/**
+	 * @brief Sets whether the cached sky cubemap is baked again one face per frame, rather than
+	 * whole in the frame the sky changes
+	 */
+	inline void setSpreadSkyCubemap(bool enabled) { m_sky->setSpreadCubemapBake(enabled); }
+	/**
+	 * @brief Sets whether the sky is integrated into lookup tables, or worked out in closed form
+	 * for each pixel. Both time the atmosphere pass under their own name
+	 */
+	inline void setSkyModel(SkyModel model) { m_sky->setModel(model); }
+	inline SkyModel getSkyModel() const { return m_sky->getModel(); }
+	/**
+	 * @brief Gets the last measured difference between the analytic and integrated sky. Only
+	 * measured while the sky is integrated
+	 */
+	inline SkyModelDelta getSkyModelDelta() const { return m_sky->getModelDelta(); }
+	/**
+	 * @brief Turns on or off picking sky settings automatically to stay within a GPU time budget.
+	 * While on, it overrides sample counts and sky resolutions set by hand. Ignored if the device
+	 * can't time work on the GPU
+	 */
+	void setSkyQualityGovernor(bool enabled);
+	/**
+	 * @brief Sets the GPU time the sky may take each frame, in milliseconds
+	 */
+	inline void setSkyBudget(float budget) { m_qualityGovernor.setBudget(budget); }
+	inline bool isSkyQualityGoverned() const { return m_governSkyQuality; }
+	inline const QualityGovernor& getSkyQualityGovernor() const { return m_qualityGovernor; }
+
+	/**
+	 * @brief Sets the camera the next frame is drawn from, for sorting and culling draws
+	 *
+	 * @param viewPos Position draws are depth sorted relative to
+	 * @param viewProj View projection matrix, whose frustum draws are culled against
+	 */
+	inline void setView(const glm::vec3& viewPos, const glm::mat4& viewProj) {
+		m_viewPos = viewPos;
+		m_viewProj = viewProj;
+		m_frustum = Frustum::fromViewProj(viewProj);
+	}
+	/**
+	 * @brief Turns frustum culling and indirect drawing on the GPU on or off. Ignored if the
+	 * device does not support it
+	 */
+	inline void setGpuCulling(bool gpuCulling) { m_gpuCulling = gpuCulling; }
+	inline bool supportsGpuCulling() const { return m_culler != nullptr; }
+	/**
+	 * @brief Gets the number of commands recorded and skipped for the last completed frame
+	 */
+	inline const CommandStats& getStats() const { return m_stats; }
+	/**
+	 * @brief Gets the number of objects culled and drawn in the last completed frame
+	 */
+	inline const CullStats& getCullStats() const { return m_cullStats; }
+	/**
+	 * @brief Gets the number of times static passes have been recorded. Stays put while they are
+	 * only resubmitted
+	 */
+	inline uint32_t getStaticRecordCount() const { return m_staticCommands->getRecordCount(); }
+	/**
+	 * @brief Gets the last measured GPU time of each profiled scope, in milliseconds
+	 */
+	inline const std::map<std::string, float>& getGpuTimings() const {
+		return m_gpuProfiler->getTimings();
+	}
+	inline uint32_t getSkyBakeCount() const { return m_sky->getBakeCount(); }
+	/**
+	 * @brief Gets the GPU time every pass working on the sky took in the last frame read back, in
+	 * milliseconds
+	 */
+	inline float getSkyGpuTime() const { return m_gpuProfiler->getGroupTime(SKY_PROFILER_GROUP); }
+	/**
+	 * @brief Throws away every baked sky table, so the next frame bakes them all again, i.e. to
+	 * time a bake
+	 */
+	inline void invalidateSky() { m_sky->invalidate(); }
+
+	/**
+	 * @brief Copies the next frame's final image, UI included, to host memory once it is recorded.
+	 * Ignored if the swapchain's images can't be copied out of
+	 */
+	void requestCapture();
+	/**
+	 * @brief Gets the last captured frame. Waits for the device to go idle, so that it is done
+	 *
+	 * @return The frame as 8 bit RGBA, whatever the swapchain's format. Empty if no frame has been
+	 * captured
+	 */
+	RgbaImage getCapture();
 
   private:
-	void findOrBuildPipeline(const Model& model);
+	/**
+	 * @brief Finds a pipeline able to render the given model
+	 *
+	 * If none exists yet, one is compiled in the background rather than stalling the frame.
+	 *
+	 * @return The index of a compatible pipeline, if there is one yet
+	 */
+	std::optional<uint32_t> findOrBuildPipeline(const Model& model);
+	/**
+	 * @brief Writes the object data of each instance, and queues a draw of all of them
+	 */
+	void submit(Model& model, Transform* instances, uint32_t instanceCount);
+	/**
+	 * @brief Records a run of sorted draws, skipping binds that would change nothing. Safe to call
+	 * from several threads at once, each with its own encoder
+	 *
+	 * @param gpuCulling Whether objects were culled this frame, and should be drawn indirectly
+	 */
+	void recordPackets(CommandEncoder& encoder, const DrawPacket* packets, uint32_t count,
+	                   bool gpuCulling);
+	/**
+	 * @brief Splits the sorted queue into one chunk per worker, records each into a secondary
+	 * command buffer on the thread pool, and executes them in order
+	 *
+	 * @param renderPassInfo The offscreen render pass, already begun with secondary contents
+	 */
+	void recordPacketsParallel(const VkRenderPassBeginInfo& renderPassInfo, bool gpuCulling);
+	/**
+	 * @brief Sets the dynamic fixed function state for following draws. The encoder skips any
+	 * commands that would not change anything
+	 */
+	void applyRenderState(CommandEncoder& encoder, const RenderState& renderState);
+	/**
+	 * @brief Gets the current value of each of the shader's specialization constants
+	 */
+	SpecializationValues getSpecialization(const Shader& shader) const;
+	/**
+	 * @brief Replaces pipelines with any background compiled variants which have finished
+	 */
+	void swapReadyVariants();
+	void applySkyQuality(const SkyQualityLevel& level);
+	/**
+	 * @brief Records copying the image just rendered to the capture buffer, creating it first if
+	 * the extent changed. Must be recorded after the UI pass
+	 */
+	void recordCapture();
 
   private:
 	/* The swapchain the render images to */
@@ -40,16 +280,90 @@ class VulkanRenderer {
 	/* Device to execute the rendering on */
 	Ref<VulkanDevice> m_device;
 
+	/* Every texture available to shaders, shared by all pipelines */
+	Ref<BindlessTextureTable> m_textureTable;
+	/* Data of every uniform, shared by all pipelines */
+	Ref<UniformStorage> m_uniformStorage;
+	/* Per draw data of each object, shared by all pipelines */
+	Ref<ObjectStorage> m_objectStorage;
+
+	/* Times scopes of each frame on the GPU */
+	Ref<GpuProfiler> m_gpuProfiler;
+
 	PipelineBuilder m_pipelineBuilder;
 	std::vector<Ref<VulkanPipeline>> m_pipelines;
 	Ref<VulkanPipeline> m_postprocessPipeline;
-	Ref<VulkanPipeline> m_activePipeline;
+	/* Bakes the lookup tables read by the atmosphere pass, and draws the low resolution sky */
+	ScopedRef<SkyRenderer> m_sky;
+	UniformHandle<Atmosphere> m_atmosphereUniform;
+	UniformHandle<LightSource> m_lightUniform;
+	UniformHandle<SkyLUTs> m_skyLUTsUniform;
+	/* Picks sky settings from its GPU time, while m_governSkyQuality is set */
+	QualityGovernor m_qualityGovernor {1.5f};
+	bool m_governSkyQuality = false;
+
+	/* Host visible copy of the last captured frame, sized for m_captureExtent */
+	VkBuffer m_captureBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory m_captureBufferMemory = VK_NULL_HANDLE;
+	uint8_t* m_captureMapped = nullptr;
+	VkExtent2D m_captureExtent = {0, 0};
+	/* Whether to capture the frame being recorded, and whether any frame has been */
+	bool m_captureRequested = false;
+	bool m_captured = false;
+
+	/* Draws submitted this frame, recorded at the end of model rendering */
+	RenderQueue m_renderQueue;
+	/* Position draws are depth sorted relative to */
+	glm::vec3 m_viewPos = glm::vec3(0.0f);
+	/* Camera draws are frustum culled against */
+	glm::mat4 m_viewProj = glm::mat4(1.0f);
+	Frustum m_frustum = Frustum::fromViewProj(glm::mat4(1.0f));
+	/* Culls objects and writes their draws on the GPU. Null if the device can't draw indirectly */
+	ScopedRef<GpuCuller> m_culler;
+	/* Whether to cull with m_culler, if there is one */
+	bool m_gpuCulling = true;
+	/* Scratch space for ordering the instances of a draw, kept to avoid allocating every draw */
+	std::vector<uint32_t> m_instanceOrder;
+	std::vector<float> m_instanceDepths;
+	std::vector<glm::mat4> m_instanceTRS;
+	std::vector<uint8_t> m_instanceVisible;
+	/* World space bounding sphere of each instance, packed for the culling kernel */
+	std::vector<float> m_sphereX, m_sphereY, m_sphereZ, m_sphereRadius;
+	/* Pipeline used by the last draw, checked first for the next one */
+	uint32_t m_lastPipelineIdx = 0;
+	/* Counts for the last complete frame */
+	CommandStats m_stats;
+	CullStats m_cullStats;
+	/* Culling counts of the frame being recorded */
+	CullStats m_frameCullStats;
+
+	/* Specialization constant values set by the application, by name */
+	std::map<std::string, int32_t> m_specConstants;
+	/* Variants still compiling. Declared after the builder, so they finish before it is gone */
+	std::vector<std::shared_future<Ref<VulkanPipeline>>> m_pendingVariants;
+	/* Shaders with no pipeline yet, whose first pipeline is among the pending variants */
+	std::set<const Shader*> m_pendingShaders;
 
 	const VertexArray m_defaultVA;
-	const std::vector<Ref<Texture>> m_textures;
 
 	/* Buffer holding all the drawing commands for the current frame */
 	VkCommandBuffer m_commandBuffer;
+	/* Records into m_commandBuffer, skipping redundant binds */
+	CommandEncoder m_encoder;
+
+	/* Workers recording draws into secondary command buffers, each with its own pools and
+	 * encoder. The last set of pools is the main thread's */
+	ScopedRef<ThreadPool> m_recordPool;
+	ScopedRef<ThreadCommandPools> m_threadCommandPools;
+	std::vector<ScopedRef<CommandEncoder>> m_workerEncoders;
+	/* Secondary buffer and counts of each chunk of the queue, in order */
+	std::vector<VkCommandBuffer> m_secondaryBuffers;
+	std::vector<CommandStats> m_chunkStats;
+	/* Counts of every secondary buffer recorded this frame */
+	CommandStats m_secondaryStats;
+
+	/* Commands which are the same every frame, i.e. the atmosphere pass */
+	ScopedRef<StaticCommandCache> m_staticCommands;
 
 	/* Index of the frame in flight being rendered */
 	uint32_t m_currentFrame = 0;
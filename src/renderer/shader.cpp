@@ -6,20 +6,21 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <vulkan/vulkan_core.h>
 
-// HACK: both of these maps can theoretically be generated at runtime by parsing the shader source
+// HACK: all of these maps can theoretically be generated at runtime by parsing the shader source
 // code. However, I really don't want to do that.
 std::unordered_map<std::string, PipelineDescriptor> Shader::s_pushConstantMap = {
+	// Per object data comes from the object storage buffer instead (see ObjectStorage)
 	{
 		"model",
-		{VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4), "modelTRS"},
+		{},
 	},
 	{
 		"cloud",
-		{VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4), "modelTRS"},
+		{},
 	},
 	{
 		"skybox",
-		{VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4), "modelTRS"},
+		{},
 	},
 	{
 		"atmosphere",
@@ -47,9 +48,14 @@ std::unordered_map<std::string, std::vector<PipelineDescriptor>> Shader::s_unifo
 		 {VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::mat4), "camVP"},
 		 {VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(Atmosphere), "atmos"},
 		 {VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(LightSource), "light"},
+		 {VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(SkyLUTs), "skyLUTs"},
 	 }},
 };
 
+// Shaders not listed here have no specialization constants. None have any since the atmosphere's
+// ray march moved into the sky-view LUT bake, which reads its sample count from a push constant
+std::unordered_map<std::string, std::vector<SpecializationConstant>> Shader::s_specConstantMap;
+
 Shader::Shader(Ref<VulkanDevice> device, const std::string& shaderName)
 	: m_device(device), m_name(shaderName) {
 	// Check if we have descriptor data for the given shader
@@ -63,6 +69,11 @@ Shader::Shader(Ref<VulkanDevice> device, const std::string& shaderName)
 	m_pushConstant = pushConstant->second;
 	m_uniforms = uniforms->second;
 
+	auto specConstants = s_specConstantMap.find(shaderName);
+	if (specConstants != s_specConstantMap.end()) {
+		m_specConstants = specConstants->second;
+	}
+
 	// Init shader
 	auto vertShaderCode = readFile("res/shaderc/" + shaderName + ".vert.spv");
 	auto fragShaderCode = readFile("res/shaderc/" + shaderName + ".frag.spv");
@@ -91,6 +102,15 @@ Shader::~Shader() {
 	vkDestroyShaderModule(m_device->getLogicalDevice(), m_fragShaderModule, nullptr);
 }
 
+SpecializationValues Shader::getDefaultSpecialization() const {
+	SpecializationValues values;
+	for (const auto& constant : m_specConstants) {
+		values.push_back(constant.defaultValue);
+	}
+
+	return values;
+}
+
 std::vector<char> Shader::readFile(const std::string& filename) {
 	std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
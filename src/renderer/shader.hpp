@@ -4,17 +4,52 @@
 #include <unordered_map>
 #include <vector>
 #include <array>
+#include <cstddef>
+#include <stdexcept>
 #include <glm/glm.hpp>
 #include <vulkan/vulkan_core.h>
 
 #include "bootstrap/device.hpp"
+#include "util/constants.hpp"
+#include "util/gpu_layout.hpp"
 
 struct PipelineDescriptor {
-	VkShaderStageFlagBits stage;
+	VkShaderStageFlags stage;
 	uint32_t size;
 	std::string name;
 };
 
+/* A constant baked into the shader code when a pipeline is created. Shaders declare these with
+ * layout(constant_id = id), so changing one requires a new pipeline variant, but lets the driver
+ * unroll loops and strip disabled branches. Booleans are passed as 0 / 1. */
+struct SpecializationConstant {
+	uint32_t id;
+	std::string name;
+	int32_t defaultValue;
+};
+
+/* Values for each of a shader's specialization constants, in the order the shader lists them */
+using SpecializationValues = std::vector<int32_t>;
+
+/* Per draw data of one object, read from the object storage buffer (std430) */
+struct ObjectData {
+	alignas(16) glm::mat4 trs;
+	/* Inverse transpose of trs, so shaders don't invert a matrix for every vertex. Kept as a mat4
+	 * since a std430 mat3 is padded to the same size anyway */
+	alignas(16) glm::mat4 normalMatrix;
+	/* World space bounding sphere: xyz center, w radius */
+	alignas(16) glm::vec4 bounds;
+	alignas(4) uint32_t albedoIdx;
+	alignas(4) uint32_t normalIdx;
+	/* Read by GPU culling to write this object's draw command */
+	alignas(4) uint32_t indexCount;
+	/* Slot of the first object drawn in the same batch, ORed with OBJECT_BATCH_ORDERED_BIT if the
+	 * batch must be drawn in slot order */
+	alignas(4) uint32_t batch;
+};
+
+const uint32_t OBJECT_BATCH_ORDERED_BIT = 1u << 31;
+
 struct LightSource {
 	alignas(16) glm::vec3 pos;
 	alignas(16) glm::vec3 color;
@@ -26,6 +61,9 @@ struct CloudSettings {
 	alignas(4) float noiseFreq = 10.0f;
 	alignas(4) float baseIntensity = 0.9f;
 	alignas(4) float opacity = 0.8f;
+	/* Bindless index of the NoiseVolume clouds sample, and the lattice cells it spans */
+	alignas(4) uint32_t noiseVolume = INVALID_TEXTURE_INDEX;
+	alignas(4) float noisePeriod = 1.0f;
 };
 
 struct alignas(128) Atmosphere {
@@ -37,10 +75,59 @@ struct alignas(128) Atmosphere {
 	alignas(4) float offsetFactor;
 	alignas(4) float densityFalloff;
 	alignas(4) float scatteringStrength;
-	alignas(4) int numInScatteringPoints;
-	alignas(4) int numOpticalDepthPoints;
 };
 
+/* How the atmosphere pass works out the color of the sky */
+enum SkyModel {
+	/* Ray marched into lookup tables, see SkyRenderer */
+	SKY_MODEL_INTEGRATED = 0,
+	/* Closed form per pixel, from the Chapman function. Cheaper, with no tables at all */
+	SKY_MODEL_ANALYTIC = 1,
+};
+
+/* Bindless texture indices of the lookup tables and targets read by the atmosphere pass */
+struct SkyLUTs {
+	/* Optical depth to the edge of the atmosphere, by view angle and height */
+	alignas(4) uint32_t opticalDepth = INVALID_TEXTURE_INDEX;
+	/* Light scattered towards the eye, by direction relative to the sun */
+	alignas(4) uint32_t skyView = INVALID_TEXTURE_INDEX;
+	/* The sky at a fraction of screen resolution, upsampled by the atmosphere pass */
+	alignas(4) uint32_t lowResSky = INVALID_TEXTURE_INDEX;
+	/* Screen pixels along each side of a texel of lowResSky. 1 if the sky is drawn at full
+	 * resolution, straight from skyView */
+	alignas(4) uint32_t lowResScale = 1;
+	/* The sky in every direction, resampled from skyView whenever it changes */
+	alignas(4) uint32_t skyCube = INVALID_TEXTURE_INDEX;
+	/* A SkyModel. The tables are left out of date while the sky is analytic */
+	alignas(4) uint32_t model = SKY_MODEL_INTEGRATED;
+};
+
+// Offsets must match the std140 (uniforms) / std430 (storage buffers) layouts used by the shaders
+static_assert(offsetof(ObjectData, normalMatrix) == 64 && offsetof(ObjectData, bounds) == 128 &&
+              offsetof(ObjectData, albedoIdx) == 144 && offsetof(ObjectData, normalIdx) == 148 &&
+              offsetof(ObjectData, indexCount) == 152 && offsetof(ObjectData, batch) == 156 &&
+              sizeof(ObjectData) == 160);
+static_assert(offsetof(LightSource, color) == 16 && offsetof(LightSource, ambientStrength) == 28 &&
+              offsetof(LightSource, diffuseStrength) == 32);
+static_assert(offsetof(CloudSettings, baseIntensity) == 4 &&
+              offsetof(CloudSettings, opacity) == 8 && offsetof(CloudSettings, noiseVolume) == 12 &&
+              offsetof(CloudSettings, noisePeriod) == 16);
+static_assert(offsetof(SkyLUTs, skyView) == 4 && offsetof(SkyLUTs, lowResSky) == 8 &&
+              offsetof(SkyLUTs, lowResScale) == 12 && offsetof(SkyLUTs, skyCube) == 16 &&
+              offsetof(SkyLUTs, model) == 20);
+static_assert(offsetof(Atmosphere, wavelengths) == 16 &&
+              offsetof(Atmosphere, defractionCoef) == 32 && offsetof(Atmosphere, time) == 44 &&
+              offsetof(Atmosphere, radius) == 48 && offsetof(Atmosphere, offsetFactor) == 52 &&
+              offsetof(Atmosphere, densityFalloff) == 56 &&
+              offsetof(Atmosphere, scatteringStrength) == 60);
+
+GPU_LAYOUT(glm::mat4);
+GPU_LAYOUT(ObjectData);
+GPU_LAYOUT(LightSource);
+GPU_LAYOUT(CloudSettings);
+GPU_LAYOUT(Atmosphere);
+GPU_LAYOUT(SkyLUTs);
+
 /**
  * @class Shader
  * @brief Describes how pixels of a particular object are colored.
@@ -75,13 +162,29 @@ class Shader {
 	 * @return A vector of structs describing the uniforms used by this shader.
 	 */
 	const inline std::vector<PipelineDescriptor>& getUniforms() const { return m_uniforms; }
+	/**
+	 * @brief Gets the specialization constants declared by this shader
+	 *
+	 * @return A vector of constants, whose order matches that of SpecializationValues
+	 */
+	const inline std::vector<SpecializationConstant>& getSpecializationConstants() const {
+		return m_specConstants;
+	}
+	/**
+	 * @brief Gets the values each specialization constant takes when not overridden
+	 */
+	SpecializationValues getDefaultSpecialization() const;
 	const inline std::array<VkPipelineShaderStageCreateInfo, 2>& getShaderStages() const {
 		return m_shaderStages;
 	}
 	const inline std::string& getName() const { return m_name; }
 
+	/**
+	 * @brief Reads a compiled shader (or any other binary file) into memory
+	 */
+	static std::vector<char> readFile(const std::string& filename);
+
   private:
-	std::vector<char> readFile(const std::string& filename);
 	VkShaderModule createShaderModule(const std::vector<char>& code);
 
   private:
@@ -89,6 +192,7 @@ class Shader {
 
 	PipelineDescriptor m_pushConstant;
 	std::vector<PipelineDescriptor> m_uniforms;
+	std::vector<SpecializationConstant> m_specConstants;
 	const std::string m_name;
 
 	std::array<VkPipelineShaderStageCreateInfo, 2> m_shaderStages;
@@ -96,4 +200,5 @@ class Shader {
 
 	static std::unordered_map<std::string, PipelineDescriptor> s_pushConstantMap;
 	static std::unordered_map<std::string, std::vector<PipelineDescriptor>> s_uniformMap;
+	static std::unordered_map<std::string, std::vector<SpecializationConstant>> s_specConstantMap;
 };
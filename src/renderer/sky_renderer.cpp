@@ -0,0 +1,639 @@
+#include "sky_renderer.hpp"
+
+#include <array>
+#include <stdexcept>
+#include <vector>
+
+#include <glm/gtc/packing.hpp>
+
+#include "renderer/atmosphere_integrator.hpp"
+#include "renderer/texture_lib.hpp"
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+
+// Optical depth changes fastest with the angle to the zenith, near the horizon, so the table is
+// wider than it is tall
+static const glm::uvec2 OPTICAL_DEPTH_LUT_SIZE = {256, 64};
+// The sky has little high frequency detail, so a small table upsamples to any resolution
+static const glm::uvec2 SKY_VIEW_LUT_SIZE = {192, 108};
+// Size of each face of the sky cubemap. A little finer than the sky-view table it is resampled from
+static const glm::uvec2 SKY_CUBE_SIZE = {128, 128};
+static const uint32_t CUBE_FACES = 6;
+// Threads per workgroup of the bake shaders and the low resolution sky, along each axis
+static const uint32_t LUT_GROUP_SIZE = 8;
+// Furthest the sun may move, in radians, before texels of the sky-view table marched for its old
+// position are thrown away rather than updated a subset at a time
+static const float MAX_HISTORY_SUN_ANGLE = 0.03f;
+// Directions the analytic sky is compared to the integrated one over, by azimuth and elevation
+static const glm::uvec2 COMPARE_GRID_SIZE = {64, 32};
+
+/**
+ * @brief Sets a parameter tables are baked with
+ *
+ * @return Whether the value changed, and so the table has to be baked again
+ */
+template <typename T> static bool setParam(T& param, const T& value) {
+	if (param == value) {
+		return false;
+	}
+
+	param = value;
+	return true;
+}
+
+SkyRenderer::SkyRenderer(Ref<VulkanDevice> device, Ref<BindlessTextureTable> textureTable,
+                         Ref<GpuProfiler> profiler)
+	: m_device(device), m_textureTable(textureTable), m_profiler(profiler) {
+	// The table is sampled linearly, which R32_SFLOAT doesn't have to support. Without it, the
+	// table is kept at half precision, which always filters. optical_depth.comp only writes r32f,
+	// so a half precision table is baked on the CPU
+	m_opticalDepthFormat = m_device->findSupportedFormat(
+		{VK_FORMAT_R32_SFLOAT, VK_FORMAT_R16_SFLOAT}, VK_IMAGE_TILING_OPTIMAL,
+		VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+	bool bakeOnGpu = m_opticalDepthFormat == VK_FORMAT_R32_SFLOAT;
+	// Copied into when baked on the CPU, see bakeOpticalDepthOnCPU
+	m_opticalDepthLUT = CreateRef<Texture>(
+		m_device, OPTICAL_DEPTH_LUT_SIZE, m_opticalDepthFormat,
+		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+			(bakeOnGpu ? VK_IMAGE_USAGE_STORAGE_BIT : 0));
+	m_skyViewLUT =
+		CreateRef<Texture>(m_device, SKY_VIEW_LUT_SIZE, VK_FORMAT_R16G16B16A16_SFLOAT,
+	                       VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+	TextureLibrary::get()->registerTexture(m_opticalDepthLUT);
+	TextureLibrary::get()->registerTexture(m_skyViewLUT);
+	m_skyViewParams.opticalDepthLUT = m_opticalDepthLUT->getIndex();
+	// Sized for the swapchain on first use
+	m_lowResSky =
+		CreateRef<Texture>(m_device, glm::uvec2(1, 1), VK_FORMAT_R16G16B16A16_SFLOAT,
+	                       VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+	TextureLibrary::get()->registerTexture(m_lowResSky);
+	m_skyCube = CreateRef<Texture>(m_device, SKY_CUBE_SIZE, VK_FORMAT_R16G16B16A16_SFLOAT,
+	                               VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+	                               TEXTURE_TYPE_CUBE);
+	TextureLibrary::get()->registerTexture(m_skyCube);
+	m_cubeParams.skyViewLUT = m_skyViewLUT->getIndex();
+	m_lowResParams.skyCube = m_skyCube->getIndex();
+
+	createDescriptorSetLayouts();
+	createDepthSampler();
+	if (bakeOnGpu) {
+		m_opticalDepthSet = createDescriptorSet(*m_opticalDepthLUT);
+	}
+	m_skyViewSet = createDescriptorSet(*m_skyViewLUT);
+	m_cubeSet = createDescriptorSet(*m_skyCube);
+	m_lowResSet = m_device->getDescriptorAllocator().allocate(m_lowResLayout,
+	                                                          DESCRIPTOR_CLASS_GENERAL);
+	createCompareBuffers();
+	m_compareParams.gridWidth = COMPARE_GRID_SIZE.x;
+	m_compareParams.gridHeight = COMPARE_GRID_SIZE.y;
+
+	if (!bakeOnGpu) {
+		LOG_WARN("R32_SFLOAT can't be filtered linearly, baking the optical depth LUT at half "
+		         "precision on the CPU");
+		m_cpuIntegrator = CreateScopedRef<AtmosphereIntegrator>();
+	} else {
+		try {
+			m_opticalDepthPipeline = CreateScopedRef<ComputePipeline>(
+				m_device, "optical_depth", std::vector<VkDescriptorSetLayout> {m_layout},
+				sizeof(OpticalDepthConstants));
+		} catch (const std::runtime_error& e) {
+			LOG_WARN("Can't bake the optical depth LUT on the GPU ({0}), baking it on the CPU",
+			         e.what());
+			m_cpuIntegrator = CreateScopedRef<AtmosphereIntegrator>();
+		}
+	}
+	// The sky-view bake samples the optical depth table through the bindless table
+	m_skyViewPipeline = CreateScopedRef<ComputePipeline>(
+		m_device, "sky_view",
+		std::vector<VkDescriptorSetLayout> {m_layout, m_textureTable->getLayout()},
+		sizeof(SkyViewConstants));
+	m_cubePipeline = CreateScopedRef<ComputePipeline>(
+		m_device, "sky_cubemap",
+		std::vector<VkDescriptorSetLayout> {m_layout, m_textureTable->getLayout()},
+		sizeof(SkyCubeConstants));
+	m_lowResPipeline = CreateScopedRef<ComputePipeline>(
+		m_device, "sky_lowres",
+		std::vector<VkDescriptorSetLayout> {m_lowResLayout, m_textureTable->getLayout()},
+		sizeof(LowResSkyConstants));
+	m_comparePipeline = CreateScopedRef<ComputePipeline>(
+		m_device, "sky_compare",
+		std::vector<VkDescriptorSetLayout> {m_compareLayout, m_textureTable->getLayout()},
+		sizeof(SkyCompareConstants));
+}
+
+SkyRenderer::~SkyRenderer() {
+	m_device->getDescriptorAllocator().free(m_opticalDepthSet);
+	m_device->getDescriptorAllocator().free(m_skyViewSet);
+	m_device->getDescriptorAllocator().free(m_cubeSet);
+	m_device->getDescriptorAllocator().free(m_lowResSet);
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		m_device->getDescriptorAllocator().free(m_compareSets[i]);
+		vkDestroyBuffer(m_device->getLogicalDevice(), m_compareBuffers[i], nullptr);
+		vkFreeMemory(m_device->getLogicalDevice(), m_compareBuffersMemory[i], nullptr);
+	}
+	vkDestroyDescriptorSetLayout(m_device->getLogicalDevice(), m_layout, nullptr);
+	vkDestroyDescriptorSetLayout(m_device->getLogicalDevice(), m_lowResLayout, nullptr);
+	vkDestroyDescriptorSetLayout(m_device->getLogicalDevice(), m_compareLayout, nullptr);
+	vkDestroySampler(m_device->getLogicalDevice(), m_depthSampler, nullptr);
+}
+
+void SkyRenderer::setAtmosphere(const Atmosphere& atmosphere) {
+	// Deliberately not short circuiting, every parameter has to be set
+	bool shapeChanged = setParam(m_opticalDepthParams.radius, atmosphere.radius) |
+	                    setParam(m_opticalDepthParams.offsetFactor, atmosphere.offsetFactor) |
+	                    setParam(m_opticalDepthParams.densityFalloff, atmosphere.densityFalloff);
+	m_opticalDepthDirty |= shapeChanged;
+
+	m_skyViewParams.radius = atmosphere.radius;
+	m_skyViewParams.offsetFactor = atmosphere.offsetFactor;
+	m_skyViewParams.densityFalloff = atmosphere.densityFalloff;
+	m_lowResParams.center = atmosphere.center;
+	m_lowResParams.radius = atmosphere.radius;
+	m_lowResParams.offsetFactor = atmosphere.offsetFactor;
+	m_compareParams.center = atmosphere.center;
+	m_compareParams.radius = atmosphere.radius;
+	m_compareParams.defractionCoef = atmosphere.defractionCoef;
+	m_compareParams.offsetFactor = atmosphere.offsetFactor;
+	m_compareParams.densityFalloff = atmosphere.densityFalloff;
+	m_skyViewDirty |= shapeChanged | setParam(m_skyViewParams.center, atmosphere.center) |
+	                  setParam(m_skyViewParams.defractionCoef, atmosphere.defractionCoef);
+}
+
+void SkyRenderer::setSunPosition(const glm::vec3& sunPos) {
+	m_sunMoved |= setParam(m_skyViewParams.sunPos, sunPos);
+	m_cubeParams.sunPos = sunPos;
+}
+
+void SkyRenderer::setOpticalDepthSamples(uint32_t numSamples) {
+	m_opticalDepthDirty |= setParam(m_opticalDepthParams.numSamples, numSamples);
+}
+
+void SkyRenderer::setInScatteringSamples(uint32_t numSamples) {
+	m_skyViewDirty |= setParam(m_skyViewParams.numInScatteringPoints, numSamples);
+}
+
+void SkyRenderer::setTemporalSkyView(bool enabled) {
+	// Don't leave the table half updated
+	m_skyViewDirty |= !enabled && m_skyViewPendingSubsets > 0;
+	m_temporalSkyView = enabled;
+}
+
+void SkyRenderer::setSkyViewDivisor(uint32_t divisor) {
+	if (divisor == 0 || SKY_VIEW_LUT_SIZE.y % divisor != 0 || SKY_VIEW_LUT_SIZE.x % divisor != 0) {
+		LOG_WARN("Unsupported sky-view LUT divisor {0}, baking at full resolution", divisor);
+		divisor = 1;
+	}
+	m_skyViewDivisor = divisor;
+}
+
+void SkyRenderer::setLowResScale(uint32_t scale) {
+	if (scale != 1 && scale != 2 && scale != 4) {
+		LOG_WARN("Unsupported sky scale 1/{0}, drawing the sky at full resolution", scale);
+		scale = 1;
+	}
+	m_lowResParams.scale = scale;
+}
+
+void SkyRenderer::update(CommandEncoder& encoder, uint32_t currentFrame) {
+	readModelCompare(currentFrame);
+	// Dirty flags are kept, so the tables are baked again once they are used again
+	if (m_model == SKY_MODEL_ANALYTIC) {
+		return;
+	}
+
+	updateLUTs(encoder, currentFrame);
+	updateCubemap(encoder, currentFrame);
+	if (m_compareGeneration != m_skyViewGeneration) {
+		recordModelCompare(encoder, currentFrame);
+	}
+}
+
+void SkyRenderer::updateLUTs(CommandEncoder& encoder, uint32_t currentFrame) {
+	if (m_sunMoved) {
+		if (m_temporalSkyView && m_skyViewBaked && isSkyViewHistoryValid()) {
+			m_skyViewPendingSubsets = SKY_VIEW_SUBSETS;
+		} else {
+			m_skyViewDirty = true;
+		}
+		m_sunMoved = false;
+	}
+	bool resize = m_skyViewLUT->getSize() != SKY_VIEW_LUT_SIZE / m_skyViewDivisor;
+	if (!resize && !m_opticalDepthDirty && !m_skyViewDirty && m_skyViewPendingSubsets == 0) {
+		return;
+	}
+
+	PROFILE_FUNC();
+	if (resize) {
+		resizeSkyView();
+	}
+
+	if (m_opticalDepthDirty) {
+		if (m_cpuIntegrator) {
+			bakeOpticalDepthOnCPU();
+		} else {
+			uint32_t scope = m_profiler->beginScope(encoder, "Optical depth LUT bake",
+			                                        currentFrame, SKY_PROFILER_GROUP);
+			m_opticalDepthPipeline->bind(encoder);
+			m_opticalDepthPipeline->pushConstant(encoder, m_opticalDepthParams);
+			recordBake(encoder, *m_opticalDepthPipeline, *m_opticalDepthLUT, m_opticalDepthBaked,
+			           1, &m_opticalDepthSet.set);
+			m_profiler->endScope(encoder, scope, currentFrame);
+		}
+		m_bakeCount++;
+
+		LOG_TRACE("Baked optical depth LUT ({0} samples per texel)",
+		          m_opticalDepthParams.numSamples);
+		m_opticalDepthDirty = false;
+		m_opticalDepthBaked = true;
+		// The sky is marched through the optical depth table
+		m_skyViewDirty = true;
+	}
+
+	std::array<VkDescriptorSet, 2> sets = {m_skyViewSet.set, m_textureTable->getDescriptorSet()};
+	glm::vec3 sunDir = glm::normalize(m_skyViewParams.sunPos);
+	if (m_skyViewDirty) {
+		uint32_t scope = m_profiler->beginScope(encoder, "Sky-view LUT bake", currentFrame,
+		                                        SKY_PROFILER_GROUP);
+		m_skyViewParams.subsetStride = 1;
+		m_skyViewParams.subsetPhase = 0;
+		m_skyViewPipeline->bind(encoder);
+		m_skyViewPipeline->pushConstant(encoder, m_skyViewParams);
+		recordBake(encoder, *m_skyViewPipeline, *m_skyViewLUT, m_skyViewBaked, sets.size(),
+		           sets.data());
+		m_profiler->endScope(encoder, scope, currentFrame);
+		m_bakeCount++;
+
+		m_subsetSunDirs.fill(sunDir);
+		m_skyViewGeneration++;
+		m_skyViewPendingSubsets = 0;
+		m_skyViewDirty = false;
+		m_skyViewBaked = true;
+	} else if (m_skyViewPendingSubsets > 0) {
+		uint32_t scope = m_profiler->beginScope(encoder, "Sky-view LUT update (1/4 of texels)",
+		                                        currentFrame, SKY_PROFILER_GROUP);
+		m_skyViewParams.subsetStride = SKY_VIEW_SUBSET_STRIDE;
+		m_skyViewParams.subsetPhase = m_skyViewNextSubset;
+		m_skyViewPipeline->bind(encoder);
+		m_skyViewPipeline->pushConstant(encoder, m_skyViewParams);
+		recordBake(encoder, *m_skyViewPipeline, *m_skyViewLUT, m_skyViewBaked, sets.size(),
+		           sets.data(), SKY_VIEW_SUBSET_STRIDE);
+		m_profiler->endScope(encoder, scope, currentFrame);
+		m_bakeCount++;
+
+		m_subsetSunDirs[m_skyViewNextSubset] = sunDir;
+		m_skyViewGeneration++;
+		m_skyViewNextSubset = (m_skyViewNextSubset + 1) % SKY_VIEW_SUBSETS;
+		m_skyViewPendingSubsets--;
+	}
+}
+
+void SkyRenderer::resizeSkyView() {
+	glm::uvec2 size = SKY_VIEW_LUT_SIZE / m_skyViewDivisor;
+	LOG_TRACE("Resizing sky-view LUT to {0}x{1}", size.x, size.y);
+
+	// Frames in flight may still be sampling the old table
+	m_device->flush();
+	m_skyViewLUT->resize(size);
+	m_textureTable->rewrite(*m_skyViewLUT);
+	writeStorageImage(m_skyViewSet.set, *m_skyViewLUT);
+	m_skyViewBaked = false;
+	m_skyViewDirty = true;
+}
+
+void SkyRenderer::updateCubemap(CommandEncoder& encoder, uint32_t currentFrame) {
+	if (m_cubeGeneration != m_skyViewGeneration) {
+		m_cubeGeneration = m_skyViewGeneration;
+		m_cubeStaleFaces = CUBE_FACES;
+	}
+	if (m_cubeStaleFaces == 0) {
+		return;
+	}
+
+	PROFILE_FUNC();
+	// Until every face has been baked once, the rest would be sampled uninitialized
+	bool wholeCube = !m_spreadCubeBake || !m_cubeBaked;
+	uint32_t faceCount = wholeCube ? CUBE_FACES : 1;
+	if (wholeCube) {
+		m_cubeNextFace = 0;
+	}
+	uint32_t scope = m_profiler->beginScope(
+		encoder, faceCount == 1 ? "Sky cubemap bake (1 face)" : "Sky cubemap bake", currentFrame,
+		SKY_PROFILER_GROUP);
+	std::array<VkDescriptorSet, 2> sets = {m_cubeSet.set, m_textureTable->getDescriptorSet()};
+	m_cubeParams.firstFace = m_cubeNextFace;
+	m_cubePipeline->bind(encoder);
+	m_cubePipeline->pushConstant(encoder, m_cubeParams);
+	recordBake(encoder, *m_cubePipeline, *m_skyCube, m_cubeBaked, sets.size(), sets.data(), 1,
+	           faceCount);
+	m_profiler->endScope(encoder, scope, currentFrame);
+
+	m_cubeNextFace = (m_cubeNextFace + faceCount) % CUBE_FACES;
+	m_cubeStaleFaces = wholeCube ? 0 : m_cubeStaleFaces - 1;
+	m_cubeBaked = true;
+}
+
+void SkyRenderer::recordModelCompare(CommandEncoder& encoder, uint32_t currentFrame) {
+	PROFILE_FUNC();
+	// Not in the sky's group, it only measures the sky and would skew its budget
+	uint32_t scope = m_profiler->beginScope(encoder, "Sky model compare", currentFrame);
+	// Against the current sun, so while the table is updated in subsets, the lag of its older
+	// texels counts towards the difference
+	m_compareParams.sunPos = m_skyViewParams.sunPos;
+	m_compareParams.skyViewLUT = m_skyViewLUT->getIndex();
+	std::array<VkDescriptorSet, 2> sets = {m_compareSets[currentFrame].set,
+	                                       m_textureTable->getDescriptorSet()};
+	m_comparePipeline->bind(encoder);
+	m_comparePipeline->bindDescriptorSets(encoder, sets.size(), sets.data());
+	m_comparePipeline->pushConstant(encoder, m_compareParams);
+	glm::uvec2 groups = (COMPARE_GRID_SIZE + LUT_GROUP_SIZE - 1u) / LUT_GROUP_SIZE;
+	encoder.dispatch(groups.x, groups.y, 1);
+
+	encoder.memoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+	                      VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+	m_profiler->endScope(encoder, scope, currentFrame);
+
+	m_compareGeneration = m_skyViewGeneration;
+	m_frameCompareGenerations[currentFrame] = m_skyViewGeneration;
+	m_comparePending[currentFrame] = true;
+}
+
+void SkyRenderer::readModelCompare(uint32_t currentFrame) {
+	if (!m_comparePending[currentFrame]) {
+		return;
+	}
+	m_comparePending[currentFrame] = false;
+
+	double errorSq = 0.0;
+	double referenceSq = 0.0;
+	uint32_t skyCount = 0;
+	const glm::vec4* results = m_compareBuffersMapped[currentFrame];
+	for (uint32_t i = 0; i < COMPARE_GRID_SIZE.x * COMPARE_GRID_SIZE.y; i++) {
+		if (results[i].z > 0.0f) {
+			errorSq += results[i].x;
+			referenceSq += results[i].y;
+			skyCount++;
+		}
+	}
+	if (skyCount == 0) {
+		return;
+	}
+
+	m_modelDelta.rmse = static_cast<float>(glm::sqrt(errorSq / skyCount));
+	m_modelDelta.relativeError =
+		referenceSq > 0.0 ? static_cast<float>(glm::sqrt(errorSq / referenceSq)) : 0.0f;
+	m_modelDelta.measured = true;
+	m_deltaGeneration = m_frameCompareGenerations[currentFrame];
+}
+
+SkyModelDelta SkyRenderer::getModelDelta() const {
+	SkyModelDelta delta = m_modelDelta;
+	// Changes to the sky only show up in the generation once they are baked, which they aren't
+	// while the sky is analytic
+	bool skyChanged = m_opticalDepthDirty || m_skyViewDirty || m_sunMoved ||
+	                  m_skyViewPendingSubsets > 0 ||
+	                  m_skyViewLUT->getSize() != SKY_VIEW_LUT_SIZE / m_skyViewDivisor;
+	delta.current = delta.measured && m_deltaGeneration == m_skyViewGeneration && !skyChanged;
+	return delta;
+}
+
+bool SkyRenderer::isSkyViewHistoryValid() const {
+	glm::vec3 sunDir = glm::normalize(m_skyViewParams.sunPos);
+	float minCos = glm::cos(MAX_HISTORY_SUN_ANGLE);
+	for (const glm::vec3& subsetSunDir : m_subsetSunDirs) {
+		// Also false if either direction is NaN, i.e. the sun is at the eye
+		if (!(glm::dot(sunDir, subsetSunDir) >= minCos)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void SkyRenderer::recordBake(CommandEncoder& encoder, ComputePipeline& pipeline,
+                             const Texture& lut, bool baked, uint32_t setCount,
+                             const VkDescriptorSet* sets, uint32_t subsetStride,
+                             uint32_t layerCount) {
+	// Earlier frames may still be sampling the table, so wait for them before writing over it
+	encoder.imageBarrier(
+		lut.getImage(),
+		baked ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_GENERAL,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+	pipeline.bindDescriptorSets(encoder, setCount, sets);
+	glm::uvec2 texels = (lut.getSize() + subsetStride - 1u) / subsetStride;
+	glm::uvec2 groups = (texels + LUT_GROUP_SIZE - 1u) / LUT_GROUP_SIZE;
+	encoder.dispatch(groups.x, groups.y, layerCount);
+
+	// Read by later passes as well as the atmosphere pass
+	encoder.imageBarrier(
+		lut.getImage(), VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_ACCESS_SHADER_READ_BIT);
+}
+
+void SkyRenderer::bakeOpticalDepthOnCPU() {
+	PROFILE_FUNC();
+	Atmosphere shape {};
+	shape.radius = m_opticalDepthParams.radius;
+	shape.offsetFactor = m_opticalDepthParams.offsetFactor;
+	shape.densityFalloff = m_opticalDepthParams.densityFalloff;
+	std::vector<float> texels = m_cpuIntegrator->bakeOpticalDepth(
+		shape, m_opticalDepthLUT->getSize(), m_opticalDepthParams.numSamples);
+
+	// Earlier frames may still be sampling the table
+	m_device->flush();
+	if (m_opticalDepthFormat == VK_FORMAT_R16_SFLOAT) {
+		std::vector<uint16_t> halfTexels(texels.size());
+		for (size_t i = 0; i < texels.size(); i++) {
+			halfTexels[i] = glm::packHalf1x16(texels[i]);
+		}
+		m_opticalDepthLUT->upload(halfTexels.data(), halfTexels.size() * sizeof(uint16_t));
+	} else {
+		m_opticalDepthLUT->upload(texels.data(), texels.size() * sizeof(float));
+	}
+}
+
+void SkyRenderer::recordLowResSky(CommandEncoder& encoder, const VulkanSwapChain& swapChain,
+                                  const glm::mat4& viewProj, uint32_t currentFrame) {
+	if (m_lowResParams.scale == 1 || m_model == SKY_MODEL_ANALYTIC) {
+		return;
+	}
+
+	PROFILE_FUNC();
+	const VkExtent2D& extent = swapChain.getExtent();
+	if (extent.width != m_lowResExtent.width || extent.height != m_lowResExtent.height ||
+	    swapChain.getGeneration() != m_lowResGeneration ||
+	    m_lowResParams.scale != m_lowResTargetScale) {
+		resizeLowResSky(swapChain);
+	}
+
+	m_lowResParams.invViewProj = glm::inverse(viewProj);
+	uint32_t scope = m_profiler->beginScope(encoder, "Low res sky (" + getLowResScaleName() + ")",
+	                                        currentFrame, SKY_PROFILER_GROUP);
+	std::array<VkDescriptorSet, 2> sets = {m_lowResSet.set, m_textureTable->getDescriptorSet()};
+	m_lowResPipeline->bind(encoder);
+	m_lowResPipeline->pushConstant(encoder, m_lowResParams);
+	recordBake(encoder, *m_lowResPipeline, *m_lowResSky, m_lowResBaked, sets.size(),
+	           sets.data());
+	m_profiler->endScope(encoder, scope, currentFrame);
+	m_lowResBaked = true;
+}
+
+void SkyRenderer::resizeLowResSky(const VulkanSwapChain& swapChain) {
+	const VkExtent2D& extent = swapChain.getExtent();
+	glm::uvec2 size = (glm::uvec2(extent.width, extent.height) + m_lowResParams.scale - 1u) /
+	                  m_lowResParams.scale;
+	LOG_TRACE("Resizing low resolution sky to {0}x{1}", size.x, size.y);
+
+	// The old image, and the sets pointing at it, may still be in use by frames in flight
+	m_device->flush();
+	m_lowResSky->resize(size);
+	m_textureTable->rewrite(*m_lowResSky);
+	m_lowResBaked = false;
+
+	std::array<VkDescriptorImageInfo, 2> imageInfos {};
+	imageInfos[0].imageView = m_lowResSky->getStorageView();
+	imageInfos[0].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	imageInfos[1].imageView = swapChain.getDepthImageView();
+	imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	imageInfos[1].sampler = m_depthSampler;
+
+	std::array<VkWriteDescriptorSet, 2> writes {};
+	for (uint32_t i = 0; i < writes.size(); i++) {
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = m_lowResSet.set;
+		writes[i].dstBinding = i;
+		writes[i].dstArrayElement = 0;
+		writes[i].descriptorCount = 1;
+		writes[i].pImageInfo = &imageInfos[i];
+	}
+	writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	vkUpdateDescriptorSets(m_device->getLogicalDevice(), writes.size(), writes.data(), 0,
+	                       nullptr);
+
+	m_lowResExtent = extent;
+	m_lowResGeneration = swapChain.getGeneration();
+	m_lowResTargetScale = m_lowResParams.scale;
+}
+
+void SkyRenderer::createDescriptorSetLayouts() {
+	VkDescriptorSetLayoutBinding binding {};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	binding.descriptorCount = 1;
+	binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &binding;
+
+	if (vkCreateDescriptorSetLayout(m_device->getLogicalDevice(), &layoutInfo, nullptr,
+	                                &m_layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create sky LUT descriptor set layout!");
+	}
+
+	// The low resolution sky also reads the depth of the geometry pass
+	std::array<VkDescriptorSetLayoutBinding, 2> lowResBindings = {binding, binding};
+	lowResBindings[1].binding = 1;
+	lowResBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	layoutInfo.bindingCount = static_cast<uint32_t>(lowResBindings.size());
+	layoutInfo.pBindings = lowResBindings.data();
+
+	if (vkCreateDescriptorSetLayout(m_device->getLogicalDevice(), &layoutInfo, nullptr,
+	                                &m_lowResLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create low resolution sky descriptor set layout!");
+	}
+
+	// The comparison writes its results to a buffer
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &binding;
+
+	if (vkCreateDescriptorSetLayout(m_device->getLogicalDevice(), &layoutInfo, nullptr,
+	                                &m_compareLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create sky comparison descriptor set layout!");
+	}
+}
+
+void SkyRenderer::createDepthSampler() {
+	VkSamplerCreateInfo samplerInfo {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.maxLod = 0.0f;
+
+	if (vkCreateSampler(m_device->getLogicalDevice(), &samplerInfo, nullptr, &m_depthSampler) !=
+	    VK_SUCCESS) {
+		throw std::runtime_error("failed to create depth sampler!");
+	}
+}
+
+void SkyRenderer::createCompareBuffers() {
+	VkDeviceSize size = COMPARE_GRID_SIZE.x * COMPARE_GRID_SIZE.y * sizeof(glm::vec4);
+
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		// Read back on the CPU, so kept host visible and mapped
+		m_device->createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+		                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		                       m_compareBuffers[i], m_compareBuffersMemory[i]);
+
+		void* mapped;
+		vkMapMemory(m_device->getLogicalDevice(), m_compareBuffersMemory[i], 0, size, 0, &mapped);
+		m_compareBuffersMapped[i] = static_cast<glm::vec4*>(mapped);
+
+		m_compareSets[i] =
+			m_device->getDescriptorAllocator().allocate(m_compareLayout, DESCRIPTOR_CLASS_GENERAL);
+
+		VkDescriptorBufferInfo bufferInfo {};
+		bufferInfo.buffer = m_compareBuffers[i];
+		bufferInfo.offset = 0;
+		bufferInfo.range = VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet write {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = m_compareSets[i].set;
+		write.dstBinding = 0;
+		write.dstArrayElement = 0;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write.descriptorCount = 1;
+		write.pBufferInfo = &bufferInfo;
+
+		vkUpdateDescriptorSets(m_device->getLogicalDevice(), 1, &write, 0, nullptr);
+	}
+}
+
+DescriptorAllocation SkyRenderer::createDescriptorSet(const Texture& lut) {
+	DescriptorAllocation allocation =
+		m_device->getDescriptorAllocator().allocate(m_layout, DESCRIPTOR_CLASS_GENERAL);
+	writeStorageImage(allocation.set, lut);
+	return allocation;
+}
+
+void SkyRenderer::writeStorageImage(VkDescriptorSet set, const Texture& lut) {
+	// Tables are only ever written while in the general layout
+	VkDescriptorImageInfo imageInfo {};
+	imageInfo.imageView = lut.getStorageView();
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	VkWriteDescriptorSet write {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = 0;
+	write.dstArrayElement = 0;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	write.descriptorCount = 1;
+	write.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(m_device->getLogicalDevice(), 1, &write, 0, nullptr);
+}
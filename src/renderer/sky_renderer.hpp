@@ -0,0 +1,402 @@
+#pragma once
+
+#include <cstddef>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <glm/glm.hpp>
+#include <vulkan/vulkan_core.h>
+
+#include "bootstrap/command_encoder.hpp"
+#include "bootstrap/compute_pipeline.hpp"
+#include "bootstrap/descriptor_allocator.hpp"
+#include "bootstrap/device.hpp"
+#include "bootstrap/gpu_profiler.hpp"
+#include "bootstrap/swapchain.hpp"
+#include "bootstrap/texture_table.hpp"
+#include "renderer/atmosphere_integrator.hpp"
+#include "renderer/shader.hpp"
+#include "renderer/texture.hpp"
+#include "util/constants.hpp"
+#include "util/gpu_layout.hpp"
+#include "util/memory.hpp"
+
+// GPU profiler group of every scope timing work on the sky, see GpuProfiler::getGroupTime
+const char* const SKY_PROFILER_GROUP = "Sky";
+
+/* Push constant of optical_depth.comp */
+struct OpticalDepthConstants {
+	alignas(4) float radius = 0.0f;
+	alignas(4) float offsetFactor = 0.0f;
+	alignas(4) float densityFalloff = 0.0f;
+	/* Samples integrated along the ray of each texel */
+	alignas(4) uint32_t numSamples = 32;
+};
+static_assert(offsetof(OpticalDepthConstants, offsetFactor) == 4 &&
+              offsetof(OpticalDepthConstants, densityFalloff) == 8 &&
+              offsetof(OpticalDepthConstants, numSamples) == 12);
+GPU_LAYOUT(OpticalDepthConstants);
+
+/* Push constant of sky_view.comp */
+struct SkyViewConstants {
+	alignas(16) glm::vec3 center = glm::vec3(0.0f);
+	alignas(4) float radius = 0.0f;
+	alignas(16) glm::vec3 defractionCoef = glm::vec3(0.0f);
+	alignas(4) float offsetFactor = 0.0f;
+	/* The light is a point, so its position matters and not just its direction */
+	alignas(16) glm::vec3 sunPos = glm::vec3(0.0f);
+	alignas(4) float densityFalloff = 0.0f;
+	alignas(4) uint32_t opticalDepthLUT = INVALID_TEXTURE_INDEX;
+	/* Samples marched along the ray of each texel */
+	alignas(4) uint32_t numInScatteringPoints = 10;
+	/* Only one texel of each subsetStride x subsetStride block is marched, picked by the phase */
+	alignas(4) uint32_t subsetStride = 1;
+	alignas(4) uint32_t subsetPhase = 0;
+};
+static_assert(offsetof(SkyViewConstants, radius) == 12 &&
+              offsetof(SkyViewConstants, defractionCoef) == 16 &&
+              offsetof(SkyViewConstants, offsetFactor) == 28 &&
+              offsetof(SkyViewConstants, sunPos) == 32 &&
+              offsetof(SkyViewConstants, densityFalloff) == 44 &&
+              offsetof(SkyViewConstants, opticalDepthLUT) == 48 &&
+              offsetof(SkyViewConstants, numInScatteringPoints) == 52 &&
+              offsetof(SkyViewConstants, subsetStride) == 56 &&
+              offsetof(SkyViewConstants, subsetPhase) == 60);
+GPU_LAYOUT(SkyViewConstants);
+
+/* Push constant of sky_cubemap.comp */
+struct SkyCubeConstants {
+	alignas(16) glm::vec3 sunPos = glm::vec3(0.0f);
+	alignas(4) uint32_t skyViewLUT = INVALID_TEXTURE_INDEX;
+	/* First face baked by a dispatch, which covers one or more faces in order */
+	alignas(4) uint32_t firstFace = 0;
+};
+static_assert(offsetof(SkyCubeConstants, skyViewLUT) == 12 &&
+              offsetof(SkyCubeConstants, firstFace) == 16);
+GPU_LAYOUT(SkyCubeConstants);
+
+/* Push constant of sky_lowres.comp */
+struct LowResSkyConstants {
+	alignas(16) glm::mat4 invViewProj = glm::mat4(1.0f);
+	alignas(16) glm::vec3 center = glm::vec3(0.0f);
+	alignas(4) float radius = 0.0f;
+	alignas(4) float offsetFactor = 0.0f;
+	alignas(4) uint32_t skyCube = INVALID_TEXTURE_INDEX;
+	/* Screen pixels along each side of a texel */
+	alignas(4) uint32_t scale = 2;
+};
+static_assert(offsetof(LowResSkyConstants, center) == 64 &&
+              offsetof(LowResSkyConstants, radius) == 76 &&
+              offsetof(LowResSkyConstants, offsetFactor) == 80 &&
+              offsetof(LowResSkyConstants, skyCube) == 84 &&
+              offsetof(LowResSkyConstants, scale) == 88);
+GPU_LAYOUT(LowResSkyConstants);
+
+/* Push constant of sky_compare.comp */
+struct SkyCompareConstants {
+	alignas(16) glm::vec3 center = glm::vec3(0.0f);
+	alignas(4) float radius = 0.0f;
+	alignas(16) glm::vec3 defractionCoef = glm::vec3(0.0f);
+	alignas(4) float offsetFactor = 0.0f;
+	alignas(16) glm::vec3 sunPos = glm::vec3(0.0f);
+	alignas(4) float densityFalloff = 0.0f;
+	alignas(4) uint32_t skyViewLUT = INVALID_TEXTURE_INDEX;
+	/* Directions compared, by azimuth and elevation */
+	alignas(4) uint32_t gridWidth = 0;
+	alignas(4) uint32_t gridHeight = 0;
+};
+static_assert(offsetof(SkyCompareConstants, radius) == 12 &&
+              offsetof(SkyCompareConstants, defractionCoef) == 16 &&
+              offsetof(SkyCompareConstants, offsetFactor) == 28 &&
+              offsetof(SkyCompareConstants, sunPos) == 32 &&
+              offsetof(SkyCompareConstants, densityFalloff) == 44 &&
+              offsetof(SkyCompareConstants, skyViewLUT) == 48 &&
+              offsetof(SkyCompareConstants, gridWidth) == 52 &&
+              offsetof(SkyCompareConstants, gridHeight) == 56);
+GPU_LAYOUT(SkyCompareConstants);
+
+/* How far the analytic sky is from the integrated one, over directions which see sky */
+struct SkyModelDelta {
+	/* Root mean square difference in color */
+	float rmse = 0.0f;
+	/* The difference relative to the root mean square color of the integrated sky */
+	float relativeError = 0.0f;
+	/* Whether it has been measured at all, and whether that was for the sky as it is now */
+	bool measured = false;
+	bool current = false;
+};
+
+/**
+ * @class SkyRenderer
+ * @brief Bakes the lookup tables the atmosphere pass reads instead of integrating them per pixel
+ *
+ * The optical depth table holds the density of air integrated from a point to the edge of the
+ * atmosphere, by the point's height and the ray's angle to the zenith. It only depends on the
+ * shape of the atmosphere, so it is baked again only when that changes.
+ *
+ * The sky-view table holds the light scattered towards the eye from every direction, by elevation
+ * and azimuth relative to the sun. It is ray marched with the optical depth table at a fixed, low
+ * resolution, so the atmosphere pass costs a single lookup per pixel whatever the resolution of
+ * the screen. It is baked again whenever the atmosphere or the sun moves, at most once a frame.
+ * Optionally, small moves of the sun only march a quarter of its texels each frame, in turn, and
+ * the rest keep their last values. The table is indexed relative to the sun's azimuth, so only
+ * its elevation makes old texels wrong. If it moved too far since any of them were marched, the
+ * whole table is baked at once instead.
+ *
+ * Whenever the sky-view table changes, it is resampled into a cubemap, so drawing the sky takes a
+ * single fetch by direction. The cubemap is cached across frames, and is not touched while the
+ * sky stays put. Its faces can be baked one per frame to spread the cost out.
+ *
+ * The sky can also be drawn at a fraction of screen resolution, into a target of its own which
+ * the atmosphere pass upsamples. Each texel only averages the pixels showing sky, going by the
+ * depth of the geometry pass, so geometry and the ground don't bleed into the sky around them.
+ *
+ * If optical_depth.comp can't be loaded, the optical depth table is integrated on the CPU by an
+ * AtmosphereIntegrator instead, and copied in. That waits for the device to go idle, but the
+ * table rarely changes.
+ *
+ * Tables are registered with the TextureLibrary, so they are sampled through the bindless texture
+ * table.
+ *
+ * Alternatively, the atmosphere pass can work the sky out in closed form for each pixel, see
+ * SKY_MODEL_ANALYTIC. Nothing is baked or drawn here while it does. Whenever the integrated sky
+ * changes, the two models are compared over a grid of directions, and the difference read back a
+ * few frames later.
+ */
+class SkyRenderer {
+  public:
+	SkyRenderer(Ref<VulkanDevice> device, Ref<BindlessTextureTable> textureTable,
+	            Ref<GpuProfiler> profiler);
+	~SkyRenderer();
+
+	SkyRenderer(const SkyRenderer&) = delete;
+
+	/**
+	 * @brief Sets the atmosphere tables are baked for. Only tables depending on parameters which
+	 * changed are baked again
+	 */
+	void setAtmosphere(const Atmosphere& atmosphere);
+	void setSunPosition(const glm::vec3& sunPos);
+	/**
+	 * @brief Sets the number of samples integrated for each texel of the optical depth table
+	 */
+	void setOpticalDepthSamples(uint32_t numSamples);
+	/**
+	 * @brief Sets the number of samples marched for each texel of the sky-view table
+	 */
+	void setInScatteringSamples(uint32_t numSamples);
+	/**
+	 * @brief Sets whether the sky-view table is updated a quarter at a time while the sun moves,
+	 * rather than baked whole every frame
+	 */
+	void setTemporalSkyView(bool enabled);
+	/**
+	 * @brief Sets the resolution of the sky-view table, as a fraction of its full size. It is
+	 * created again on the next update, which waits for the device to go idle
+	 *
+	 * @param divisor 1 for full resolution, 2 for half along each axis
+	 */
+	void setSkyViewDivisor(uint32_t divisor);
+	/**
+	 * @brief Sets whether the sky cubemap is baked one face per frame rather than whole. The
+	 * first bake always covers every face
+	 */
+	inline void setSpreadCubemapBake(bool enabled) { m_spreadCubeBake = enabled; }
+	/**
+	 * @brief Marks every table out of date, so the next update bakes them all again. Each table
+	 * depends on the one before it, so this only has to mark the first
+	 */
+	inline void invalidate() { m_opticalDepthDirty = true; }
+	/**
+	 * @brief Records a bake of every table which is out of date, then of any faces of the sky
+	 * cubemap which are. Must be recorded outside of a render pass, before the atmosphere pass
+	 */
+	void update(CommandEncoder& encoder, uint32_t currentFrame);
+	/**
+	 * @brief Sets how the atmosphere pass works out the sky. While it is analytic, update() and
+	 * recordLowResSky() record nothing, and tables catch up once the model is switched back
+	 */
+	inline void setModel(SkyModel model) { m_model = model; }
+	inline SkyModel getModel() const { return m_model; }
+	/**
+	 * @brief Gets the last measured difference between the analytic and integrated sky
+	 */
+	SkyModelDelta getModelDelta() const;
+	/**
+	 * @brief Sets the fraction of screen resolution the sky is drawn at
+	 *
+	 * @param scale Screen pixels along each side of a texel of the sky: 1, 2, or 4. At 1 the
+	 * atmosphere pass reads the sky-view table directly
+	 */
+	void setLowResScale(uint32_t scale);
+	/**
+	 * @brief Records drawing the sky at low resolution, if enabled. Must be recorded outside of a
+	 * render pass, after the geometry pass and before the atmosphere pass
+	 *
+	 * The target is created again when the swapchain or scale changes, which waits for the device
+	 * to go idle.
+	 *
+	 * @param viewProj The camera the atmosphere pass draws from
+	 */
+	void recordLowResSky(CommandEncoder& encoder, const VulkanSwapChain& swapChain,
+	                     const glm::mat4& viewProj, uint32_t currentFrame);
+
+	inline SkyLUTs getLUTs() const {
+		return {m_opticalDepthLUT->getIndex(), m_skyViewLUT->getIndex(), m_lowResSky->getIndex(),
+		        m_lowResParams.scale, m_skyCube->getIndex(),
+		        static_cast<uint32_t>(m_model)};
+	}
+	inline uint32_t getLowResScale() const { return m_lowResParams.scale; }
+	/**
+	 * @brief Gets the resolution the sky is drawn at, i.e. "1/2", for labelling timings
+	 */
+	inline std::string getLowResScaleName() const {
+		return m_lowResParams.scale == 1 ? "full" : "1/" + std::to_string(m_lowResParams.scale);
+	}
+	/* Number of times any table has been baked */
+	inline uint32_t getBakeCount() const { return m_bakeCount; }
+
+  private:
+	void updateLUTs(CommandEncoder& encoder, uint32_t currentFrame);
+	void updateCubemap(CommandEncoder& encoder, uint32_t currentFrame);
+	/**
+	 * @brief Integrates the optical depth table on the CPU and copies it in, in place of a bake
+	 * by optical_depth.comp. Waits for the device to go idle
+	 */
+	void bakeOpticalDepthOnCPU();
+	/**
+	 * @brief Records evaluating the analytic sky over a grid of directions, and comparing it to
+	 * the sky-view table
+	 */
+	void recordModelCompare(CommandEncoder& encoder, uint32_t currentFrame);
+	/**
+	 * @brief Reads back the comparison last recorded in this frame, if any. Its fence must have
+	 * signalled
+	 */
+	void readModelCompare(uint32_t currentFrame);
+	void createDescriptorSetLayouts();
+	void createDepthSampler();
+	void createCompareBuffers();
+	/**
+	 * @brief Recreates the low resolution target for the given screen size and the current scale,
+	 * and points every descriptor reading or writing it at the new image
+	 */
+	void resizeLowResSky(const VulkanSwapChain& swapChain);
+	/**
+	 * @brief Allocates a set through which a compute shader writes the given table
+	 */
+	DescriptorAllocation createDescriptorSet(const Texture& lut);
+	void writeStorageImage(VkDescriptorSet set, const Texture& lut);
+	/**
+	 * @brief Creates the sky-view table again at the current divisor, and points every
+	 * descriptor reading or writing it at the new image
+	 */
+	void resizeSkyView();
+	/**
+	 * @brief Records a dispatch covering every texel of a table, between barriers making it
+	 * writable and then readable again
+	 *
+	 * @param baked Whether the table has been baked before, and so holds anything to wait on
+	 * @param subsetStride Only one texel of each block this wide is written, see SkyViewConstants
+	 * @param layerCount Layers written, one workgroup deep each
+	 */
+	void recordBake(CommandEncoder& encoder, ComputePipeline& pipeline, const Texture& lut,
+	                bool baked, uint32_t setCount, const VkDescriptorSet* sets,
+	                uint32_t subsetStride = 1, uint32_t layerCount = 1);
+	/**
+	 * @brief Whether every subset of the sky-view table was marched with the sun close enough to
+	 * where it is now to be kept
+	 */
+	bool isSkyViewHistoryValid() const;
+
+  private:
+	Ref<VulkanDevice> m_device;
+	Ref<BindlessTextureTable> m_textureTable;
+	Ref<GpuProfiler> m_profiler;
+
+	Ref<Texture> m_opticalDepthLUT;
+	/* R32_SFLOAT, or R16_SFLOAT where that can't be filtered linearly */
+	VkFormat m_opticalDepthFormat;
+	OpticalDepthConstants m_opticalDepthParams;
+	/* Whether the table needs to be baked again, and whether it has ever been */
+	bool m_opticalDepthDirty = true;
+	bool m_opticalDepthBaked = false;
+	/* Bakes the optical depth table when optical_depth.comp can't, null otherwise */
+	ScopedRef<AtmosphereIntegrator> m_cpuIntegrator;
+
+	Ref<Texture> m_skyViewLUT;
+	SkyViewConstants m_skyViewParams;
+	bool m_skyViewDirty = true;
+	bool m_skyViewBaked = false;
+	uint32_t m_skyViewDivisor = 1;
+	/* Sky-view texels are split into subsets of one texel per SKY_VIEW_SUBSET_STRIDE squared
+	 * block, marched in turn while temporal updates are on */
+	static const uint32_t SKY_VIEW_SUBSET_STRIDE = 2;
+	static const uint32_t SKY_VIEW_SUBSETS = SKY_VIEW_SUBSET_STRIDE * SKY_VIEW_SUBSET_STRIDE;
+	bool m_temporalSkyView = false;
+	/* Whether the sun moved since the last update, which may not require a whole bake */
+	bool m_sunMoved = false;
+	/* Subsets left to march before the table matches the current sun */
+	uint32_t m_skyViewPendingSubsets = 0;
+	uint32_t m_skyViewNextSubset = 0;
+	/* Direction of the sun when each subset was last marched */
+	std::array<glm::vec3, SKY_VIEW_SUBSETS> m_subsetSunDirs;
+	/* Counts changes to the sky-view table, so the cubemap can tell when it is out of date */
+	uint32_t m_skyViewGeneration = 0;
+
+	Ref<Texture> m_skyCube;
+	SkyCubeConstants m_cubeParams;
+	/* Generation of the sky-view table the cubemap was last baked from */
+	uint32_t m_cubeGeneration = UINT32_MAX;
+	bool m_cubeBaked = false;
+	bool m_spreadCubeBake = false;
+	/* Faces left to bake from the current sky-view table, in order from m_cubeNextFace */
+	uint32_t m_cubeStaleFaces = 0;
+	uint32_t m_cubeNextFace = 0;
+	DescriptorAllocation m_cubeSet;
+	ScopedRef<ComputePipeline> m_cubePipeline;
+
+	/* Layout shared by each table's set, a single storage image */
+	VkDescriptorSetLayout m_layout;
+	/* Allocated from the device's DescriptorAllocator */
+	DescriptorAllocation m_opticalDepthSet;
+	DescriptorAllocation m_skyViewSet;
+	ScopedRef<ComputePipeline> m_opticalDepthPipeline;
+	ScopedRef<ComputePipeline> m_skyViewPipeline;
+
+	/* Target of the low resolution sky. Its size follows the swapchain's extent and the scale */
+	Ref<Texture> m_lowResSky;
+	LowResSkyConstants m_lowResParams;
+	bool m_lowResBaked = false;
+	/* Swapchain the target was last sized for, to tell when it has to be created again */
+	VkExtent2D m_lowResExtent = {0, 0};
+	uint32_t m_lowResGeneration = UINT32_MAX;
+	uint32_t m_lowResTargetScale = 0;
+	/* A storage image, and the depth of the geometry pass */
+	VkDescriptorSetLayout m_lowResLayout;
+	DescriptorAllocation m_lowResSet;
+	/* Reads depth exactly, with no filtering */
+	VkSampler m_depthSampler;
+	ScopedRef<ComputePipeline> m_lowResPipeline;
+
+	SkyModel m_model = SKY_MODEL_INTEGRATED;
+	SkyCompareConstants m_compareParams;
+	/* Generation of the sky-view table last compared, overall and in each frame */
+	uint32_t m_compareGeneration = UINT32_MAX;
+	std::array<uint32_t, MAX_FRAMES_IN_FLIGHT> m_frameCompareGenerations;
+	/* Whether each frame recorded a comparison which has not been read back yet */
+	std::array<bool, MAX_FRAMES_IN_FLIGHT> m_comparePending {};
+	/* Host visible, one result per direction */
+	std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> m_compareBuffers;
+	std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> m_compareBuffersMemory;
+	std::array<glm::vec4*, MAX_FRAMES_IN_FLIGHT> m_compareBuffersMapped;
+	/* A single storage buffer */
+	VkDescriptorSetLayout m_compareLayout;
+	std::array<DescriptorAllocation, MAX_FRAMES_IN_FLIGHT> m_compareSets;
+	ScopedRef<ComputePipeline> m_comparePipeline;
+	SkyModelDelta m_modelDelta;
+	/* Generation of the sky-view table m_modelDelta was measured against */
+	uint32_t m_deltaGeneration = UINT32_MAX;
+
+	uint32_t m_bakeCount = 0;
+};
@@ -26,13 +26,85 @@ Texture::Texture(Ref<VulkanDevice> device, const glm::uvec2& size, VkFormat imag
 	m_imageView = m_device->createImageView(m_image, imageFormat, type);
 }
 
+Texture::Texture(Ref<VulkanDevice> device, const glm::uvec2& size, VkFormat imageFormat,
+                 VkImageUsageFlags usage, TextureType type)
+	: m_device(device), m_size(size), m_numChannels(4), m_format(imageFormat), m_usage(usage),
+	  m_type(type) {
+	createEmptyImage();
+}
+
+Texture::Texture(Ref<VulkanDevice> device, const glm::uvec3& size, VkFormat imageFormat,
+                 const void* texels, VkDeviceSize texelsSize)
+	: m_device(device), m_size(size.x, size.y), m_depth(size.z), m_format(imageFormat),
+	  m_type(TEXTURE_TYPE_3D) {
+	createVolumeImage(texels, texelsSize);
+	m_imageView = m_device->createImageView(m_image, m_format, VK_IMAGE_ASPECT_COLOR_BIT,
+	                                        VK_IMAGE_VIEW_TYPE_3D);
+}
+
 Texture::Texture(std::string path, Ref<VulkanDevice> device) : m_device(device) {
 	createTextureImage(path);
 	m_imageView =
 		m_device->createImageView(m_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
 }
 
-Texture::~Texture() {
+void Texture::resize(const glm::uvec2& size) {
+	if (m_usage == 0) {
+		throw std::runtime_error("failed to resize texture, it was not created empty!");
+	}
+
+	destroyImage();
+	m_size = size;
+	createEmptyImage();
+}
+
+void Texture::upload(const void* texels, VkDeviceSize texelsSize) {
+	if (!(m_usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+		throw std::runtime_error("failed to upload texture, it can't be copied into!");
+	}
+
+	uploadTexels(texels, texelsSize);
+}
+
+Texture::~Texture() { destroyImage(); }
+
+void Texture::createEmptyImage() {
+	if (m_type == TEXTURE_TYPE_2D) {
+		m_device->createImage(m_size.x, m_size.y, m_format, VK_IMAGE_TILING_OPTIMAL, m_usage,
+		                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_image, m_imageMemory);
+		m_imageView = m_device->createImageView(m_image, m_format, VK_IMAGE_ASPECT_COLOR_BIT);
+		return;
+	}
+
+	VkImageCreateInfo imageInfo {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent = {m_size.x, m_size.y, 1};
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 6;
+	imageInfo.format = m_format;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = m_usage;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	m_device->createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_image,
+	                      m_imageMemory);
+
+	m_imageView = m_device->createImageView(m_image, m_format, VK_IMAGE_ASPECT_COLOR_BIT,
+	                                        VK_IMAGE_VIEW_TYPE_CUBE, 6);
+	if (m_usage & VK_IMAGE_USAGE_STORAGE_BIT) {
+		m_storageView = m_device->createImageView(m_image, m_format, VK_IMAGE_ASPECT_COLOR_BIT,
+		                                          VK_IMAGE_VIEW_TYPE_2D_ARRAY, 6);
+	}
+}
+
+void Texture::destroyImage() {
+	if (m_storageView != VK_NULL_HANDLE) {
+		vkDestroyImageView(m_device->getLogicalDevice(), m_storageView, nullptr);
+		m_storageView = VK_NULL_HANDLE;
+	}
 	vkDestroyImageView(m_device->getLogicalDevice(), m_imageView, nullptr);
 	vkDestroyImage(m_device->getLogicalDevice(), m_image, nullptr);
 	vkFreeMemory(m_device->getLogicalDevice(), m_imageMemory, nullptr);
@@ -84,6 +156,47 @@ void Texture::createTextureImage(std::string path) {
 	vkFreeMemory(m_device->getLogicalDevice(), stagingBufferMemory, nullptr);
 }
 
+void Texture::createVolumeImage(const void* texels, VkDeviceSize texelsSize) {
+	VkImageCreateInfo imageInfo {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_3D;
+	imageInfo.extent = {m_size.x, m_size.y, m_depth};
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.format = m_format;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	m_device->createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_image,
+	                      m_imageMemory);
+
+	uploadTexels(texels, texelsSize);
+}
+
+void Texture::uploadTexels(const void* texels, VkDeviceSize texelsSize) {
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	m_device->createBuffer(texelsSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+	                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+	                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	                       stagingBuffer, stagingBufferMemory);
+	void* data;
+	vkMapMemory(m_device->getLogicalDevice(), stagingBufferMemory, 0, texelsSize, 0, &data);
+	memcpy(data, texels, static_cast<size_t>(texelsSize));
+	vkUnmapMemory(m_device->getLogicalDevice(), stagingBufferMemory);
+
+	transitionImageLayout(m_image, m_format, VK_IMAGE_LAYOUT_UNDEFINED,
+	                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	copyBufferToImage(stagingBuffer, m_image, m_size.x, m_size.y, m_depth);
+	transitionImageLayout(m_image, m_format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+	                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	vkDestroyBuffer(m_device->getLogicalDevice(), stagingBuffer, nullptr);
+	vkFreeMemory(m_device->getLogicalDevice(), stagingBufferMemory, nullptr);
+}
+
 void Texture::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout,
                                     VkImageLayout newLayout) {
 	VkCommandBuffer commandBuffer = m_device->beginSingleTimeCommands();
@@ -130,7 +243,8 @@ void Texture::transitionImageLayout(VkImage image, VkFormat format, VkImageLayou
 	m_device->endSingleTimeCommands(commandBuffer);
 }
 
-void Texture::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
+void Texture::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height,
+                                uint32_t depth) {
 	VkCommandBuffer commandBuffer = m_device->beginSingleTimeCommands();
 
 	VkBufferImageCopy region {};
@@ -144,7 +258,7 @@ void Texture::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width,
 	region.imageSubresource.layerCount = 1;
 
 	region.imageOffset = {0, 0, 0};
-	region.imageExtent = {width, height, 1};
+	region.imageExtent = {width, height, depth};
 
 	vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
 	                       &region);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "bootstrap/device.hpp"
+#include "util/constants.hpp"
 
 #include <glm/glm.hpp>
 #include <string>
@@ -13,17 +14,79 @@ inline TextureAccessBitFlag operator&(TextureAccessBitFlag a, TextureAccessBitFl
 	return static_cast<TextureAccessBitFlag>(static_cast<int>(a) & static_cast<int>(b));
 }
 
+/* Shape of a texture created empty for the GPU to fill */
+enum TextureType {
+	TEXTURE_TYPE_2D,
+	/* Six square faces, sampled by direction */
+	TEXTURE_TYPE_CUBE,
+	/* A volume, sampled in three dimensions */
+	TEXTURE_TYPE_3D,
+};
+
 class Texture {
+	friend class TextureLibrary;
+
   public:
 	Texture(Ref<VulkanDevice> device, const glm::uvec2& size, VkFormat imageFormat,
 	        TextureAccessBitFlag accessType, bool depth = false);
+	/**
+	 * @brief Creates an empty color texture for the GPU to fill, i.e. a lookup table written by a
+	 * compute shader. Starts in VK_IMAGE_LAYOUT_UNDEFINED, transitioning it is up to the writer.
+	 *
+	 * @param size Size of the image, or of each face of a cube
+	 * @param usage How the image will be accessed, i.e. storage and sampled
+	 */
+	Texture(Ref<VulkanDevice> device, const glm::uvec2& size, VkFormat imageFormat,
+	        VkImageUsageFlags usage, TextureType type = TEXTURE_TYPE_2D);
+	/**
+	 * @brief Creates a read-only volume from texels made on the CPU. Ready to sample once this
+	 * returns
+	 *
+	 * @param size Width, height and depth of the volume
+	 * @param texels Tightly packed texels, row by row, then slice by slice
+	 */
+	Texture(Ref<VulkanDevice> device, const glm::uvec3& size, VkFormat imageFormat,
+	        const void* texels, VkDeviceSize texelsSize);
 	Texture(std::string path,
 	        Ref<VulkanDevice> device); // TODO: the order of this constructor is annoying
 	~Texture();
 
 	Texture(const Texture&) = delete;
 
+	/**
+	 * @brief Replaces the image of a texture created empty for the GPU to fill with one of a new
+	 * size, keeping its index. The old image is destroyed right away, so it must not be in use
+	 */
+	void resize(const glm::uvec2& size);
+	/**
+	 * @brief Replaces every texel of a texture created empty with ones made on the CPU, leaving
+	 * it ready to sample. Needs VK_IMAGE_USAGE_TRANSFER_DST_BIT, and the image must not be in use
+	 *
+	 * @param texels Tightly packed texels, row by row
+	 */
+	void upload(const void* texels, VkDeviceSize texelsSize);
+
+	inline VkImage getImage() const { return m_image; }
 	inline VkImageView getImageView() const { return m_imageView; }
+	/**
+	 * @brief Gets the view compute shaders write the texture through. Cubes are written as an
+	 * array of six layers, as storage images can't be cubes
+	 */
+	inline VkImageView getStorageView() const {
+		return m_storageView != VK_NULL_HANDLE ? m_storageView : m_imageView;
+	}
+	inline const glm::uvec2& getSize() const { return m_size; }
+	/* Slices of a volume, 1 for any other type */
+	inline uint32_t getDepth() const { return m_depth; }
+	/**
+	 * @brief Gets the slot of this texture in the bindless texture table
+	 *
+	 * Indices are assigned by the TextureLibrary and never change while the texture is alive.
+	 *
+	 * @return The index shaders use to sample this texture, or INVALID_TEXTURE_INDEX if this
+	 * texture was never registered with the TextureLibrary
+	 */
+	inline uint32_t getIndex() const { return m_index; }
 
   private: // core interface
 	/**
@@ -32,6 +95,20 @@ class Texture {
 	 * @param path Relative path to an image file to load
 	 */
 	void createTextureImage(std::string path);
+	/**
+	 * @brief Creates the image of a volume, at its current size, and uploads its texels
+	 */
+	void createVolumeImage(const void* texels, VkDeviceSize texelsSize);
+	/**
+	 * @brief Copies texels into the whole image through a staging buffer. Whatever the image held
+	 * before is discarded, and it is left in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	 */
+	void uploadTexels(const void* texels, VkDeviceSize texelsSize);
+	/**
+	 * @brief Creates the image and views of a texture created empty, at its current size
+	 */
+	void createEmptyImage();
+	void destroyImage();
 
   private: // helper functions
 	/**
@@ -52,17 +129,27 @@ class Texture {
 	 * @param image The image to copy data into
 	 * @param width The width of the image to copy
 	 * @param height The height of the image to copy
+	 * @param depth The depth of the image to copy, for volumes
 	 */
-	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height,
+	                       uint32_t depth = 1);
 
   private:
 	glm::uvec2 m_size;
+	uint32_t m_depth = 1;
 	uint32_t m_numChannels;
+	/* Only kept for textures which can be resized */
+	VkFormat m_format = VK_FORMAT_UNDEFINED;
+	VkImageUsageFlags m_usage = 0;
+	TextureType m_type = TEXTURE_TYPE_2D;
+	uint32_t m_index = INVALID_TEXTURE_INDEX;
 
   private:
 	Ref<VulkanDevice> m_device;
 
 	VkImage m_image;
 	VkImageView m_imageView;
+	/* Only set for cubes, see getStorageView */
+	VkImageView m_storageView = VK_NULL_HANDLE;
 	VkDeviceMemory m_imageMemory;
 };
@@ -19,11 +19,23 @@ Ref<Texture> TextureLibrary::getTexture(Ref<VulkanDevice> device, const std::str
 		return m_texMap[filepath];
 	} else {
 		Ref<Texture> tex = CreateRef<Texture>(filepath, device);
+		tex->m_index = static_cast<uint32_t>(m_textures.size());
 		m_texMap[filepath] = tex;
+		m_textures.push_back(tex);
 		return tex;
 	}
 }
 
+void TextureLibrary::registerTexture(Ref<Texture> texture) {
+	if (texture->m_index != INVALID_TEXTURE_INDEX) {
+		return;
+	}
+
+	texture->m_index = static_cast<uint32_t>(m_textures.size());
+	m_textures.push_back(texture);
+}
+
 void TextureLibrary::cleanup() {
 	m_texMap.clear();
+	m_textures.clear();
 }
@@ -2,6 +2,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "bootstrap/device.hpp"
 #include "renderer/texture.hpp"
@@ -19,8 +20,22 @@ class TextureLibrary {
   public:
 	static TextureLibrary* get();
 	Ref<Texture> getTexture(Ref<VulkanDevice> device, const std::string& filepath);
+	/**
+	 * @brief Gives a texture created elsewhere (i.e. one rendered to) a slot in the bindless
+	 * texture table. It must be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL whenever it is sampled
+	 */
+	void registerTexture(Ref<Texture> texture);
 	void cleanup();
 
+	/**
+	 * @brief Gets every texture loaded so far, ordered by bindless index
+	 *
+	 * Textures are only ever appended to this list, so anything past the size seen on a previous
+	 * call is new.
+	 */
+	inline const std::vector<Ref<Texture>>& getTextures() const { return m_textures; }
+
   private:
 	std::map<std::string, Ref<Texture>> m_texMap;
+	std::vector<Ref<Texture>> m_textures;
 };
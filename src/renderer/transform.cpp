@@ -10,28 +10,40 @@ Transform::Transform() {
 
 void Transform::translate(const glm::vec3& tr) {
 	m_translation += tr;
+	m_trsDirty = true;
 }
 
 void Transform::translateRelative(const glm::vec3& tr) {
 	m_translation += m_rotation * tr;
+	m_trsDirty = true;
 }
 
 void Transform::rotateAbout(const glm::vec3& about, float rad) {
 	m_rotation = glm::rotate(m_rotation, rad, about) * m_rotation;
+	m_trsDirty = true;
 }
 
 void Transform::scale(const glm::vec3& scale) {
 	m_scale *= scale;
+	m_trsDirty = true;
 }
 
-glm::mat4 Transform::getTRS() {
-	// PERF: I can use a bool to check if I need to recompute this
-	m_TRS = glm::translate(glm::mat4(1.0f), m_translation) * glm::mat4_cast(m_rotation) *
-	        glm::scale(glm::mat4(1.0f), m_scale);
+const glm::mat4& Transform::getTRS() {
+	if (m_trsDirty) {
+		m_TRS = glm::translate(glm::mat4(1.0f), m_translation) * glm::mat4_cast(m_rotation) *
+		        glm::scale(glm::mat4(1.0f), m_scale);
+		m_normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(m_TRS))));
+		m_trsDirty = false;
+	}
 
 	return m_TRS;
 }
 
+const glm::mat4& Transform::getNormalMatrix() {
+	getTRS();
+	return m_normalMatrix;
+}
+
 glm::mat4 Transform::getView() {
 	// PERF: I can use a bool to check if I need to recompute this
 	return glm::mat4_cast(glm::inverse(m_rotation)) *
@@ -10,7 +10,10 @@ class Transform {
 
   public:
 	inline const glm::vec3& getTranslation() const { return m_translation; }
-	inline void setTranslation(const glm::vec3& tr) { m_translation = tr; }
+	inline void setTranslation(const glm::vec3& tr) {
+		m_translation = tr;
+		m_trsDirty = true;
+	}
 	/**
 	 * @brief Translates the object by the given vector
 	 *
@@ -25,14 +28,28 @@ class Transform {
 	void translateRelative(const glm::vec3& tr);
 
 	inline const glm::quat& getRotation() const { return m_rotation; }
-	inline void setRotation(const glm::quat& rot) { m_rotation = rot; }
+	inline void setRotation(const glm::quat& rot) {
+		m_rotation = rot;
+		m_trsDirty = true;
+	}
 	void rotateAbout(const glm::vec3& about, float rad);
 
 	inline const glm::vec3& getScale() const { return m_scale; }
-	inline void setScale(const glm::vec3& scale) { m_scale = scale; }
+	inline void setScale(const glm::vec3& scale) {
+		m_scale = scale;
+		m_trsDirty = true;
+	}
 	void scale(const glm::vec3& scale);
 
-	glm::mat4 getTRS();
+	/**
+	 * @brief Gets the model matrix. It is only recomputed after the transform changes
+	 */
+	const glm::mat4& getTRS();
+	/**
+	 * @brief Gets the inverse transpose of the model matrix, which transforms normals. It is
+	 * recomputed along with the model matrix
+	 */
+	const glm::mat4& getNormalMatrix();
 	glm::mat4 getView();
 
   private:
@@ -41,4 +58,7 @@ class Transform {
 	glm::vec3 m_scale;
 
 	glm::mat4 m_TRS;
+	glm::mat4 m_normalMatrix;
+	/* Whether m_TRS and m_normalMatrix are out of date */
+	bool m_trsDirty = true;
 };
@@ -38,8 +38,6 @@ VertexBuffer::~VertexBuffer() {
 	vkFreeMemory(m_device->getLogicalDevice(), m_vertexBufferMemory, nullptr);
 }
 
-void VertexBuffer::bind(VkCommandBuffer commandBuffer) {
-	VkBuffer vertexBuffers[] = {m_vertexBuffer};
-	VkDeviceSize offsets[] = {0};
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+void VertexBuffer::bind(CommandEncoder& encoder) {
+	encoder.bindVertexBuffer(0, m_vertexBuffer, 0);
 }
@@ -3,6 +3,7 @@
 #include <glm/glm.hpp>
 #include <vulkan/vulkan_core.h>
 
+#include "bootstrap/command_encoder.hpp"
 #include "bootstrap/device.hpp"
 
 /**
@@ -31,9 +32,9 @@ class VertexBuffer {
 	/**
 	 * @brief "Activates" this buffer, causing it to be used for the next draw call
 	 *
-	 * @param commandBuffer The command buffer to record to
+	 * @param encoder The encoder to record to
 	 */
-	void bind(VkCommandBuffer commandBuffer);
+	void bind(CommandEncoder& encoder);
 
 	inline uint32_t size() const { return m_count; }
 
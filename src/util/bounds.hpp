@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <glm/glm.hpp>
+
+/**
+ * @struct AABB
+ * @brief Axis aligned bounding box
+ */
+struct AABB {
+	glm::vec3 min = glm::vec3(0.0f);
+	glm::vec3 max = glm::vec3(0.0f);
+
+	inline glm::vec3 center() const { return (min + max) * 0.5f; }
+	inline glm::vec3 extents() const { return (max - min) * 0.5f; }
+
+	/**
+	 * @brief Bounds this box after an affine transform, still axis aligned (Arvo's method)
+	 */
+	AABB transformed(const glm::mat4& m) const {
+		glm::vec3 c = glm::vec3(m * glm::vec4(center(), 1.0f));
+		glm::vec3 e = extents();
+		glm::mat3 abs = glm::mat3(glm::abs(glm::vec3(m[0])), glm::abs(glm::vec3(m[1])),
+		                          glm::abs(glm::vec3(m[2])));
+		glm::vec3 te = abs * e;
+		return {c - te, c + te};
+	}
+};
+
+/**
+ * @struct Frustum
+ * @brief The six planes bounding what a camera can see, normals facing inwards
+ *
+ * Each plane is xyz normal, w distance, so a point p is inside when dot(n, p) + w >= 0.
+ */
+struct Frustum {
+	std::array<glm::vec4, 6> planes;
+
+	/**
+	 * @brief Extracts the planes from the rows of a view projection matrix (Gribb / Hartmann)
+	 *
+	 * Depth is [0, 1] (GLM_FORCE_DEPTH_ZERO_TO_ONE), so the near plane is just the third row.
+	 */
+	static Frustum fromViewProj(const glm::mat4& viewProj) {
+		glm::mat4 m = glm::transpose(viewProj);
+		Frustum frustum;
+		frustum.planes = {m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[2], m[3] - m[2]};
+		for (auto& plane : frustum.planes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+		return frustum;
+	}
+
+	/**
+	 * @param sphere xyz center, w radius
+	 * @return Whether any part of the sphere may be inside the frustum
+	 */
+	bool intersects(const glm::vec4& sphere) const {
+		for (const auto& plane : planes) {
+			if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w < -sphere.w) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * @return Whether any part of the box may be inside the frustum
+	 */
+	bool intersects(const AABB& box) const {
+		glm::vec3 c = box.center(), e = box.extents();
+		for (const auto& plane : planes) {
+			glm::vec3 n = glm::vec3(plane);
+			if (glm::dot(n, c) + plane.w < -glm::dot(glm::abs(n), e)) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
@@ -1,4 +1,20 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
+
 // Number of frames that can be rendered concurrently
 const int MAX_FRAMES_IN_FLIGHT = 2;
+
+// One T for each frame in flight
+template <typename T> using Frames = std::array<T, MAX_FRAMES_IN_FLIGHT>;
+
+// Upper bound on the number of textures in the bindless texture table. The actual capacity is
+// further limited by what the device supports
+const uint32_t MAX_BINDLESS_TEXTURES = 4096;
+
+// Texture index meaning "no texture". Shaders check for this before sampling optional textures
+const uint32_t INVALID_TEXTURE_INDEX = UINT32_MAX;
+
+// Max number of objects drawn in a single frame. Each takes one slot of the object storage buffer
+const uint32_t MAX_OBJECTS_PER_FRAME = 4096;
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <type_traits>
+
+/**
+ * @brief Whether T has been checked to match its std140 / std430 declaration in shader code
+ *
+ * Types are uploaded with a plain memcpy, so only types marked with GPU_LAYOUT can be used with
+ * UniformHandle or ComputePipeline::pushConstant. Mark a type after static_asserting its member
+ * offsets.
+ */
+template <typename T> struct GpuLayout : std::false_type {};
+
+#define GPU_LAYOUT(T)                                                                              \
+	template <> struct GpuLayout<T> : std::true_type {                                             \
+		static_assert(std::is_trivially_copyable_v<T>, #T " must be trivially copyable");          \
+		static_assert(std::is_standard_layout_v<T>, #T " must have standard layout");              \
+	}
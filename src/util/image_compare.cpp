@@ -0,0 +1,123 @@
+#include "image_compare.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+// Pixels along each side of an SSIM window, and between the corners of neighbouring windows
+static const uint32_t SSIM_WINDOW = 8;
+static const uint32_t SSIM_STRIDE = 4;
+// Keep SSIM stable where a window's mean or variance is near 0, for 8 bit values
+static const double SSIM_C1 = (0.01 * 255.0) * (0.01 * 255.0);
+static const double SSIM_C2 = (0.03 * 255.0) * (0.03 * 255.0);
+
+static void checkSizes(const RgbaImage& image, const RgbaImage& reference) {
+	if (image.size != reference.size ||
+	    image.pixels.size() != 4ull * image.size.x * image.size.y ||
+	    reference.pixels.size() != image.pixels.size()) {
+		throw std::runtime_error("failed to compare images of different sizes!");
+	}
+}
+
+/**
+ * @brief Converts every pixel to Rec. 601 luma
+ */
+static std::vector<float> toLuma(const RgbaImage& image) {
+	std::vector<float> luma(image.size.x * image.size.y);
+	for (size_t i = 0; i < luma.size(); i++) {
+		const uint8_t* pixel = &image.pixels[4 * i];
+		luma[i] = 0.299f * pixel[0] + 0.587f * pixel[1] + 0.114f * pixel[2];
+	}
+	return luma;
+}
+
+/**
+ * @brief The sRGB transfer function, from linear light in [0, 1]
+ */
+static float encodeSrgb(float linear) {
+	return linear <= 0.0031308f ? 12.92f * linear
+	                            : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+}
+
+namespace image {
+
+float psnr(const RgbaImage& image, const RgbaImage& reference) {
+	checkSizes(image, reference);
+
+	double sumSq = 0.0;
+	for (size_t i = 0; i < image.pixels.size(); i++) {
+		if (i % 4 == 3) {
+			continue; // alpha
+		}
+		double diff = double(image.pixels[i]) - double(reference.pixels[i]);
+		sumSq += diff * diff;
+	}
+	if (sumSq == 0.0) {
+		return std::numeric_limits<float>::infinity();
+	}
+
+	double mse = sumSq / (3.0 * image.size.x * image.size.y);
+	return static_cast<float>(10.0 * std::log10(255.0 * 255.0 / mse));
+}
+
+float ssim(const RgbaImage& image, const RgbaImage& reference) {
+	checkSizes(image, reference);
+	if (image.size.x < SSIM_WINDOW || image.size.y < SSIM_WINDOW) {
+		throw std::runtime_error("failed to compare images smaller than an SSIM window!");
+	}
+
+	std::vector<float> x = toLuma(image);
+	std::vector<float> y = toLuma(reference);
+	const double n = SSIM_WINDOW * SSIM_WINDOW;
+	double total = 0.0;
+	uint32_t windows = 0;
+	for (uint32_t top = 0; top + SSIM_WINDOW <= image.size.y; top += SSIM_STRIDE) {
+		for (uint32_t left = 0; left + SSIM_WINDOW <= image.size.x; left += SSIM_STRIDE) {
+			double sumX = 0.0, sumY = 0.0, sumXX = 0.0, sumYY = 0.0, sumXY = 0.0;
+			for (uint32_t row = top; row < top + SSIM_WINDOW; row++) {
+				for (uint32_t col = left; col < left + SSIM_WINDOW; col++) {
+					double a = x[row * image.size.x + col];
+					double b = y[row * image.size.x + col];
+					sumX += a;
+					sumY += b;
+					sumXX += a * a;
+					sumYY += b * b;
+					sumXY += a * b;
+				}
+			}
+
+			double meanX = sumX / n, meanY = sumY / n;
+			double varX = sumXX / n - meanX * meanX;
+			double varY = sumYY / n - meanY * meanY;
+			double covariance = sumXY / n - meanX * meanY;
+			total += ((2.0 * meanX * meanY + SSIM_C1) * (2.0 * covariance + SSIM_C2)) /
+			         ((meanX * meanX + meanY * meanY + SSIM_C1) * (varX + varY + SSIM_C2));
+			windows++;
+		}
+	}
+
+	return static_cast<float>(total / windows);
+}
+
+RgbaImage quantize(const std::vector<glm::vec4>& pixels, const glm::uvec2& size, bool srgb) {
+	if (pixels.size() != size_t(size.x) * size.y) {
+		throw std::runtime_error("failed to quantize image, pixels don't match its size!");
+	}
+
+	RgbaImage image;
+	image.size = size;
+	image.srgb = srgb;
+	image.pixels.resize(4 * pixels.size());
+	for (size_t i = 0; i < pixels.size(); i++) {
+		for (uint32_t channel = 0; channel < 3; channel++) {
+			float value = std::min(std::max(pixels[i][channel], 0.0f), 1.0f);
+			value = srgb ? encodeSrgb(value) : value;
+			image.pixels[4 * i + channel] = static_cast<uint8_t>(std::lround(value * 255.0f));
+		}
+		image.pixels[4 * i + 3] = 255;
+	}
+	return image;
+}
+
+} // namespace image
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+/**
+ * @struct RgbaImage
+ * @brief 8 bit RGBA pixels, row by row from the top
+ */
+struct RgbaImage {
+	glm::uvec2 size = glm::uvec2(0);
+	std::vector<uint8_t> pixels;
+	/* Whether pixels are sRGB encoded, as an _SRGB swapchain stores them, rather than linear */
+	bool srgb = false;
+
+	inline bool empty() const { return pixels.empty(); }
+};
+
+namespace image {
+
+/**
+ * @brief Peak signal to noise ratio of an image against a reference, over RGB
+ *
+ * @return The ratio in decibels. Infinite if the images are identical
+ */
+float psnr(const RgbaImage& image, const RgbaImage& reference);
+/**
+ * @brief Mean structural similarity of an image to a reference, over luma
+ *
+ * Windows of 8x8 pixels are compared, stepping 4 pixels at a time, with uniform weights rather
+ * than a gaussian.
+ *
+ * @return 1 for identical images, falling towards 0 (or below) as they differ
+ */
+float ssim(const RgbaImage& image, const RgbaImage& reference);
+/**
+ * @brief Rounds linear colors to 8 bits, as writing them to a swapchain image would
+ *
+ * @param pixels size.x * size.y colors, row by row from the top. Alpha is ignored, and stored as
+ * opaque
+ * @param srgb Whether to encode them as sRGB first, as an _SRGB image does
+ */
+RgbaImage quantize(const std::vector<glm::vec4>& pixels, const glm::uvec2& size, bool srgb);
+
+} // namespace image
@@ -17,6 +17,7 @@ void Instrumentor::EndSession() {
 }
 
 void Instrumentor::WriteProfile(const ProfileResult& result) {
+	std::lock_guard<std::mutex> lock(m_Mutex);
 	if (m_ProfileCount++ > 0)
 		m_OutputStream << ",";
 
@@ -36,6 +37,30 @@ void Instrumentor::WriteProfile(const ProfileResult& result) {
 	m_OutputStream.flush();
 }
 
+void Instrumentor::WriteCounter(const std::string& name, double value) {
+	auto now = std::chrono::high_resolution_clock::now();
+	long long timestamp =
+		std::chrono::time_point_cast<std::chrono::microseconds>(now).time_since_epoch().count();
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_ProfileCount++ > 0)
+		m_OutputStream << ",";
+
+	std::string safeName = name;
+	std::replace(safeName.begin(), safeName.end(), '"', '\'');
+
+	m_OutputStream << "{";
+	m_OutputStream << "\"cat\":\"counter\",";
+	m_OutputStream << "\"name\":\"" << safeName << "\",";
+	m_OutputStream << "\"ph\":\"C\",";
+	m_OutputStream << "\"pid\":0,";
+	m_OutputStream << "\"ts\":" << timestamp << ",";
+	m_OutputStream << "\"args\":{\"value\":" << value << "}";
+	m_OutputStream << "}";
+
+	m_OutputStream.flush();
+}
+
 void Instrumentor::WriteHeader() {
 	m_OutputStream << "{\"otherData\": {},\"traceEvents\":[";
 	m_OutputStream.flush();
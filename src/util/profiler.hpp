@@ -4,6 +4,7 @@
 #include <chrono>
 #include <functional>
 #include <fstream>
+#include <mutex>
 #include <thread>
 
 struct ProfileResult {
@@ -24,6 +25,10 @@ class Instrumentor {
 	void EndSession();
 
 	void WriteProfile(const ProfileResult& result);
+	/**
+	 * @brief Writes the value of a counter, which trace viewers plot over time next to profiles
+	 */
+	void WriteCounter(const std::string& name, double value);
 
 	void WriteHeader();
 	void WriteFooter();
@@ -34,6 +39,7 @@ class Instrumentor {
 	InstrumentationSession* m_CurrentSession;
 	std::ofstream m_OutputStream;
 	int m_ProfileCount;
+	std::mutex m_Mutex; // profiles can be written from worker threads
 };
 
 class InstrumentationTimer {
@@ -74,9 +80,11 @@ class InstrumentationTimer {
 	#define PROFILE_END_SESSION() Instrumentor::Get().EndSession()
 	#define PROFILE_SCOPE(name) InstrumentationTimer timer##__LINE__(name)
 	#define PROFILE_FUNC() PROFILE_SCOPE(__PRETTY_FUNCTION__)
+	#define PROFILE_COUNTER(name, value) Instrumentor::Get().WriteCounter(name, value)
 #else
 	#define PROFILE_BEGIN_SESSION(name, filepath)
 	#define PROFILE_END_SESSION()
 	#define PROFILE_SCOPE(name)
 	#define PROFILE_FUNC()
+	#define PROFILE_COUNTER(name, value)
 #endif
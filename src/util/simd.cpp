@@ -0,0 +1,90 @@
+#include "simd.hpp"
+
+#if SUNSET_SIMD_WIDTH > 1
+#include <immintrin.h>
+#endif
+
+namespace simd {
+
+#if SUNSET_SIMD_WIDTH == 8
+
+static uint32_t cullSpheresWide(const Frustum& frustum, const SphereBatch& spheres,
+                                uint8_t* visible, uint32_t& i) {
+	uint32_t numVisible = 0;
+	for (; i + 8 <= spheres.count; i += 8) {
+		__m256 x = _mm256_loadu_ps(spheres.x + i);
+		__m256 y = _mm256_loadu_ps(spheres.y + i);
+		__m256 z = _mm256_loadu_ps(spheres.z + i);
+		__m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(spheres.radius + i));
+
+		// Inside if the signed distance to every plane is at least -radius
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (const auto& plane : frustum.planes) {
+			__m256 dist = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.x)),
+			                            _mm256_mul_ps(y, _mm256_set1_ps(plane.y)));
+			dist = _mm256_add_ps(dist, _mm256_mul_ps(z, _mm256_set1_ps(plane.z)));
+			dist = _mm256_add_ps(dist, _mm256_set1_ps(plane.w));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, negRadius, _CMP_GE_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+		for (uint32_t lane = 0; lane < 8; lane++) {
+			visible[i + lane] = (mask >> lane) & 1;
+		}
+		numVisible += __builtin_popcount(mask);
+	}
+	return numVisible;
+}
+
+#elif SUNSET_SIMD_WIDTH == 4
+
+static uint32_t cullSpheresWide(const Frustum& frustum, const SphereBatch& spheres,
+                                uint8_t* visible, uint32_t& i) {
+	uint32_t numVisible = 0;
+	for (; i + 4 <= spheres.count; i += 4) {
+		__m128 x = _mm_loadu_ps(spheres.x + i);
+		__m128 y = _mm_loadu_ps(spheres.y + i);
+		__m128 z = _mm_loadu_ps(spheres.z + i);
+		__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(spheres.radius + i));
+
+		// Inside if the signed distance to every plane is at least -radius
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (const auto& plane : frustum.planes) {
+			__m128 dist = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)),
+			                         _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+			dist = _mm_add_ps(dist, _mm_mul_ps(z, _mm_set1_ps(plane.z)));
+			dist = _mm_add_ps(dist, _mm_set1_ps(plane.w));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, negRadius));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (uint32_t lane = 0; lane < 4; lane++) {
+			visible[i + lane] = (mask >> lane) & 1;
+		}
+		numVisible += __builtin_popcount(mask);
+	}
+	return numVisible;
+}
+
+#else
+
+static uint32_t cullSpheresWide(const Frustum&, const SphereBatch&, uint8_t*, uint32_t&) {
+	return 0;
+}
+
+#endif
+
+uint32_t cullSpheres(const Frustum& frustum, const SphereBatch& spheres, uint8_t* visible) {
+	uint32_t i = 0;
+	uint32_t numVisible = cullSpheresWide(frustum, spheres, visible, i);
+
+	// Whatever doesn't fill a whole register
+	for (; i < spheres.count; i++) {
+		glm::vec4 sphere(spheres.x[i], spheres.y[i], spheres.z[i], spheres.radius[i]);
+		visible[i] = frustum.intersects(sphere);
+		numVisible += visible[i];
+	}
+	return numVisible;
+}
+
+} // namespace simd
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+#include "util/bounds.hpp"
+
+// Widest instruction set the culling kernels were compiled for. AVX needs SUNSET_ENABLE_AVX
+#if defined(__AVX__)
+#define SUNSET_SIMD_WIDTH 8
+#define SUNSET_SIMD_NAME "AVX"
+#elif defined(__SSE__) || defined(_M_X64)
+#define SUNSET_SIMD_WIDTH 4
+#define SUNSET_SIMD_NAME "SSE"
+#else
+#define SUNSET_SIMD_WIDTH 1
+#define SUNSET_SIMD_NAME "scalar"
+#endif
+
+/**
+ * @struct SphereBatch
+ * @brief Bounding spheres packed one component per array (SoA), so they can be tested a SIMD
+ * register at a time
+ */
+struct SphereBatch {
+	const float* x;
+	const float* y;
+	const float* z;
+	const float* radius;
+	uint32_t count;
+};
+
+namespace simd {
+
+/**
+ * @brief Frustum culls a batch of spheres, SUNSET_SIMD_WIDTH at a time
+ *
+ * @param visible Written with 1 for each sphere that may be visible and 0 for each that is not.
+ * Must hold spheres.count entries
+ * @return The number of visible spheres
+ */
+uint32_t cullSpheres(const Frustum& frustum, const SphereBatch& spheres, uint8_t* visible);
+
+} // namespace simd
@@ -0,0 +1,73 @@
+#include "thread_pool.hpp"
+
+ThreadPool::ThreadPool(uint32_t numThreads) {
+	for (uint32_t i = 0; i < numThreads; i++) {
+		m_threads.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (auto& thread : m_threads) {
+		thread.join();
+	}
+}
+
+void ThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t, uint32_t)>& task) {
+	if (count == 0) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_task = &task;
+	m_count = count;
+	m_nextIndex = 0;
+	m_remaining = count;
+	m_error = nullptr;
+	m_batch++;
+	m_wake.notify_all();
+
+	m_done.wait(lock, [&]() { return m_remaining == 0; });
+	m_task = nullptr;
+	if (m_error) {
+		std::rethrow_exception(m_error);
+	}
+}
+
+void ThreadPool::workerLoop(uint32_t worker) {
+	uint64_t lastBatch = 0;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true) {
+		m_wake.wait(lock, [&]() { return m_stop || m_batch != lastBatch; });
+		if (m_stop) {
+			return;
+		}
+		lastBatch = m_batch;
+
+		// Take tasks until the batch runs out. Tasks are coarse, so a lock per task is cheap
+		while (m_nextIndex < m_count) {
+			uint32_t index = m_nextIndex++;
+			const auto& task = *m_task;
+			lock.unlock();
+
+			std::exception_ptr error;
+			try {
+				task(index, worker);
+			} catch (...) {
+				error = std::current_exception();
+			}
+
+			lock.lock();
+			if (error && !m_error) {
+				m_error = error;
+			}
+			if (--m_remaining == 0) {
+				m_done.notify_one();
+			}
+		}
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class ThreadPool
+ * @brief A fixed set of worker threads which split a batch of tasks between them
+ *
+ * Workers are started once and sleep between batches, so handing out work every frame costs no
+ * thread creation.
+ */
+class ThreadPool {
+  public:
+	ThreadPool(uint32_t numThreads);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+
+	/**
+	 * @brief Runs task(index, worker) for every index in [0, count), blocking until all are done
+	 *
+	 * Tasks run in no particular order. worker identifies the thread running the task, in
+	 * [0, size()), so tasks can use per thread resources without locking. If any task throws, the
+	 * first exception is rethrown here once the batch is done.
+	 */
+	void parallelFor(uint32_t count, const std::function<void(uint32_t, uint32_t)>& task);
+
+	inline uint32_t size() const { return m_threads.size(); }
+
+  private:
+	void workerLoop(uint32_t worker);
+
+  private:
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_mutex;
+	/* Wakes workers when a batch is posted, and the caller when it is done */
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+
+	/* The current batch. Only valid while m_remaining > 0 */
+	const std::function<void(uint32_t, uint32_t)>* m_task = nullptr;
+	uint32_t m_count = 0;
+	uint32_t m_nextIndex = 0;
+	uint32_t m_remaining = 0;
+	/* Bumped for every batch, so workers can tell a new batch from a spurious wake up */
+	uint64_t m_batch = 0;
+	std::exception_ptr m_error;
+	bool m_stop = false;
+};